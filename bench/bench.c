@@ -0,0 +1,372 @@
+#include <err.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "corpus.h"
+#include "rationl.h"
+#include "rationl_internal.h"
+
+#define DEFAULT_CORPUS_SIZE (1 << 20)
+#define DEFAULT_MIN_TIME 0.2
+#define DEFAULT_SEED 42
+
+/**
+ * A pattern written for both engines, the POSIX extended syntax has no
+ * \d or \w.
+ */
+typedef struct BenchCase
+{
+    CorpusKind corpus;
+    const char *pattern;
+    const char *posix;
+} BenchCase;
+
+static const BenchCase cases[] = {
+    { CORPUS_LOGS, "\\d+\\.\\d+\\.\\d+\\.\\d+",
+      "[0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+" },
+    { CORPUS_LOGS, "(GET|POST) /\\w+", "(GET|POST) /[a-zA-Z0-9_]+" },
+    { CORPUS_LOGS, "\" (4|5)\\d\\d ", "\" (4|5)[0-9][0-9] " },
+    { CORPUS_SOURCE, "\\w+\\(", "[a-zA-Z0-9_]+\\(" },
+    { CORPUS_SOURCE, "if|for|while|return", "if|for|while|return" },
+    { CORPUS_SOURCE, "0x[0-9a-f]+", "0x[0-9a-f]+" },
+    { CORPUS_RANDOM, "[a-z]+[0-9]", "[a-z]+[0-9]" },
+    { CORPUS_RANDOM, "abc|xyz", "abc|xyz" },
+    { CORPUS_DNA, "ACGT", "ACGT" },
+    { CORPUS_DNA, "(A|T)(C|G)+TA", "(A|T)(C|G)+TA" },
+    { CORPUS_DNA, "A[CG]{3,5}T", "A[CG]{3,5}T" },
+};
+
+/**
+ * The inputs of a measure, for both engines.
+ */
+typedef struct BenchInput
+{
+    const BenchCase *bench_case;
+    const char *corpus;
+    size_t corpus_size;
+    char **lines;
+    size_t line_count;
+    size_t line_bytes;
+    reg_t re;
+    regex_t posix;
+    regex_t posix_anchored;
+    regex_scratch_t *scratch;
+    /**
+     * Set by the measured function: lines or matches found.
+     */
+    size_t found;
+} BenchInput;
+
+typedef void (*BenchFunction)(BenchInput *input);
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * Run a function until it has run for at least `min_time` seconds.
+ * @return The average time of a run in seconds.
+ */
+static double measure(BenchFunction function, BenchInput *input,
+                      double min_time)
+{
+    size_t runs = 0;
+    double start = now();
+    double elapsed;
+    do
+    {
+        function(input);
+        runs++;
+        elapsed = now() - start;
+    } while (elapsed < min_time);
+
+    return elapsed / runs;
+}
+
+static void rationl_compile(BenchInput *input)
+{
+    reg_t re = regex_compile((char *)input->bench_case->pattern);
+    regex_free(re);
+}
+
+static void rationl_match(BenchInput *input)
+{
+    input->found = 0;
+    for (size_t i = 0; i < input->line_count; i++)
+    {
+        match *m = regex_match(input->re, input->lines[i]);
+        input->found += m != NULL;
+        match_free(m);
+    }
+}
+
+static void rationl_search(BenchInput *input)
+{
+    match **matches;
+    input->found = regex_search(input->re, (char *)input->corpus, &matches);
+    for (size_t i = 0; i < input->found; i++)
+        match_free(matches[i]);
+    free(matches);
+}
+
+static void rationl_search_r(BenchInput *input)
+{
+    const match *matches;
+    input->found =
+        regex_search_r(input->re, input->scratch, input->corpus, &matches);
+}
+
+static void rationl_sub(BenchInput *input)
+{
+    free(regex_sub(input->re, (char *)input->corpus, "#"));
+}
+
+static void posix_compile(BenchInput *input)
+{
+    regex_t posix;
+    if (regcomp(&posix, input->bench_case->posix, REG_EXTENDED) == 0)
+        regfree(&posix);
+}
+
+static void posix_match(BenchInput *input)
+{
+    input->found = 0;
+    regmatch_t match;
+    for (size_t i = 0; i < input->line_count; i++)
+        input->found +=
+            regexec(&input->posix_anchored, input->lines[i], 1, &match, 0)
+            == 0;
+}
+
+/**
+ * Call a function on every leftmost longest non empty match, as
+ * regex_search does.
+ * @return The number of matches.
+ */
+static size_t posix_foreach(BenchInput *input,
+                            void (*found)(const char *, regmatch_t, void *),
+                            void *data)
+{
+    size_t count = 0;
+    const char *string = input->corpus;
+    regmatch_t match;
+    while (*string != 0
+           && regexec(&input->posix, string, 1, &match,
+                      string == input->corpus ? 0 : REG_NOTBOL)
+                  == 0)
+    {
+        if (match.rm_eo == match.rm_so)
+        {
+            if (found != NULL)
+                found(string, (regmatch_t){ 0, match.rm_so + 1 }, data);
+            string += match.rm_so + 1;
+            continue;
+        }
+        count++;
+        if (found != NULL)
+            found(string, match, data);
+        string += match.rm_eo;
+    }
+
+    return count;
+}
+
+static void posix_search(BenchInput *input)
+{
+    input->found = posix_foreach(input, NULL, NULL);
+}
+
+/**
+ * String built by posix_sub, `rest` is the first character not copied yet.
+ */
+typedef struct Output
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    const char *rest;
+} Output;
+
+static void output_append(Output *output, const char *string, size_t size)
+{
+    if (output->size + size + 1 > output->capacity)
+    {
+        output->capacity = 2 * (output->size + size + 1);
+        output->data = realloc(output->data, output->capacity);
+    }
+    memcpy(output->data + output->size, string, size);
+    output->size += size;
+}
+
+static void replace_match(const char *string, regmatch_t match, void *data)
+{
+    Output *output = data;
+    output_append(output, string, match.rm_so);
+    if (match.rm_eo != match.rm_so)
+        output_append(output, "#", 1);
+    else
+        output_append(output, string + match.rm_so, 1);
+    output->rest = string + match.rm_eo;
+}
+
+static void posix_sub(BenchInput *input)
+{
+    Output output = { .data = NULL, .size = 0, .capacity = 0,
+                      .rest = input->corpus };
+    posix_foreach(input, replace_match, &output);
+    output_append(&output, output.rest, strlen(output.rest));
+    output.data[output.size] = 0;
+    free(output.data);
+}
+
+static void json_string(FILE *out, const char *string)
+{
+    fputc('"', out);
+    for (; *string != 0; string++)
+    {
+        if (*string == '"' || *string == '\\')
+            fprintf(out, "\\%c", *string);
+        else if ((unsigned char)*string < ' ')
+            fprintf(out, "\\u%04x", *string);
+        else
+            fputc(*string, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Write the results of an engine on a case as a JSON object.
+ */
+static void bench_engine(FILE *out, BenchInput *input, int posix,
+                         double min_time)
+{
+    double mb = input->corpus_size / 1e6;
+    double line_mb = input->line_bytes / 1e6;
+
+    double compile = measure(posix ? posix_compile : rationl_compile, input,
+                             min_time);
+    double match = measure(posix ? posix_match : rationl_match, input,
+                           min_time);
+    size_t matched_lines = input->found;
+    double search = measure(posix ? posix_search : rationl_search, input,
+                            min_time);
+    size_t matches = input->found;
+    double sub = measure(posix ? posix_sub : rationl_sub, input, min_time);
+
+    fprintf(out, "    {\"engine\": \"%s\", \"corpus\": \"%s\", \"pattern\": ",
+            posix ? "glibc" : "rationl", corpus_name(input->bench_case->corpus));
+    json_string(out, posix ? input->bench_case->posix
+                           : input->bench_case->pattern);
+    fprintf(out, ",\n     \"compile_us\": %.3f", compile * 1e6);
+    fprintf(out, ", \"match_mb_per_s\": %.3f", line_mb / match);
+    fprintf(out, ", \"matched_lines\": %zu", matched_lines);
+    fprintf(out, ",\n     \"search_mb_per_s\": %.3f", mb / search);
+    fprintf(out, ", \"matches\": %zu", matches);
+    fprintf(out, ", \"matches_per_s\": %.1f", matches / search);
+    if (!posix)
+    {
+        double search_r = measure(rationl_search_r, input, min_time);
+        fprintf(out, ", \"search_r_mb_per_s\": %.3f", mb / search_r);
+    }
+    fprintf(out, ",\n     \"sub_mb_per_s\": %.3f}", mb / sub);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: rationl-bench [-s size] [-t seconds] [-r seed] "
+            "[-o output]\n"
+            "  -s size     bytes of each generated corpus (default: %d)\n"
+            "  -t seconds  minimal duration of a measure (default: %.1f)\n"
+            "  -r seed     seed of the corpora (default: %d)\n"
+            "  -o output   file to write (default: standard output)\n",
+            DEFAULT_CORPUS_SIZE, DEFAULT_MIN_TIME, DEFAULT_SEED);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = DEFAULT_CORPUS_SIZE;
+    double min_time = DEFAULT_MIN_TIME;
+    unsigned long seed = DEFAULT_SEED;
+    const char *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:t:r:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            size = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            min_time = strtod(optarg, NULL);
+            break;
+        case 'r':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc || size == 0)
+        usage();
+
+    FILE *out = output == NULL ? stdout : fopen(output, "w");
+    if (out == NULL)
+        err(1, "cannot open %s", output);
+
+    fprintf(out, "{\n  \"corpus_size\": %zu,\n  \"seed\": %lu,\n", size, seed);
+    fprintf(out, "  \"min_time\": %.3f,\n  \"results\": [\n", min_time);
+
+    char *corpora[CORPUS_COUNT] = { NULL };
+    size_t nb_cases = sizeof(cases) / sizeof(*cases);
+    for (size_t i = 0; i < nb_cases; i++)
+    {
+        BenchInput input = { .bench_case = cases + i, .corpus_size = size };
+        CorpusKind kind = cases[i].corpus;
+        if (corpora[kind] == NULL)
+            corpora[kind] = corpus_generate(kind, size, seed);
+        input.corpus = corpora[kind];
+        input.lines = corpus_lines(input.corpus, &input.line_count);
+        input.line_bytes = size - input.line_count;
+
+        char *anchored = malloc(strlen(cases[i].posix) + 4);
+        sprintf(anchored, "^(%s)", cases[i].posix);
+        if (regcomp(&input.posix, cases[i].posix, REG_EXTENDED) != 0
+            || regcomp(&input.posix_anchored, anchored, REG_EXTENDED) != 0)
+            errx(1, "invalid POSIX pattern %s", cases[i].posix);
+        free(anchored);
+        input.re = regex_compile((char *)cases[i].pattern);
+        input.scratch = regex_scratch_create(input.re);
+
+        bench_engine(out, &input, 0, min_time);
+        fprintf(out, ",\n");
+        bench_engine(out, &input, 1, min_time);
+        fprintf(out, i + 1 == nb_cases ? "\n" : ",\n");
+
+        regex_scratch_free(input.scratch);
+        regex_free(input.re);
+        regfree(&input.posix);
+        regfree(&input.posix_anchored);
+        corpus_free_lines(input.lines, input.line_count);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    for (size_t i = 0; i < CORPUS_COUNT; i++)
+        free(corpora[i]);
+    if (out != stdout && fclose(out) != 0)
+        err(1, "cannot write %s", output);
+
+    return 0;
+}
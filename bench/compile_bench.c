@@ -0,0 +1,422 @@
+#include <err.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "automaton/automaton.h"
+#include "automaton/delete_eps.h"
+#include "automaton/determine.h"
+#include "automaton/minimization.h"
+#include "automaton/prune.h"
+#include "automaton/thompson.h"
+#include "parsing/lexer.h"
+#include "parsing/parsing.h"
+#include "utils/memory_utils.h"
+
+#define DEFAULT_TIMEOUT 10
+#define PATTERN_DISPLAY_LENGTH 64
+
+/**
+ * The stages of regex_compile, in order. The determinization is not a stage
+ * of regex_compile, it is measured on its own to know the size of the DFA
+ * before minimization.
+ */
+typedef enum Stage
+{
+    STAGE_TOKENIZE,
+    STAGE_PARSE_SYMBOLS,
+    STAGE_THOMPSON,
+    STAGE_DELETE_EPSILON,
+    STAGE_PRUNE,
+    STAGE_DETERMINE,
+    STAGE_MINIMIZE,
+    STAGE_COUNT
+} Stage;
+
+static const char *stage_names[] = {
+    "tokenize", "parse_symbols", "thompson", "automaton_delete_epsilon_tr",
+    "automaton_prune", "determine", "minimize"
+};
+
+/**
+ * Names of the state counts, after the stages building an automaton.
+ */
+static const char *state_names[] = {
+    NULL, NULL, "nfa_states", "epsilon_free_states", "pruned_states",
+    "dfa_states", "minimized_states"
+};
+
+/**
+ * Sent by the compiling process after each stage, and once with
+ * `stage == STAGE_COUNT` to give the peak memory of the process.
+ */
+typedef struct StageRecord
+{
+    int stage;
+    double seconds;
+    /**
+     * Number of states of the automaton built by the stage, or the peak
+     * resident set size in kilobytes for the last record.
+     */
+    size_t states;
+    /**
+     * Bytes allocated in the compilation arena since the beginning.
+     */
+    size_t arena_bytes;
+} StageRecord;
+
+typedef char *(*PatternBuilder)(size_t n);
+
+/**
+ * A family of patterns, built for increasing values of n until one of them
+ * fails or takes too long.
+ */
+typedef struct Family
+{
+    const char *name;
+    PatternBuilder build;
+    size_t sizes[16];
+} Family;
+
+static char *build_dfa_blowup(size_t n)
+{
+    char *pattern = malloc(64);
+    snprintf(pattern, 64, "(a|b)*a(a|b){%zu}", n);
+    return pattern;
+}
+
+static char *build_repetition(size_t n)
+{
+    char *pattern = malloc(64);
+    snprintf(pattern, 64, "a{%zu}", n);
+    return pattern;
+}
+
+static char *build_bounded_repetition(size_t n)
+{
+    char *pattern = malloc(64);
+    snprintf(pattern, 64, "(ab){%zu,%zu}", n, 2 * n);
+    return pattern;
+}
+
+static char *build_nested_groups(size_t n)
+{
+    char *pattern = malloc(2 * n + 2);
+    memset(pattern, '(', n);
+    pattern[n] = 'a';
+    memset(pattern + n + 1, ')', n);
+    pattern[2 * n + 1] = 0;
+    return pattern;
+}
+
+static char *build_nested_stars(size_t n)
+{
+    char *pattern = malloc(3 * n + 2);
+    memset(pattern, '(', n);
+    pattern[n] = 'a';
+    for (size_t i = 0; i < n; i++)
+        memcpy(pattern + n + 1 + 2 * i, ")*", 2);
+    pattern[3 * n + 1] = 0;
+    return pattern;
+}
+
+/**
+ * A class of n printable characters followed by a literal, the characters
+ * with a meaning in a class are left out.
+ */
+static char *build_large_class(size_t n)
+{
+    char *pattern = malloc(n + 5);
+    size_t length = 0;
+    pattern[length++] = '[';
+    for (char c = '!'; c <= '~' && length <= n; c++)
+        if (strchr("\\]^-", c) == NULL)
+            pattern[length++] = c;
+    memcpy(pattern + length, "]+a", 4);
+    return pattern;
+}
+
+static char *build_alternation(size_t n)
+{
+    char *pattern = malloc(n * 8 + 1);
+    size_t length = 0;
+    for (size_t i = 0; i < n; i++)
+        length += sprintf(pattern + length, i == 0 ? "w%zu" : "|w%zu", i);
+    return pattern;
+}
+
+static const Family families[] = {
+    { "dfa_blowup", build_dfa_blowup,
+      { 1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20 } },
+    { "repetition", build_repetition,
+      { 16, 64, 256, 1024, 4096, 16384 } },
+    { "bounded_repetition", build_bounded_repetition,
+      { 4, 8, 16, 32, 64, 128, 256, 512 } },
+    { "nested_groups", build_nested_groups,
+      { 8, 32, 128, 512, 2048 } },
+    { "nested_stars", build_nested_stars,
+      { 2, 8, 32, 128, 512 } },
+    { "large_class", build_large_class, { 8, 16, 32, 64, 90 } },
+    { "alternation", build_alternation,
+      { 8, 32, 128, 512, 2048, 8192 } },
+};
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void send_record(int fd, Stage stage, double start, size_t states,
+                        const Arena *arena)
+{
+    StageRecord record = { .stage = stage, .seconds = now() - start,
+                           .states = states,
+                           .arena_bytes = arena_allocated(arena) };
+    if (write(fd, &record, sizeof(record)) != sizeof(record))
+        _exit(1);
+}
+
+/**
+ * Run the stages of regex_compile on a pattern, in the child process.
+ * Nothing is freed, the process exits right after.
+ */
+static void compile_stages(int fd, const char *pattern)
+{
+    Arena *arena = arena_create();
+    arena_set_active(arena);
+
+    double start = now();
+    Array *tokens = tokenize(pattern);
+    send_record(fd, STAGE_TOKENIZE, start, SIZE_MAX, arena);
+    if (tokens == NULL)
+        _exit(3);
+
+    start = now();
+    BinTree *tree = parse_symbols(tokens);
+    send_record(fd, STAGE_PARSE_SYMBOLS, start, SIZE_MAX, arena);
+
+    start = now();
+    Automaton *aut = thompson(tree);
+    send_record(fd, STAGE_THOMPSON, start, aut->size, arena);
+
+    start = now();
+    automaton_delete_epsilon_tr(aut);
+    send_record(fd, STAGE_DELETE_EPSILON, start, aut->size, arena);
+
+    start = now();
+    automaton_prune(aut);
+    send_record(fd, STAGE_PRUNE, start, aut->size, arena);
+
+    start = now();
+    Automaton *dfa = determine(aut);
+    send_record(fd, STAGE_DETERMINE, start, dfa->size, arena);
+
+    start = now();
+    Automaton *minimized = minimize(aut);
+    send_record(fd, STAGE_MINIMIZE, start, minimized->size, arena);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    StageRecord peak = { .stage = STAGE_COUNT, .seconds = 0,
+                         .states = usage.ru_maxrss, .arena_bytes = 0 };
+    if (write(fd, &peak, sizeof(peak)) != sizeof(peak))
+        _exit(1);
+    _exit(0);
+}
+
+static void json_pattern(FILE *out, const char *pattern)
+{
+    fputc('"', out);
+    size_t i = 0;
+    for (; pattern[i] != 0 && i < PATTERN_DISPLAY_LENGTH; i++)
+    {
+        if (pattern[i] == '"' || pattern[i] == '\\')
+            fputc('\\', out);
+        fputc(pattern[i], out);
+    }
+    fprintf(out, pattern[i] == 0 ? "\"" : "...\"");
+}
+
+/**
+ * Compile a pattern in a child process, so that its peak memory is its own
+ * and a pattern taking too long or too much memory can be stopped.
+ * @return 1 if the pattern was compiled.
+ */
+static int bench_pattern(FILE *out, const Family *family, size_t n,
+                         unsigned timeout, size_t memory_limit)
+{
+    char *pattern = family->build(n);
+    int fds[2];
+    if (pipe(fds) != 0)
+        err(1, "pipe");
+    fflush(out);
+
+    pid_t pid = fork();
+    if (pid == -1)
+        err(1, "fork");
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (memory_limit != 0)
+        {
+            struct rlimit limit = { memory_limit, memory_limit };
+            setrlimit(RLIMIT_AS, &limit);
+        }
+        alarm(timeout);
+        compile_stages(fds[1], pattern);
+    }
+    close(fds[1]);
+
+    StageRecord records[STAGE_COUNT + 1];
+    size_t nb_records = 0;
+    while (nb_records < STAGE_COUNT + 1
+           && read(fds[0], records + nb_records, sizeof(StageRecord))
+                  == sizeof(StageRecord))
+        nb_records++;
+    close(fds[0]);
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1)
+        err(1, "waitpid");
+
+    const char *result = "ok";
+    if (WIFSIGNALED(status))
+        result = WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+    else if (WEXITSTATUS(status) == 3)
+        result = "literal";
+    else if (WEXITSTATUS(status) != 0)
+        result = "failed";
+
+    fprintf(out, "    {\"family\": \"%s\", \"n\": %zu, \"pattern\": ",
+            family->name, n);
+    json_pattern(out, pattern);
+    fprintf(out, ", \"pattern_length\": %zu,\n     \"status\": \"%s\"",
+            strlen(pattern), result);
+    if (nb_records < STAGE_COUNT)
+        fprintf(out, ", \"stopped_in\": \"%s\"", stage_names[nb_records]);
+
+    double total = 0;
+    for (size_t i = 0; i < nb_records && i < STAGE_COUNT; i++)
+        if (state_names[i] != NULL)
+            fprintf(out, ", \"%s\": %zu", state_names[i], records[i].states);
+    fprintf(out, ",\n     \"stage_ms\": {");
+    for (size_t i = 0; i < nb_records && i < STAGE_COUNT; i++)
+    {
+        fprintf(out, "%s\"%s\": %.3f", i == 0 ? "" : ", ", stage_names[i],
+                records[i].seconds * 1e3);
+        if (i != STAGE_DETERMINE)
+            total += records[i].seconds;
+    }
+    fprintf(out, "},\n     \"compile_ms\": %.3f", total * 1e3);
+    if (nb_records > 0)
+        fprintf(out, ", \"arena_bytes\": %zu",
+                records[nb_records > STAGE_COUNT ? STAGE_COUNT - 1
+                                                 : nb_records - 1]
+                    .arena_bytes);
+    if (nb_records == STAGE_COUNT + 1)
+        fprintf(out, ", \"peak_rss_kb\": %zu", records[STAGE_COUNT].states);
+    fprintf(out, "}");
+
+    free(pattern);
+    return nb_records == STAGE_COUNT + 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: rationl-compile-bench [-t seconds] [-m megabytes] "
+            "[-o output] [family...]\n"
+            "  -t seconds    time limit of a compilation (default: %d)\n"
+            "  -m megabytes  memory limit of a compilation (default: none)\n"
+            "  -o output     file to write (default: standard output)\n"
+            "families:",
+            DEFAULT_TIMEOUT);
+    for (size_t i = 0; i < sizeof(families) / sizeof(*families); i++)
+        fprintf(stderr, " %s", families[i].name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+static int selected(const Family *family, int argc, char **argv)
+{
+    if (optind == argc)
+        return 1;
+    for (int i = optind; i < argc; i++)
+        if (strcmp(argv[i], family->name) == 0)
+            return 1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned timeout = DEFAULT_TIMEOUT;
+    size_t memory_limit = 0;
+    const char *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:m:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            timeout = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            memory_limit = strtoul(optarg, NULL, 10) << 20;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (timeout == 0)
+        usage();
+    size_t nb_families = sizeof(families) / sizeof(*families);
+    for (int i = optind; i < argc; i++)
+    {
+        size_t j = 0;
+        while (j < nb_families && strcmp(argv[i], families[j].name) != 0)
+            j++;
+        if (j == nb_families)
+            usage();
+    }
+
+    FILE *out = output == NULL ? stdout : fopen(output, "w");
+    if (out == NULL)
+        err(1, "cannot open %s", output);
+
+    fprintf(out, "{\n  \"timeout_s\": %u,\n  \"memory_limit_mb\": %zu,\n",
+            timeout, memory_limit >> 20);
+    fprintf(out, "  \"results\": [\n");
+    int first = 1;
+    for (size_t i = 0; i < nb_families; i++)
+    {
+        if (!selected(families + i, argc, argv))
+            continue;
+        // Stop at the first size over the limits, the next ones are bigger
+        for (size_t j = 0; j < 16 && families[i].sizes[j] != 0; j++)
+        {
+            fprintf(out, first ? "" : ",\n");
+            first = 0;
+            if (!bench_pattern(out, families + i, families[i].sizes[j],
+                               timeout, memory_limit))
+                break;
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout && fclose(out) != 0)
+        err(1, "cannot write %s", output);
+
+    return 0;
+}
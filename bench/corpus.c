@@ -0,0 +1,172 @@
+#include "corpus.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_LENGTH 80
+
+static const char *names[] = { "logs", "source", "random", "dna" };
+
+static const char *methods[] = { "GET", "GET", "GET", "POST", "HEAD" };
+static const char *paths[] = { "index", "login", "static", "api", "search",
+                               "images", "favicon", "about" };
+static const char *statuses[] = { "200", "200", "200", "304", "404", "500" };
+static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+static const char *source_lines[] = {
+    "static int count_nodes(const struct node *node)",
+    "{",
+    "    if (node == NULL)",
+    "        return 0;",
+    "    for (size_t i = 0; i < node->size; i++)",
+    "        total += count_nodes(node->children[i]);",
+    "    while (flags & 0x%x)",
+    "        flags >>= %d;",
+    "    // Skip the sentinel of the list",
+    "    char *buffer = malloc(%d * sizeof(char));",
+    "    return hash_value(key) %% capacity;",
+    "}",
+    "",
+    "#define MAX_DEPTH %d",
+};
+
+/**
+ * xorshift64*, enough to get reproducible inputs.
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+#define PICK(array, state)                                                     \
+    (array)[next_random(state) % (sizeof(array) / sizeof(*(array)))]
+
+static size_t write_log_line(char *line, size_t size, uint64_t *state)
+{
+    return snprintf(line, size,
+                    "%u.%u.%u.%u - - [%02u/%s/2021:%02u:%02u:%02u +0000] "
+                    "\"%s /%s/%u HTTP/1.1\" %s %u\n",
+                    (unsigned)(next_random(state) % 256),
+                    (unsigned)(next_random(state) % 256),
+                    (unsigned)(next_random(state) % 256),
+                    (unsigned)(next_random(state) % 256),
+                    (unsigned)(next_random(state) % 28 + 1),
+                    PICK(months, state),
+                    (unsigned)(next_random(state) % 24),
+                    (unsigned)(next_random(state) % 60),
+                    (unsigned)(next_random(state) % 60),
+                    PICK(methods, state), PICK(paths, state),
+                    (unsigned)(next_random(state) % 1000),
+                    PICK(statuses, state),
+                    (unsigned)(next_random(state) % 100000));
+}
+
+static size_t write_source_line(char *line, size_t size, uint64_t *state)
+{
+    unsigned value = next_random(state) % 4096;
+    size_t length = snprintf(line, size, PICK(source_lines, state), value);
+    if (length + 1 < size)
+    {
+        line[length++] = '\n';
+        line[length] = 0;
+    }
+    return length;
+}
+
+static size_t write_random_line(char *line, size_t size, uint64_t *state,
+                                const char *alphabet)
+{
+    size_t alphabet_size = strlen(alphabet);
+    size_t length = 0;
+    for (; length < LINE_LENGTH && length + 2 < size; length++)
+        line[length] = alphabet[next_random(state) % alphabet_size];
+    line[length++] = '\n';
+    line[length] = 0;
+    return length;
+}
+
+const char *corpus_name(CorpusKind kind)
+{
+    return names[kind];
+}
+
+char *corpus_generate(CorpusKind kind, size_t size, uint64_t seed)
+{
+    char printable[96];
+    for (size_t i = 0; i < 95; i++)
+        printable[i] = ' ' + i;
+    printable[95] = 0;
+
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + kind + 1;
+    char *corpus = malloc(size + 1);
+    if (corpus == NULL)
+        errx(1, "cannot allocate a corpus of %zu bytes", size);
+
+    char line[256];
+    size_t length = 0;
+    while (length < size)
+    {
+        size_t line_length = 0;
+        switch (kind)
+        {
+        case CORPUS_LOGS:
+            line_length = write_log_line(line, sizeof(line), &state);
+            break;
+        case CORPUS_SOURCE:
+            line_length = write_source_line(line, sizeof(line), &state);
+            break;
+        case CORPUS_RANDOM:
+            line_length =
+                write_random_line(line, sizeof(line), &state, printable);
+            break;
+        default:
+            line_length = write_random_line(line, sizeof(line), &state, "ACGT");
+            break;
+        }
+        if (line_length > size - length)
+            line_length = size - length;
+        memcpy(corpus + length, line, line_length);
+        length += line_length;
+    }
+    if (size != 0)
+        corpus[size - 1] = '\n';
+    corpus[size] = 0;
+
+    return corpus;
+}
+
+char **corpus_lines(const char *corpus, size_t *count)
+{
+    size_t capacity = 64;
+    char **lines = malloc(capacity * sizeof(char *));
+    *count = 0;
+    for (const char *line = corpus; *line != 0;)
+    {
+        const char *end = strchr(line, '\n');
+        if (end == NULL)
+            end = line + strlen(line);
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            lines = realloc(lines, capacity * sizeof(char *));
+        }
+        lines[*count] = strndup(line, end - line);
+        (*count)++;
+        line = *end == 0 ? end : end + 1;
+    }
+
+    return lines;
+}
+
+void corpus_free_lines(char **lines, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(lines[i]);
+    free(lines);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Kinds of generated inputs, each stressing the matchers differently.
+ */
+typedef enum CorpusKind
+{
+    /**
+     * Apache access log lines.
+     */
+    CORPUS_LOGS,
+    /**
+     * C-like source code.
+     */
+    CORPUS_SOURCE,
+    /**
+     * Printable ASCII characters, in lines of 80 characters.
+     */
+    CORPUS_RANDOM,
+    /**
+     * The letters A, C, G and T, in lines of 80 characters.
+     */
+    CORPUS_DNA,
+    CORPUS_COUNT
+} CorpusKind;
+
+const char *corpus_name(CorpusKind kind);
+
+/**
+ * Generate a corpus. The same kind, size and seed always give the same
+ * corpus.
+ * @param size The number of characters, the corpus ends with a newline.
+ * @return A string allocated in the heap.
+ */
+char *corpus_generate(CorpusKind kind, size_t size, uint64_t seed);
+
+/**
+ * Split a corpus on newlines.
+ * @param count Set to the number of lines.
+ * @return An array of lines allocated in the heap, along with the lines,
+ * to be freed with corpus_free_lines.
+ */
+char **corpus_lines(const char *corpus, size_t *count);
+
+void corpus_free_lines(char **lines, size_t count);
@@ -1,13 +1,35 @@
+#pragma once
+
 #include <stddef.h>
 
 /**
  * @struct reg_t
  * This type contains all the necessary informations about a regular
  * expression and it's automaton in order to be used by the functions
- * Needs to be freed using match_free
+ * Needs to be freed using regex_free
+ *
+ * A compiled expression is never modified by the matching functions, so
+ * that it can be used by several threads at the same time. The mutable
+ * state of a search lives in a regex_scratch_t, one per thread.
  */
 typedef struct reg_t reg_t;
 
+/**
+ * @struct regex_scratch_t
+ * Working memory of the matching functions. A scratch is used by a single
+ * thread at a time and can be reused for any number of searches, with any
+ * expression. Its buffers only grow: once they fit the strings searched,
+ * the functions taking a scratch do not allocate memory.
+ */
+typedef struct regex_scratch_t regex_scratch_t;
+
+/**
+ * @struct regex_set_t
+ * Patterns searched at once, that can be added and removed without
+ * compiling the others again. See regex_set_create.
+ */
+typedef struct regex_set_t regex_set_t;
+
 typedef struct match
 {
 	/**
@@ -32,6 +54,192 @@ typedef struct match
     char **groups;
 } match;
 
+/**
+ * The steps of the compilation of a pattern, see regex_compile_stats.
+ */
+typedef enum regex_stage
+{
+    REGEX_STAGE_TOKENIZE,
+    REGEX_STAGE_PARSE,
+    REGEX_STAGE_THOMPSON,
+    REGEX_STAGE_DELETE_EPSILON,
+    REGEX_STAGE_PRUNE,
+    /**
+     * Determinization without minimization, see REGEX_LEVEL_DFA.
+     */
+    REGEX_STAGE_DETERMINIZE,
+    REGEX_STAGE_MINIMIZE,
+    /**
+     * Flattening of the minimized automaton into the matching table.
+     */
+    REGEX_STAGE_TABLE,
+    REGEX_STAGE_COUNT
+} regex_stage;
+
+typedef struct regex_stage_stats
+{
+	/**
+	* Wall time spent in the stage, in seconds.
+	*/
+    double seconds;
+	/**
+	* The number of states and transitions of the automaton built by the
+	* stage, 0 for the stages before the automaton.
+	*/
+    size_t states;
+    size_t transitions;
+} regex_stage_stats;
+
+/**
+ * @struct regex_stats
+ * Cost of the compilation of a regular expression. The stages a
+ * compilation did not go through are left to 0.
+ */
+typedef struct regex_stats
+{
+    regex_stage_stats stages[REGEX_STAGE_COUNT];
+	/**
+	* The number of groups of the expression.
+	*/
+    size_t nb_groups;
+	/**
+	* The number of transitions of the table entering or leaving groups.
+	*/
+    size_t group_tags;
+	/**
+	* Size of the matching table.
+	*/
+    size_t table_bytes;
+	/**
+	* The number and total size of the allocations made while compiling,
+	* intermediate automata included.
+	*/
+    size_t allocations;
+    size_t allocated_bytes;
+	/**
+	* Non zero if the DFA went over the budget of the compilation, the
+	* expression is then matched by simulating its NFA.
+	*/
+    int nfa_fallback;
+} regex_stats;
+
+/**
+ * How far the compilation of a pattern goes, see regex_options. The higher
+ * levels take longer to compile and match faster.
+ */
+typedef enum regex_level
+{
+    /**
+     * The level of regex_compile, REGEX_LEVEL_MINIMAL.
+     */
+    REGEX_LEVEL_DEFAULT,
+    /**
+     * Level 0: the NFA is not determinized, matching simulates it.
+     */
+    REGEX_LEVEL_NFA,
+    /**
+     * Level 1: the NFA is determinized into a table, without being
+     * minimized.
+     */
+    REGEX_LEVEL_DFA,
+    /**
+     * Level 2: the DFA is minimized, and its table compiled to native code
+     * when the library is built with the JIT.
+     */
+    REGEX_LEVEL_MINIMAL
+} regex_level;
+
+/**
+ * The engine matching an expression, see regex_options.
+ */
+typedef enum regex_engine
+{
+    /**
+     * The engine of the level of the compilation.
+     */
+    REGEX_ENGINE_AUTO,
+    /**
+     * The simulation of the NFA, whatever the level.
+     */
+    REGEX_ENGINE_NFA,
+    /**
+     * The interpreted table of the DFA, at level 1 at least.
+     */
+    REGEX_ENGINE_TABLE,
+    /**
+     * The table compiled to native code, at level 1 at least. The table is
+     * interpreted when the library is built without the JIT.
+     */
+    REGEX_ENGINE_NATIVE
+} regex_engine;
+
+/**
+ * @struct regex_options
+ * Limits and level of the compilation of a pattern, see
+ * regex_compile_options. The options left to 0 are those of regex_compile.
+ * A pattern without operators always compiles to a table and is searched
+ * as a literal: the limits, the level and the engine do not apply to it.
+ */
+typedef struct regex_options
+{
+	/**
+	* Maximum number of states of the DFA built while compiling, 0 for no
+	* limit.
+	*/
+    size_t max_dfa_states;
+	/**
+	* Maximum number of bytes allocated while compiling, 0 for no limit.
+	*/
+    size_t max_memory;
+	/**
+	* Non zero to count the uses of the expression, see regex_get_counters.
+	*/
+    int counters;
+	/**
+	* How far the compilation goes, e.g. REGEX_LEVEL_NFA for a pattern
+	* matched against a few short strings.
+	*/
+    regex_level level;
+    regex_engine engine;
+	/**
+	* Non zero to compile the groups as plain parentheses: the matches have
+	* no groups, and nothing is spent on capturing them.
+	*/
+    int no_captures;
+	/**
+	* Non zero to keep the automaton of the compilation in the expression,
+	* as it was built. By default it is dropped once the expression is
+	* compiled, or replaced by a flat copy when no DFA was built, see
+	* regex_memory_usage.
+	*/
+    int no_finalize;
+} regex_options;
+
+/**
+ * @struct regex_counters
+ * Uses of an expression compiled with the counters option, summed over
+ * all the threads.
+ */
+typedef struct regex_counters
+{
+	/**
+	* The number of calls to the matching functions.
+	*/
+    size_t calls;
+	/**
+	* The total length of the strings given to the matching functions.
+	*/
+    size_t bytes_scanned;
+	/**
+	* The number of matches found, or of replacements made.
+	*/
+    size_t matches;
+	/**
+	* Time spent extracting the groups of the matches, in seconds.
+	*/
+    double capture_seconds;
+} regex_counters;
+
 /**
  * Compiles a pattern into a regular expression without operators
  * This functions optimises the compilation of the regular expression
@@ -51,6 +259,83 @@ reg_t regexp_compile_string(char *pattern);
 */
 reg_t regex_compile(char* pattern);
 
+/**
+ * Compiles a pattern into a regular expression within limits, at the level
+ * and for the engine of the options.
+ * When the DFA does not fit in the limits its construction is abandoned,
+ * and the expression is matched by simulating the NFA of the pattern:
+ * matching is slower but gives the same results. If the NFA itself does
+ * not fit in the memory limit, the returned expression matches nothing and
+ * rationl_errno is set to EBUDGET.
+ * @param pattern: string containing the pattern to compile.
+ * @param options: The limits, NULL for none as with regex_compile.
+ * @return The compiled regular expression.
+*/
+reg_t regex_compile_options(char *pattern, const regex_options *options);
+
+/**
+ * Compiles a pattern into a regular expression matched at once by its NFA,
+ * while the DFA is compiled in the background by the worker thread of the
+ * library. Once the DFA is ready the expression switches to it, atomically
+ * for the threads matching it: the results are the same, only faster.
+ * The expression can be used, referenced and freed at any time.
+ * @param pattern: string containing the pattern to compile.
+ * @param options: The options of the compilation of the DFA, NULL for
+ * those of regex_compile. At level 0 nothing is compiled in the
+ * background.
+ * @return The compiled regular expression.
+*/
+reg_t regex_compile_async(char *pattern, const regex_options *options);
+
+/**
+ * Waits for the compilation of an expression in the background, see
+ * regex_compile_async. Returns at once for the other expressions.
+ * @param re: The regular expression.
+ * @return 0 if the expression is matched by its DFA, -1 if it is not, e.g.
+ * its DFA went over budget.
+*/
+int regex_wait(reg_t re);
+
+/**
+ * Gets the cost of the compilation of a regular expression.
+ * The statistics are recorded by every compilation, an expression loaded
+ * with regex_load only has the size of its table.
+ * @param re: The regular expression.
+ * @param stats: Filled with the statistics.
+*/
+void regex_compile_stats(reg_t re, regex_stats *stats);
+
+/**
+ * Describes how a regular expression is matched: what the analysis of its
+ * pattern found (literals, prefix and required literal, positions, groups,
+ * estimated DFA size), the automaton built, and the engine chosen for
+ * regex_match, regex_search and regex_sub.
+ * @param re: The regular expression.
+ * @return A string allocated in the heap, one property per line.
+*/
+char *regex_explain(reg_t re);
+
+/**
+ * Gets the memory held by a compiled regular expression: its DFA table and
+ * native code, its NFA when it has no table, the backtracker of its groups
+ * and its counters, along with those of the expression compiled by
+ * regex_compile_async once it is published.
+ * @param re: The regular expression.
+ * @return The number of bytes.
+*/
+size_t regex_memory_usage(reg_t re);
+
+/**
+ * Gets the counters of an expression compiled with the counters option of
+ * regex_compile_options. The counters are updated without locks by each
+ * thread and summed when read, the uses running at the same time may or
+ * may not be counted.
+ * @param re: The regular expression.
+ * @param counters: Filled with the counters.
+ * @return 0 on success, -1 if the expression has no counters.
+*/
+int regex_get_counters(reg_t re, regex_counters *counters);
+
 /**
  * Compiles a regular expression from an automaton daut file format
  * @param pattern: path to a .daut file.
@@ -58,6 +343,61 @@ reg_t regex_compile(char* pattern);
 */
 reg_t regex_read_daut(char *path);
 
+/**
+ * Saves a compiled regular expression in a binary file.
+ * The file contains the flat tables of the automaton and can be
+ * loaded back with regex_load without being compiled again.
+ * @param re: The regular expression.
+ * @param path: Path of the file to write.
+ * @return 0 on success, -1 on error.
+*/
+int regex_save(reg_t re, const char *path);
+
+/**
+ * Loads a regular expression saved with regex_save.
+ * The file is mapped in memory and its tables are used in place: nothing
+ * is parsed nor compiled. The version and checksum of the file are
+ * verified, if they are invalid nothing is matched by the returned
+ * expression.
+ * @param path: Path of the file to load.
+ * @return The regular expression, to be freed with regex_free.
+*/
+reg_t regex_load(const char *path);
+
+/**
+ * Generates a C source file matching a compiled regular expression.
+ * The file does not depend on the library, see rationl-gen(1) for the
+ * functions it defines.
+ * @param re: The regular expression.
+ * @param prefix: Prefix of the generated symbols, a valid C identifier.
+ * @param path: Path of the file to write, NULL for the standard output.
+ * @return 0 on success, -1 on error.
+*/
+int regex_generate_c(reg_t re, const char *prefix, const char *path);
+
+/**
+ * Gets another reference to a compiled regular expression.
+ * The expression is shared, not copied: it is freed once regex_free has
+ * been called on every reference. A reference can be handed to another
+ * thread.
+ * @param re: The regular expression.
+ * @return The new reference.
+*/
+reg_t regex_ref(reg_t re);
+
+/**
+ * Allocates a scratch for the matching functions, sized for an expression.
+ * @param re: The regular expression the scratch is mostly used with.
+ * @return The scratch, to be freed with regex_scratch_free.
+*/
+regex_scratch_t *regex_scratch_create(reg_t re);
+
+/**
+ * Frees a scratch.
+ * @param scratch: The scratch to free.
+*/
+void regex_scratch_free(regex_scratch_t *scratch);
+
 /**
  * Matches the pattern against str parameter and returns a match
  * value.
@@ -68,6 +408,17 @@ reg_t regex_read_daut(char *path);
 */
 match *regex_match(reg_t re, char* str);
 
+/**
+ * Same as regex_match, with the match stored in a scratch.
+ * @param re: The regular expression.
+ * @param scratch: A scratch owned by the calling thread.
+ * @param str: The string to match against.
+ * @return The match, valid until the next use of the scratch and not to be
+ * freed, or NULL.
+*/
+const match *regex_match_r(reg_t re, regex_scratch_t *scratch,
+                           const char *str);
+
 /**
  * Matches the pattern against str parameter and returns all submatches as a list
  * Fills the groups array with the currect matches structs.
@@ -78,6 +429,46 @@ match *regex_match(reg_t re, char* str);
 */
 size_t regex_search(reg_t re, char *str, match **groups[]);
 
+/**
+ * Same as regex_search, with the matches and their groups stored in a
+ * scratch.
+ * @param re: The regular expression.
+ * @param scratch: A scratch owned by the calling thread.
+ * @param str: The string to match against.
+ * @param matches: Set to the array of matches, valid until the next use of
+ * the scratch and not to be freed.
+ * @return The number of matches
+*/
+size_t regex_search_r(reg_t re, regex_scratch_t *scratch, const char *str,
+                      const match **matches);
+
+/**
+ * Same as regex_search_r, without the groups of the matches: their bounds
+ * are found by the DFA alone, which costs the same with or without groups.
+ * The groups of a match are captured on demand by regex_groups_r.
+ * @param re: The regular expression.
+ * @param scratch: A scratch owned by the calling thread.
+ * @param str: The string to match against.
+ * @param matches: Set to the array of matches, without groups, valid until
+ * the next use of the scratch by another function than regex_groups_r.
+ * @return The number of matches
+*/
+size_t regex_search_spans_r(reg_t re, regex_scratch_t *scratch,
+                            const char *str, const match **matches);
+
+/**
+ * Captures the groups of a match found by regex_search_spans_r. Only the
+ * text of the match is read again.
+ * @param re: The regular expression that found the match.
+ * @param scratch: A scratch owned by the calling thread, e.g. the one of
+ * the search.
+ * @param m: The match.
+ * @return A copy of the match with its groups, valid until the next use of
+ * the scratch and not to be freed. The matches of the search stay valid.
+*/
+const match *regex_groups_r(reg_t re, regex_scratch_t *scratch,
+                            const match *m);
+
 /**
  * Substitute matches of re in str by sub.
  * @param re: The regular expression.
@@ -88,7 +479,80 @@ size_t regex_search(reg_t re, char *str, match **groups[]);
 char *regex_sub(reg_t re, char *str, char *sub);
 
 /**
- * Frees the regular expression.
+ * Same as regex_sub, with the replaced string stored in a scratch.
+ * @param re: The regular expression.
+ * @param scratch: A scratch owned by the calling thread.
+ * @param str: The string to match against.
+ * @param sub: The string to replace with
+ * @return The replaced string, valid until the next use of the scratch and
+ * not to be freed.
+*/
+const char *regex_sub_r(reg_t re, regex_scratch_t *scratch, const char *str,
+                        const char *sub);
+
+/**
+ * Creates an empty set of patterns. The patterns are split in shards of a
+ * few dozen patterns, and a shard is compiled again only when one of its
+ * patterns is added or removed.
+ * The set may be searched by several threads, each with its own scratch,
+ * but not while it is updated.
+ * @param options: The options of the compilation of the patterns, or NULL.
+ * The counters are never enabled.
+ * @return The set, to be freed with regex_set_free.
+*/
+regex_set_t *regex_set_create(const regex_options *options);
+
+/**
+ * Adds a pattern to a set.
+ * @param set: The set.
+ * @param pattern: The pattern, copied by the set.
+ * @return The id of the pattern, never given to another pattern of the
+ * set, even once it is removed, or -1 if the pattern ends in a lone '\' or
+ * in an unclosed '['. rationl_errno is then set to EBADFMT.
+*/
+long regex_set_add(regex_set_t *set, char *pattern);
+
+/**
+ * Removes a pattern from a set.
+ * @param set: The set.
+ * @param id: The id returned by regex_set_add.
+ * @return 0, or -1 if the set has no pattern of this id.
+*/
+int regex_set_remove(regex_set_t *set, long id);
+
+/**
+ * @return The number of patterns of a set.
+*/
+size_t regex_set_size(const regex_set_t *set);
+
+/**
+ * Allocates the mutable state of the searches of a set by a thread.
+ * @param set: The set.
+ * @return The scratch, to be freed with regex_scratch_free.
+*/
+regex_scratch_t *regex_set_scratch_create(const regex_set_t *set);
+
+/**
+ * Finds the patterns of a set found somewhere in a string.
+ * @param set: The set.
+ * @param scratch: A scratch owned by the calling thread.
+ * @param str: The string to search.
+ * @param ids: Where to store the ids of the patterns found, in increasing
+ * order, valid until the next use of the scratch and not to be freed.
+ * @return The number of patterns found.
+*/
+size_t regex_set_match(const regex_set_t *set, regex_scratch_t *scratch,
+                       const char *str, const size_t **ids);
+
+/**
+ * Frees a set and its patterns.
+ * @param set: The set to free, or NULL.
+*/
+void regex_set_free(regex_set_t *set);
+
+/**
+ * Frees the regular expression, or only drops the reference if other
+ * references obtained with regex_ref are still alive.
  * @param re the regular expression to free.
  */
 void regex_free(reg_t re);
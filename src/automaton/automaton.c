@@ -21,6 +21,99 @@ LinkedList *get_matrix_elt(const Automaton *automaton, size_t state_id,
     return matrix_get(automaton->transition_table, index, state_id);
 }
 
+void automaton_thaw(Automaton *automaton)
+{
+    if (automaton->csr == NULL)
+        return;
+    SAFEFREE(automaton->csr->offsets);
+    SAFEFREE(automaton->csr->edges);
+    SAFEFREE(automaton->csr);
+    automaton->csr = NULL;
+}
+
+const AutomatonCsr *automaton_freeze(Automaton *automaton)
+{
+    if (automaton->csr != NULL)
+        return automaton->csr;
+
+    // Columns of the matrix sorted by symbol
+    size_t columns[NUMBER_OF_SYMB];
+    uint16_t labels[NUMBER_OF_SYMB];
+    size_t column_count = 0;
+    for (size_t symb = 0; symb < NUMBER_OF_SYMB; symb++)
+    {
+        if (automaton->lookup_table[symb] == -1)
+            continue;
+        columns[column_count] = automaton->lookup_table[symb];
+        labels[column_count++] = symb;
+    }
+
+    AutomatonCsr *csr = SAFEMALLOC(sizeof(AutomatonCsr));
+    csr->size = automaton->size;
+    csr->offsets = SAFECALLOC(automaton->size + 1, sizeof(size_t));
+    for (size_t state = 0; state < automaton->size; state++)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < column_count; i++)
+        {
+            LinkedList *list =
+                matrix_get(automaton->transition_table, columns[i], state);
+            for (LinkedList *l = list == NULL ? NULL : list->next; l != NULL;
+                 l = l->next)
+                count++;
+        }
+        csr->offsets[state + 1] = csr->offsets[state] + count;
+    }
+
+    csr->edges =
+        SAFEMALLOC(csr->offsets[automaton->size] * sizeof(AutomatonEdge) + 1);
+    size_t edge = 0;
+    for (size_t state = 0; state < automaton->size; state++)
+    {
+        for (size_t i = 0; i < column_count; i++)
+        {
+            LinkedList *list =
+                matrix_get(automaton->transition_table, columns[i], state);
+            list_foreach(State *, dst, list)
+            {
+                csr->edges[edge].target = dst->id;
+                csr->edges[edge].label = labels[i];
+                edge++;
+            }
+        }
+    }
+
+    automaton->csr = csr;
+    return csr;
+}
+
+const AutomatonEdge *automaton_get_targets(Automaton *automaton,
+                                           size_t state_id, Letter value,
+                                           int is_epsilon, size_t *count)
+{
+    const AutomatonCsr *csr = automaton_freeze(automaton);
+    uint16_t label = (is_epsilon != 0) ? EPSILON_INDEX : value;
+
+    // Binary search of the first edge with the label
+    size_t low = csr->offsets[state_id];
+    size_t high = csr->offsets[state_id + 1];
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (csr->edges[middle].label < label)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    size_t end = low;
+    while (end < csr->offsets[state_id + 1] && csr->edges[end].label == label)
+        end++;
+    *count = end - low;
+
+    return csr->edges + low;
+}
+
 int state_is_entry(Automaton * automaton, State * s)
 {
     arr_foreach(State *, entry, automaton->starting_states)
@@ -47,29 +140,31 @@ Automaton *automaton_create(size_t state_count, size_t letter_count)
     autom->is_determined = 0;
 
     autom->nb_groups = 0;
-    autom->entering_transitions = Map(Transition, Map *, hash_transition, compare_transitions);
-    autom->leaving_transitions = Map(Transition, Map *, hash_transition, compare_transitions);
+    autom->entering_transitions = Map(Transition, BitSet *, hash_transition, compare_transitions);
+    autom->leaving_transitions = Map(Transition, BitSet *, hash_transition, compare_transitions);
+    autom->csr = NULL;
     
     return autom;
 }
 
 void automaton_free(Automaton *automaton)
 {
+    automaton_thaw(automaton);
     // Frees the states.
-    arr_foreach(State *, s, automaton->states) free(s);
+    arr_foreach(State *, s, automaton->states) SAFEFREE(s);
     array_free(automaton->states);
     matrix_free(automaton->transition_table);
     array_free(automaton->starting_states);
-    free(automaton->lookup_table);
+    SAFEFREE(automaton->lookup_table);
     
     Map * cpy = automaton->entering_transitions;
     //Need a foreach value in Map
     //Sorry...
     {
         map_foreach_value(
-            Map *, set, cpy,
+            BitSet *, set, cpy,
             {
-                map_free(set);
+                bitset_free(set);
             })
         map_free(automaton->entering_transitions);
     }
@@ -77,14 +172,14 @@ void automaton_free(Automaton *automaton)
     cpy = automaton->leaving_transitions;
     //Need a foreach value in Map
     map_foreach_value(
-        Map *, set_, cpy,
+        BitSet *, set_, cpy,
         {
-            map_free(set_);
+            bitset_free(set_);
         })
 
     map_free(automaton->leaving_transitions);
     
-    free(automaton);
+    SAFEFREE(automaton);
 }
 
 Transition _generate_transition(State * src, State * dst, Letter value,int epsilon)
@@ -107,14 +202,11 @@ Transition _generate_transition(State * src, State * dst, Letter value,int epsil
 
 void _remove_transition_from_map(Map * map, Transition * tr)
 {
-    Map ** group_set_ptr = map_delete(map, tr);
-    if(group_set_ptr != NULL)
+    BitSet * group_set;
+    if(map_delete(map, tr, &group_set))
     {
-        map_free(*group_set_ptr);
+        bitset_free(group_set);
     }
-    free(group_set_ptr);
-
-    free(map_delete(map, tr));
 }
 
 void _automaton_remove_transition_from_maps(Automaton * automaton, 
@@ -136,6 +228,7 @@ State *state_create(int is_terminal)
 
 void automaton_add_state(Automaton *automaton, State *state, int is_entry)
 {
+    automaton_thaw(automaton);
 
     if(automaton->size + 1 > automaton->capacity)
     {
@@ -153,6 +246,7 @@ void automaton_add_state(Automaton *automaton, State *state, int is_entry)
 void automaton_add_transition(Automaton *automaton, State *src, State *dst,
                               Letter value, int epsilon)
 {
+    automaton_thaw(automaton);
     size_t i = (epsilon != 0) ? EPSILON_INDEX : value;
     int mat_col = automaton->lookup_table[i];
     
@@ -181,6 +275,7 @@ void automaton_add_transition(Automaton *automaton, State *src, State *dst,
 int automaton_remove_transition(Automaton *automaton, State *src, State *dst,
                                 Letter value, int epsilon)
 {
+    automaton_thaw(automaton);
     _automaton_remove_transition_from_maps(automaton, src, dst, value, epsilon);
     LinkedList *start = get_matrix_elt(automaton, src->id, value, epsilon);
     // Skip the sentinel
@@ -215,174 +310,221 @@ int automaton_remove_transition(Automaton *automaton, State *src, State *dst,
 void _free_start_marked_as_entering(Automaton * automaton, State * s)
 {
     Transition tr = _generate_transition(NULL, s, 0, 1);
-    Map ** set_ptr = map_delete(automaton->entering_transitions, &tr);
-    if(set_ptr != NULL)
+    BitSet * set;
+    if(map_delete(automaton->entering_transitions, &tr, &set))
     {
-        map_free(*set_ptr);
+        bitset_free(set);
     }
-    free(set_ptr);
 }
 
 
 void automaton_remove_state(Automaton *automaton, State *state)
 {
-    // Remove all transitions pointing to it
-    State * src;
-    LinkedList * tr_list;
-    for(size_t symb = 0; symb < NUMBER_OF_SYMB; symb ++)
-    {
-        for(size_t i = 0; i < state->id; i++)
+    uint8_t *mask = SAFECALLOC(automaton->size, sizeof(uint8_t));
+    mask[state->id] = 1;
+    automaton_remove_states(automaton, mask);
+    SAFEFREE(mask);
+}
+
+/**
+ * Move the tags of a map to the new ids of their states, the tags of a
+ * transition touching a removed state are dropped.
+ * Ids are shifted by one in the keys, 0 standing for the outside.
+ */
+static Map *remap_tag_map(Map *map, const size_t *new_ids)
+{
+    Map *remapped = Map(Transition, BitSet *, hash_transition,
+                        compare_transitions);
+    map_foreach_key(Transition, tr, map, {
+        BitSet *set = *(BitSet **)map_get(map, &tr);
+        size_t src = tr.old_src == 0 ? 0 : new_ids[tr.old_src - 1];
+        size_t dst = tr.old_dst == 0 ? 0 : new_ids[tr.old_dst - 1];
+        if (src == SIZE_MAX || dst == SIZE_MAX)
         {
-            src = *(State **)array_get(automaton->states, i);
-            automaton_remove_transition(automaton, src, state, symb, symb == EPSILON_INDEX);
+            bitset_free(set);
+            continue;
         }
+        tr.old_src = tr.old_src == 0 ? 0 : src + 1;
+        tr.old_dst = tr.old_dst == 0 ? 0 : dst + 1;
+        map_set(remapped, &tr, &set);
+    })
+    map_free(map);
+
+    return remapped;
+}
 
-        for(size_t i = state->id + 1; i < automaton->size; i++)
+/**
+ * Remove the removed states from a list of targets.
+ * @return The list, or NULL if it was freed because it became empty.
+ */
+static LinkedList *filter_targets(LinkedList *list, const uint8_t *mask)
+{
+    if (list == NULL)
+        return NULL;
+
+    LinkedList *node = list->next;
+    while (node != NULL)
+    {
+        LinkedList *next = node->next;
+        if (mask[(*(State **)node->data)->id])
         {
-            src = *(State **)array_get(automaton->states, i);
-            automaton_remove_transition(automaton, src, state, symb, symb == EPSILON_INDEX);
+            node->previous->next = next;
+            if (next != NULL)
+                next->previous = node->previous;
+            node->next = NULL;
+            list_free_from(node);
         }
+        node = next;
     }
 
-    // Remove from starting_states
-    size_t antoine = 0;
-    arr_foreach(State *, s, automaton->starting_states)
+    if (list->next != NULL)
+        return list;
+    list_free(list);
+    return NULL;
+}
+
+void automaton_remove_states(Automaton *automaton, const uint8_t *mask)
+{
+    automaton_thaw(automaton);
+
+    size_t old_size = automaton->size;
+    size_t *new_ids = SAFEMALLOC(old_size * sizeof(size_t));
+    size_t size = 0;
+    for (size_t i = 0; i < old_size; i++)
+        new_ids[i] = mask[i] ? SIZE_MAX : size++;
+    if (size == old_size)
     {
-        if (s->id == state->id)
-        {
-            array_remove(automaton->starting_states, antoine);
-            _free_start_marked_as_entering(automaton, s);
-            break;
-        }
-        antoine++;
+        SAFEFREE(new_ids);
+        return;
     }
 
-    if(automaton->transition_table != NULL)
+    // Move the rows of the kept states up. Rows only move up so they are
+    // never overwritten before being read.
+    Matrix *table = automaton->transition_table;
+    for (size_t state = 0; table != NULL && state < old_size; state++)
     {
-        //Deal with matrix
-        //We start by freeing the lists of the line we want to delete
-        for (size_t symb = 0; symb < NUMBER_OF_SYMB; symb++)
-        {
-            if(automaton->lookup_table[symb] != -1)
-            {
-                tr_list = matrix_get(automaton->transition_table, automaton->lookup_table[symb], state->id);
-                list_foreach(State *, trg, tr_list)
-                {
-                    _automaton_remove_transition_from_maps(automaton, state, trg, symb, symb == EPSILON_INDEX);
-                }
-                list_free(tr_list);
-            }
-        }
-        
-        //Then, we shift the matrix below the deleted line by one line
-        for (size_t k = state->id; k < automaton->states->size - 1; k++)
+        for (size_t x = 0; x < table->width; x++)
         {
-            for (size_t x = 0; x < automaton->transition_table->width; x++)
+            LinkedList *list = matrix_get(table, x, state);
+            if (mask[state])
             {
-                LinkedList *list =
-                    matrix_get(automaton->transition_table, x, k + 1);
-                matrix_set(automaton->transition_table, x, k, list);
+                list_free(list);
+                continue;
             }
+            matrix_set(table, x, new_ids[state], filter_targets(list, mask));
         }
-
-        for (size_t x = 0; x < automaton->transition_table->width; x++)
-        {
-            LinkedList *null = NULL;
-            matrix_set(automaton->transition_table, x, automaton->size - 1, null);
-        }
-
-            //Then, we change the matrix height and width
-        automaton->transition_table->height --;
-        /*
-            //Finally we perform the realloc
-        automaton->transition_table = SAFEREALLOC(automaton->transition_table,
-            automaton->transition_table->width * automaton->transition_table->height * sizeof(LinkedList *));
-        
-        I don't know if reallocing is the right thing to do as we malloc what is supposed
-        to be a fixed sized automaton, however the code of add_automaton_allows to go over that
-        number
-        */
     }
-
-    // Remove from states array
-    for (size_t k = state->id + 1; k < automaton->states->size; k++)
+    if (table != NULL)
     {
-        State *another_state = *(State **)array_get(automaton->states, k);
-        another_state->id -= 1;
+        for (size_t state = size; state < old_size; state++)
+            for (size_t x = 0; x < table->width; x++)
+                matrix_set(table, x, state, NULL);
+        table->height -= old_size - size;
     }
 
-    array_remove(automaton->states, state->id);
-    automaton->size -= 1;
+    automaton->entering_transitions =
+        remap_tag_map(automaton->entering_transitions, new_ids);
+    automaton->leaving_transitions =
+        remap_tag_map(automaton->leaving_transitions, new_ids);
 
-    free(state);
-}
+    Array *starting_states = Array(State *);
+    arr_foreach(State *, start, automaton->starting_states)
+    {
+        if (!mask[start->id])
+            array_append(starting_states, &start);
+    }
+    array_free(automaton->starting_states);
+    automaton->starting_states = starting_states;
 
-Set * set_cpy(Set * set)
-{
-    Set * ret = Set(size_t, hash_size_t, compare_size_t);
-    map_foreach_key(
-        size_t, grp, set,
+    Array *states = Array(State *);
+    arr_foreach(State *, state, automaton->states)
+    {
+        if (mask[state->id])
         {
-            set_add(set, &grp);
+            SAFEFREE(state);
+            continue;
         }
-    )
-    return ret;
+        state->id = new_ids[state->id];
+        array_append(states, &state);
+    }
+    array_free(automaton->states);
+    automaton->states = states;
+    automaton->size = size;
+
+    SAFEFREE(new_ids);
 }
 
 Map * _map_cpy(Map * src)
 {
-    Map * ret =  Map(Transition, Map *, hash_transition, compare_transitions);
-    Set * set;
-    map_foreach_key(
-        Transition, tr, src,
-        {
-            set = map_get(src, &tr);
-            Set *copy = set_cpy(set);
-            map_set(ret, &tr, &copy);
-        }
-    )
+    Map * ret = map_copy(src);
+    for (size_t i = 0; i < ret->size; i++)
+    {
+        BitSet ** set = map_entry_value(ret, i);
+        *set = bitset_copy(*set);
+    }
     return ret;
 }
 
 Automaton *automaton_copy(Automaton *source)
 {
-    Automaton *copy = Automaton(source->size, source->transition_table->width);
+    Matrix *table = source->transition_table;
+    Automaton *copy = Automaton(source->size, table->width);
     copy->is_determined = source->is_determined;
     copy->nb_groups = source->nb_groups;
+    // Same columns as the source so that cells are copied as they are
+    memcpy(copy->lookup_table, source->lookup_table,
+           NUMBER_OF_SYMB * sizeof(int));
+    copy->lookup_used = source->lookup_used;
+
+    uint8_t *is_entry = SAFECALLOC(source->size, sizeof(uint8_t));
+    arr_foreach(State *, starting_state, source->starting_states)
+        is_entry[starting_state->id] = 1;
+    arr_foreach(State *, state, source->states)
+        automaton_add_state(copy, State(state->terminal), is_entry[state->id]);
+    SAFEFREE(is_entry);
 
+    for (size_t j = 0; j < source->size; j++)
     {
-        arr_foreach(State *, state, source->states)
+        for (size_t x = 0; x < table->width; x++)
         {
-            State *new_state = State(state->terminal);
-            int is_entry = 0;
-            arr_foreach(State *, starting_state, source->starting_states)
-                if (starting_state->id == state->id)
-                {
-                    is_entry = 1;
-                    break;
-                }
-            automaton_add_state(copy, new_state, is_entry);
+            LinkedList *list = matrix_get(table, x, j);
+            if (list == NULL)
+                continue;
+            LinkedList *targets = LinkedList(State *);
+            list_foreach(State *, dst, list)
+            {
+                State *target = *(State **)array_get(copy->states, dst->id);
+                list_push_back(targets, &target);
+            }
+            matrix_set(copy->transition_table, x, j, targets);
         }
     }
 
-    for (size_t i = 0; i < NUMBER_OF_SYMB; i++)
+    map_free(copy->entering_transitions);
+    map_free(copy->leaving_transitions);
+    copy->entering_transitions = _map_cpy(source->entering_transitions);
+    copy->leaving_transitions = _map_cpy(source->leaving_transitions);
+    return copy;
+}
+
+size_t automaton_transition_count(const Automaton *automaton)
+{
+    Matrix *table = automaton->transition_table;
+    size_t count = 0;
+    for (size_t j = 0; j < automaton->size; j++)
     {
-        for (size_t j = 0; j < source->size; j++)
+        for (size_t x = 0; x < table->width; x++)
         {
-            State *src = *(State **)array_get(copy->states, j);
-            LinkedList *transitions = get_matrix_elt(source, j, i, i == EPSILON_INDEX);
-            list_foreach(State *, old_dest, transitions)
-                {
-                    State *dest = *(State **)array_get(copy->states, old_dest->id);
-                    automaton_add_transition(copy, src, dest, i,
-                                             i == EPSILON_INDEX);
-                }
+            LinkedList *list = matrix_get(table, x, j);
+            if (list == NULL)
+                continue;
+            for (LinkedList *node = list->next; node != NULL;
+                 node = node->next)
+                count++;
         }
     }
 
-    copy->entering_transitions = _map_cpy(source->entering_transitions);
-    copy->leaving_transitions =_map_cpy(source->leaving_transitions);
-    return copy;
+    return count;
 }
 
 // Helpers for daut conversion
@@ -464,11 +606,11 @@ static int parse_daut_line(Automaton *automaton, const char *line,
 
     if (!is_entry && source == 0 && strcmp(source_symbol, "0") != 0)
     {
-        free(source_symbol);
+        SAFEFREE(source_symbol);
         rationl_errno = EBADFMT;
         return -1;
     }
-    free(source_symbol);
+    SAFEFREE(source_symbol);
 
     // Get the middle arrow
     if (!move_to_next(&line))
@@ -479,11 +621,11 @@ static int parse_daut_line(Automaton *automaton, const char *line,
     char *arrow_symbol = get_symbol(&line);
     if (strcmp(arrow_symbol, "->") != 0)
     {
-        free(arrow_symbol);
+        SAFEFREE(arrow_symbol);
         rationl_errno = EBADFMT;
         return -1;
     }
-    free(arrow_symbol);
+    SAFEFREE(arrow_symbol);
 
     // Get the target state
     if (!move_to_next(&line))
@@ -497,11 +639,11 @@ static int parse_daut_line(Automaton *automaton, const char *line,
     int is_terminal = strcmp(target_symbol, "$") == 0;
     if (!is_terminal && target == 0 && strcmp(target_symbol, "0") != 0)
     {
-        free(target_symbol);
+        SAFEFREE(target_symbol);
         rationl_errno = EBADFMT;
         return -1;
     }
-    free(target_symbol);
+    SAFEFREE(target_symbol);
 
     // Get the value of the transition
     const char *before = line;
@@ -524,7 +666,7 @@ static int parse_daut_line(Automaton *automaton, const char *line,
             int no = atol(no_symbol); // Assume it's right
             if (no + 1 > automaton->nb_groups)
                 automaton->nb_groups = no + 1;
-            free(no_symbol);
+            SAFEFREE(no_symbol);
             array_append(entering, &no);
             break;
         }
@@ -533,7 +675,7 @@ static int parse_daut_line(Automaton *automaton, const char *line,
             int no = atol(no_symbol);
             if (no + 1 > automaton->nb_groups)
                 automaton->nb_groups = no + 1;
-            free(no_symbol);
+            SAFEFREE(no_symbol);
             array_append(leaving, &no);
             break;
         }
@@ -632,9 +774,9 @@ void automaton_to_dot(Automaton *aut)
     { 
         if (state->terminal)
         {
-            entering_str = stringify_set(get_entering_groups(aut,
+            entering_str = stringify_bitset(get_entering_groups(aut,
                 state, NULL, 0, 1), 'E');
-            leaving_str = stringify_set(get_leaving_group(aut,
+            leaving_str = stringify_bitset(get_leaving_group(aut,
                 state, NULL, 0, 1), 'S');
             printf("  %zu[xlabel=\"%s %s\"];\n", state->id, entering_str,
                 leaving_str);
@@ -645,7 +787,7 @@ void automaton_to_dot(Automaton *aut)
     puts("  node [shape = circle];");
     arr_foreach(State *, state_2, aut->starting_states)
     {
-        entering_str = stringify_set(get_entering_groups(aut,
+        entering_str = stringify_bitset(get_entering_groups(aut,
                     NULL, state_2, 0, 1), 'E');
         printf("  q%zu -> %zu[label=\"%s\"]\n", state_2->id, state_2->id, 
             entering_str);
@@ -666,9 +808,9 @@ void automaton_to_dot(Automaton *aut)
             list_foreach(State *, target, list)
             {
                 s = *(State **)array_get(aut->states, src);
-                entering_str = stringify_set(get_entering_groups(aut,
+                entering_str = stringify_bitset(get_entering_groups(aut,
                     s, target, c, c == eps_index), 'E');
-                leaving_str = stringify_set(get_leaving_group(aut,
+                leaving_str = stringify_bitset(get_leaving_group(aut,
                     s, target, c, c == eps_index), 'S');
                 printf("  %zu -> %zu[label=\"%s %s %s\"]\n", src, target->id,
                        transition_str, entering_str, leaving_str);
@@ -729,18 +871,18 @@ void _check_transiton_in_automaton(Automaton * automaton, State * src, State * d
 
 void _mark_tr_to_map(Map * map, Transition * tr, size_t group)
 {
-    Map ** set_ptr = map_get(map, tr);
-    Map * set;
+    BitSet ** set_ptr = map_get(map, tr);
+    BitSet * set;
     if(set_ptr == NULL)
     {
-        set = Set(size_t, hash_size_t, compare_size_t);
+        set = BitSet(0);
         map_set(map, tr, &set);
     }
     else
     {
         set = *set_ptr;
     }
-    set_add(set, &group);
+    bitset_add(set, group);
 }
 
 void _mark_to_map(Map * map, State * src, State * dst, Letter value, 
@@ -768,11 +910,11 @@ void automaton_mark_leaving(Automaton * automaton, State * src, State * dst,
     _mark_to_map(automaton->leaving_transitions, src, dst, value, epsilon, group);
 }
 
-Map * _get_set_from_tr(Map * map, State * src, State * dst, 
+BitSet * _get_set_from_tr(const Map * map, State * src, State * dst, 
     Letter value, int epsilon)
 {
     Transition tr = _generate_transition(src, dst, value, epsilon);
-    Map ** ptr = map_get(map, &tr);
+    BitSet ** ptr = map_get(map, &tr);
     
     if(ptr == NULL)
         return NULL;
@@ -780,14 +922,14 @@ Map * _get_set_from_tr(Map * map, State * src, State * dst,
     return *ptr;
 }
 
-Map * get_entering_groups(Automaton * automaton, State * src, State * dst,
-    Letter value, int epsilon)
+BitSet * get_entering_groups(const Automaton * automaton, State * src,
+    State * dst, Letter value, int epsilon)
 {
     return _get_set_from_tr(automaton->entering_transitions, src, dst, value, epsilon);
 }
 
-Map * get_leaving_group(Automaton * automaton, State * src, State * dst,
-    Letter value, int epsilon)
+BitSet * get_leaving_group(const Automaton * automaton, State * src,
+    State * dst, Letter value, int epsilon)
 {
     return _get_set_from_tr(automaton->leaving_transitions, src, dst, value, epsilon);
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "datatypes/array.h"
 #include "datatypes/matrix.h"
 #include "datatypes/map.h"
+#include "datatypes/bitset.h"
 #include "parsing/lexer.h"
 
 #define NUMBER_OF_SYMB 257
@@ -10,6 +13,34 @@
 #define Automaton(size, letter_count) automaton_create(size, letter_count)
 #define State(term) state_create(term)
 
+/**
+ * @struct AutomatonEdge
+ * @brief A transition in the frozen view of an automaton.
+ */
+typedef struct AutomatonEdge
+{
+    uint32_t target;
+    /**
+     * The letter of the transition, EPSILON_INDEX for epsilon transitions.
+     */
+    uint16_t label;
+} AutomatonEdge;
+
+/**
+ * @struct AutomatonCsr
+ * @brief Frozen view of the transitions of an automaton.
+ * The transitions are stored in compressed sparse rows: the transitions
+ * leaving the state i are edges[offsets[i]] to edges[offsets[i + 1] - 1],
+ * sorted by label. It is built by automaton_freeze for the algorithms that
+ * only read an automaton, and dropped as soon as the automaton changes.
+ */
+typedef struct AutomatonCsr
+{
+    size_t size;
+    size_t *offsets;
+    AutomatonEdge *edges;
+} AutomatonCsr;
+
 /**
  * @struct Automaton
  * @brief Represents an automaton as a graph.
@@ -67,10 +98,20 @@ typedef struct
 
     size_t nb_groups;
 
+    /**
+     * The groups entered and left by transitions, maps of Transition to
+     * BitSet *.
+     */
     Map * entering_transitions;
 
     Map * leaving_transitions;
 
+    /**
+     * Frozen view of the transition table, NULL until automaton_freeze
+     * is called and whenever the automaton is modified.
+     */
+    AutomatonCsr *csr;
+
 } Automaton;
 
 /**
@@ -138,6 +179,30 @@ Automaton * automaton_create();
 
 LinkedList * get_matrix_elt(const Automaton * automaton, size_t state_id, Letter value, int is_epsilon);
 
+/**
+ * Build the frozen view of the transitions of an automaton, or return the
+ * existing one. Modifying the automaton drops the view.
+ * @return The view, owned by the automaton.
+ */
+const AutomatonCsr *automaton_freeze(Automaton *automaton);
+
+/**
+ * Drop the frozen view of an automaton. It is done by all the functions of
+ * this module that modify an automaton, code modifying the transition
+ * table directly must call it first.
+ */
+void automaton_thaw(Automaton *automaton);
+
+/**
+ * Read-only counterpart of get_matrix_elt working on the frozen view.
+ * @param count: Set to the number of transitions found.
+ * @return The transitions leaving the state with the letter, in the order
+ * they were added.
+ */
+const AutomatonEdge *automaton_get_targets(Automaton *automaton,
+                                           size_t state_id, Letter value,
+                                           int is_epsilon, size_t *count);
+
 /**
  * @author Vlad Argatu
  * @date 05/03/2021
@@ -157,6 +222,17 @@ void automaton_add_state(Automaton * automaton, State * state, int is_entry);
 
 void automaton_remove_state(Automaton * automaton, State * state);
 
+/**
+ * Remove several states at once.
+ * The remaining states keep their order and are renumbered from 0, the
+ * transitions and group tags touching a removed state are dropped and the
+ * tags of the others follow the new ids. The removed states are freed.
+ * It runs in linear time in the number of states, transitions and tags.
+ * @param automaton: the automaton on which the operation is performed.
+ * @param mask: one flag per state id, non zero for the states to remove.
+*/
+void automaton_remove_states(Automaton * automaton, const uint8_t * mask);
+
 /**
  * @author Vlad Argatu
  * @date 05/03/2021
@@ -187,6 +263,12 @@ void automaton_add_transition(Automaton * automaton,
 int automaton_remove_transition(Automaton * automaton, State * src, State * dst,
     Letter value, int epsilon);
 
+/**
+ * Drop the group tags of a transition without touching the transition table.
+ */
+void _automaton_remove_transition_from_maps(Automaton * automaton,
+    State * src, State * dst, Letter value, int epsilon);
+
 /**
  * @author Rostan Tabet
  * @date 09/04/2021
@@ -196,6 +278,12 @@ int automaton_remove_transition(Automaton * automaton, State * src, State * dst,
  */
 Automaton *automaton_copy(Automaton *source);
 
+/**
+ * @return The number of transitions of the automaton, epsilon transitions
+ * included.
+ */
+size_t automaton_transition_count(const Automaton *automaton);
+
 /**
  * @author Vlad Argatu
  * @date 05/03/2021
@@ -331,8 +419,8 @@ int automaton_is_transition(Automaton * automaton, State * src, State * dst,
  * returns the resulting set
 */
 
-Map * get_entering_groups(Automaton * automaton, State * src, State * dst,
-    Letter value, int epsilon);
+BitSet * get_entering_groups(const Automaton * automaton, State * src,
+    State * dst, Letter value, int epsilon);
 
 
 /**
@@ -345,8 +433,8 @@ Map * get_entering_groups(Automaton * automaton, State * src, State * dst,
  * @param epsilon A booleen indicating wether the transition is epsilon or not.
  * returns the resulting set
 */
-Map * get_leaving_group(Automaton * automaton, State * src, State * dst,
-    Letter value, int epsilon);
+BitSet * get_leaving_group(const Automaton * automaton, State * src,
+    State * dst, Letter value, int epsilon);
 
 void automaton_clear_state_terminal(Automaton * automaton, State * state);
 
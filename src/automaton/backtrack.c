@@ -0,0 +1,369 @@
+#include "automaton/backtrack.h"
+
+#include <string.h>
+
+#include "datatypes/array.h"
+#include "parsing/parsing.h"
+#include "utils/memory_utils.h"
+
+/**
+ * @struct BacktrackGroup
+ * The brackets of a group in the tokens of the pattern.
+ */
+typedef struct BacktrackGroup
+{
+    size_t open;
+    size_t close;
+} BacktrackGroup;
+
+/**
+ * The program being compiled, see backtracker_build.
+ */
+typedef struct BacktrackCode
+{
+    Array *insts;
+    Array *classes;
+    /**
+     * The token of each node of the tree, in the order of the tokens.
+     */
+    Array *order;
+    /**
+     * The brackets of each group, by id from 1. Empty when the tree and
+     * the tokens do not match, so that no group is captured.
+     */
+    Array *groups;
+} BacktrackCode;
+
+/**
+ * Append an instruction to the program being compiled.
+ * @return The index of the instruction.
+ */
+static uint32_t emit(BacktrackCode *code, BacktrackOp op, uint32_t arg)
+{
+    uint32_t index = code->insts->size;
+    BacktrackInst inst = { .op = op, .next = index + 1, .arg = arg };
+    array_append(code->insts, &inst);
+    return index;
+}
+
+static BacktrackInst *inst_at(BacktrackCode *code, uint32_t index)
+{
+    return (BacktrackInst *)code->insts->data + index;
+}
+
+/**
+ * Append the class of a letter or a character class to the program.
+ * @return The index of the class.
+ */
+static uint32_t add_class(BacktrackCode *code, const Symbol *symbol)
+{
+    uint64_t class[4] = { 0 };
+    if (symbol->type == LETTER)
+        class[symbol->value.letter / 64] |= (uint64_t)1
+            << symbol->value.letter % 64;
+    else
+    {
+        arr_foreach(Letter, letter, symbol->value.letters)
+            class[letter / 64] |= (uint64_t)1 << letter % 64;
+    }
+    array_append(code->classes, class);
+    return code->classes->size - 1;
+}
+
+static int is_bracket(const Token *token)
+{
+    return token->type == PUNCTUATION
+        && (token->value.letter == '(' || token->value.letter == ')'
+            || token->value.letter == '{' || token->value.letter == '}');
+}
+
+/**
+ * Find the brackets of the groups of a pattern, the groups are numbered in
+ * the order they are opened, as by the parser.
+ * @return Zero if the brackets are not balanced.
+ */
+static int find_groups(BacktrackCode *code, Array *tokens)
+{
+    Array *stack = Array(BacktrackGroup);
+    int balanced = 1;
+    for (size_t i = 0; i < tokens->size && balanced; i++)
+    {
+        const Token *token = array_get(tokens, i);
+        if (!is_bracket(token))
+            continue;
+
+        // The brackets of a group hold its id in `close` until it closes
+        Letter letter = token->value.letter;
+        if (letter == '(' || letter == '{')
+        {
+            BacktrackGroup open = { .open = i, .close = 0 };
+            if (letter == '{')
+            {
+                BacktrackGroup none = { .open = 0, .close = 0 };
+                array_append(code->groups, &none);
+                open.close = code->groups->size;
+            }
+            array_append(stack, &open);
+            continue;
+        }
+
+        balanced = stack->size != 0;
+        if (!balanced)
+            break;
+        BacktrackGroup *top = (BacktrackGroup *)stack->data + --stack->size;
+        balanced = (letter == '}') == (top->close != 0);
+        if (balanced && top->close != 0)
+        {
+            BacktrackGroup *group =
+                (BacktrackGroup *)code->groups->data + top->close - 1;
+            group->open = top->open;
+            group->close = i;
+        }
+    }
+    balanced &= stack->size == 0;
+    array_free(stack);
+    return balanced;
+}
+
+/**
+ * Find the token of each node of a tree, which lists the nodes in the order
+ * of the tokens when it is walked in order.
+ * @param position The next token, skipping the brackets.
+ * @return Zero if the tree and the tokens do not match.
+ */
+static int order_nodes(BacktrackCode *code, const BinTree *tree,
+                       Array *tokens, size_t *position)
+{
+    if (tree == NULL)
+        return 1;
+    if (!order_nodes(code, tree->left, tokens, position))
+        return 0;
+
+    while (*position < tokens->size
+           && is_bracket(array_get(tokens, *position)))
+        (*position)++;
+    if (*position == tokens->size)
+        return 0;
+    const Token *token = array_get(tokens, *position);
+    const Symbol *symbol = tree->data;
+    if ((token->type == PUNCTUATION) != (symbol->type == OPERATOR))
+        return 0;
+    array_append(code->order, position);
+    (*position)++;
+
+    return order_nodes(code, tree->right, tokens, position);
+}
+
+static size_t tree_size(const BinTree *tree)
+{
+    if (tree == NULL)
+        return 0;
+    return 1 + tree_size(tree->left) + tree_size(tree->right);
+}
+
+/**
+ * @return Non zero if a group is around the tokens from `first` to `last`.
+ */
+static int group_around(const BacktrackGroup *group, size_t first,
+                        size_t last)
+{
+    return group->open < first && last < group->close;
+}
+
+/**
+ * Record the positions where the groups starting or ending with a node
+ * are entered or left: the groups around the tokens of the node but not
+ * around those of its parent.
+ * @param leaving Zero to enter the groups, from the outermost, non zero to
+ * leave them, from the innermost.
+ */
+static void emit_saves(BacktrackCode *code, size_t first, size_t last,
+                       size_t parent_first, size_t parent_last, int leaving)
+{
+    const BacktrackGroup *groups = code->groups->data;
+    size_t count = code->groups->size;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t id = leaving ? count - i : i + 1;
+        const BacktrackGroup *group = groups + id - 1;
+        if (group_around(group, first, last)
+            && !group_around(group, parent_first, parent_last))
+            emit(code, BACKTRACK_SAVE, 2 * id + leaving);
+    }
+}
+
+/**
+ * Compile a node of the tree, the instruction after it comes next.
+ * @param base The number of nodes before the node and its children, in the
+ * order of the tokens.
+ * @param parent_first The first token of the parent of the node.
+ * @param parent_last The last token of the parent of the node.
+ */
+static void compile_node(BacktrackCode *code, const BinTree *tree,
+                         size_t base, size_t parent_first, size_t parent_last)
+{
+    // The tokens of the node and its children follow each other
+    size_t left_size = tree_size(tree->left);
+    size_t size = left_size + 1 + tree_size(tree->right);
+    size_t first = 0;
+    size_t last = 0;
+    if (code->groups->size != 0)
+    {
+        first = *(size_t *)array_get(code->order, base);
+        last = *(size_t *)array_get(code->order, base + size - 1);
+        emit_saves(code, first, last, parent_first, parent_last, 0);
+    }
+
+    const Symbol *symbol = tree->data;
+    size_t right = base + left_size + 1;
+    if (symbol->type != OPERATOR)
+        emit(code, BACKTRACK_CLASS, add_class(code, symbol));
+    else
+    {
+        uint32_t split;
+        uint32_t jump;
+        switch (symbol->value.operator)
+        {
+        case CONCATENATION:
+            compile_node(code, tree->left, base, first, last);
+            compile_node(code, tree->right, right, first, last);
+            break;
+        case UNION:
+            split = emit(code, BACKTRACK_SPLIT, 0);
+            compile_node(code, tree->left, base, first, last);
+            jump = emit(code, BACKTRACK_JUMP, 0);
+            inst_at(code, split)->arg = code->insts->size;
+            compile_node(code, tree->right, right, first, last);
+            inst_at(code, jump)->next = code->insts->size;
+            break;
+        case KLEENE_STAR:
+            split = emit(code, BACKTRACK_SPLIT, 0);
+            compile_node(code, tree->left, base, first, last);
+            inst_at(code, emit(code, BACKTRACK_JUMP, 0))->next = split;
+            inst_at(code, split)->arg = code->insts->size;
+            break;
+        case EXISTS:
+            jump = code->insts->size;
+            compile_node(code, tree->left, base, first, last);
+            split = emit(code, BACKTRACK_SPLIT, 0);
+            inst_at(code, split)->next = jump;
+            inst_at(code, split)->arg = split + 1;
+            break;
+        case MAYBE:
+            split = emit(code, BACKTRACK_SPLIT, 0);
+            compile_node(code, tree->left, base, first, last);
+            inst_at(code, split)->arg = code->insts->size;
+            break;
+        }
+    }
+
+    if (code->groups->size != 0)
+        emit_saves(code, first, last, parent_first, parent_last, 1);
+}
+
+/**
+ * Add the letters a match can start with from an instruction to the
+ * first letters of a backtracker.
+ * @param seen The instructions already followed.
+ */
+static void add_first_letters(Backtracker *backtracker, uint8_t *seen,
+                              uint32_t index)
+{
+    while (!seen[index])
+    {
+        seen[index] = 1;
+        const BacktrackInst *inst = backtracker->insts + index;
+        switch (inst->op)
+        {
+        case BACKTRACK_CLASS:
+            for (size_t i = 0; i < 4; i++)
+                backtracker->first_letters[i] |=
+                    backtracker->classes[inst->arg][i];
+            return;
+        case BACKTRACK_SPLIT:
+            add_first_letters(backtracker, seen, inst->arg);
+            index = inst->next;
+            break;
+        case BACKTRACK_MATCH:
+            return;
+        default:
+            index = inst->next;
+        }
+    }
+}
+
+Backtracker *backtracker_build(const BinTree *tree, Array *tokens)
+{
+    BacktrackCode code = {
+        .insts = Array(BacktrackInst),
+        .classes = Array(uint64_t[4]),
+        .order = Array(size_t),
+        .groups = Array(BacktrackGroup),
+    };
+    // The parser numbers the groups in the order of the tokens, but does
+    // not always put them around the right nodes, e.g. it does not tell
+    // (a+) from (a)+. The groups are read from the brackets of the tokens.
+    size_t position = 0;
+    int matched = find_groups(&code, tokens)
+        && order_nodes(&code, tree, tokens, &position);
+    size_t nb_groups = code.groups->size == 0 ? 0 : code.groups->size + 1;
+    if (!matched)
+        array_clear(code.groups);
+    compile_node(&code, tree, 0, 0, tokens->size);
+    emit(&code, BACKTRACK_MATCH, 0);
+
+    Backtracker *backtracker = SAFEMALLOC(sizeof(Backtracker));
+    backtracker->size = code.insts->size;
+    backtracker->nb_groups = nb_groups;
+    backtracker->insts = SAFEMALLOC(code.insts->size * sizeof(BacktrackInst));
+    memcpy(backtracker->insts, code.insts->data,
+           code.insts->size * sizeof(BacktrackInst));
+    backtracker->class_count = code.classes->size;
+    backtracker->classes =
+        SAFEMALLOC((code.classes->size + 1) * sizeof(uint64_t[4]));
+    memcpy(backtracker->classes, code.classes->data,
+           code.classes->size * sizeof(uint64_t[4]));
+    array_free(code.insts);
+    array_free(code.classes);
+    array_free(code.order);
+    array_free(code.groups);
+
+    memset(backtracker->first_letters, 0, sizeof(backtracker->first_letters));
+    uint8_t *seen = SAFECALLOC(backtracker->size, sizeof(uint8_t));
+    add_first_letters(backtracker, seen, 0);
+    SAFEFREE(seen);
+
+    return backtracker;
+}
+
+void backtracker_free(Backtracker *backtracker)
+{
+    if (backtracker == NULL)
+        return;
+    free(backtracker->insts);
+    free(backtracker->classes);
+    free(backtracker);
+}
+
+size_t backtracker_memory_usage(const Backtracker *backtracker)
+{
+    if (backtracker == NULL)
+        return 0;
+
+    // The classes have room for one more, see backtracker_build
+    return sizeof(Backtracker) + backtracker->size * sizeof(BacktrackInst)
+        + (backtracker->class_count + 1) * sizeof(uint64_t[4]);
+}
+
+size_t backtracker_max_length(const Backtracker *backtracker)
+{
+    if (backtracker == NULL || backtracker->size == 0)
+        return 0;
+
+    // A string of length n has n + 1 positions
+    size_t positions = BACKTRACK_MAX_BITS / backtracker->size;
+    if (positions == 0)
+        return 0;
+    return positions - 1 > BACKTRACK_MAX_LENGTH ? BACKTRACK_MAX_LENGTH
+                                                : positions - 1;
+}
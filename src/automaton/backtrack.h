@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "datatypes/array.h"
+#include "datatypes/bin_tree.h"
+
+/**
+ * Number of bits of the (instruction, position) set of a backtracking
+ * search. A string is only backtracked over when its length times the
+ * instructions of the backtracker fits in it, see backtracker_max_length.
+ */
+#define BACKTRACK_MAX_BITS (256 * 1024)
+/**
+ * Longest string a backtracker is used for, longer ones are left to the
+ * DFA whatever the size of the backtracker.
+ */
+#define BACKTRACK_MAX_LENGTH 1024
+
+/**
+ * The instructions of a backtracker.
+ */
+typedef enum BacktrackOp
+{
+    /**
+     * Read a letter of the class `arg`, then go on with `next`.
+     */
+    BACKTRACK_CLASS,
+    /**
+     * Go on with `next`, then with `arg` if `next` led to no match.
+     */
+    BACKTRACK_SPLIT,
+    BACKTRACK_JUMP,
+    /**
+     * Record the position in the slot `arg`, then go on with `next`. Slot
+     * 2 * g is where the group g starts and slot 2 * g + 1 where it ends.
+     */
+    BACKTRACK_SAVE,
+    BACKTRACK_MATCH,
+} BacktrackOp;
+
+/**
+ * @struct BacktrackInst
+ * @brief An instruction of a backtracker.
+ */
+typedef struct BacktrackInst
+{
+    BacktrackOp op;
+    uint32_t next;
+    uint32_t arg;
+} BacktrackInst;
+
+/**
+ * @struct Backtracker
+ * @brief Program capturing the groups of the matches, built from the tree
+ * of the pattern, see backtracker_build. The automata lose track of the
+ * path a match takes through the groups, the program keeps it: the
+ * alternatives of a split are tried in the order of the pattern, so that
+ * a union prefers its left side and a repetition reads as much as it can.
+ * A group matches the last text it was entered for, and stays unmatched
+ * when the match does not go through it.
+ */
+typedef struct Backtracker
+{
+    /**
+     * The number of instructions, the program starts with the first one.
+     */
+    size_t size;
+    size_t nb_groups;
+    BacktrackInst *insts;
+    /**
+     * Bitmaps of the letters of the classes read by the program.
+     */
+    uint64_t (*classes)[4];
+    size_t class_count;
+    /**
+     * Bitmap of the letters a match can start with.
+     */
+    uint64_t first_letters[4];
+} Backtracker;
+
+/**
+ * Compile a pattern to a backtracker.
+ * @param tree The tree of the pattern, before thompson changes it.
+ * @param tokens The tokens the tree was parsed from.
+ */
+Backtracker *backtracker_build(const BinTree *tree, Array *tokens);
+
+void backtracker_free(Backtracker *backtracker);
+
+/**
+ * @return The bytes held by a backtracker, 0 for NULL.
+ */
+size_t backtracker_memory_usage(const Backtracker *backtracker);
+
+/**
+ * The length of the longest string searched by backtracking, so that its
+ * (instruction, position) set fits in BACKTRACK_MAX_BITS.
+ */
+size_t backtracker_max_length(const Backtracker *backtracker);
+
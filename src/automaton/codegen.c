@@ -0,0 +1,320 @@
+#include "automaton/codegen.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "utils/errors.h"
+#include "utils/memory_utils.h"
+
+static int is_identifier(const char *name)
+{
+    if (name == NULL || !(isalpha((unsigned char)*name) || *name == '_'))
+        return 0;
+    for (; *name != 0; name++)
+        if (!isalnum((unsigned char)*name) && *name != '_')
+            return 0;
+    return 1;
+}
+
+/**
+ * List the states reachable from the start of the table, the start first.
+ * @param order Filled with the reachable states.
+ * @param referenced Set to 1 for every state that is the target of a
+ * transition, i.e. the states that need a label.
+ * @return The number of reachable states.
+ */
+static size_t reachable_states(const DfaTable *table, int32_t *order,
+                               uint8_t *referenced)
+{
+    uint8_t *seen = SAFECALLOC(table->size, sizeof(uint8_t));
+    size_t count = 0;
+    order[count++] = table->start;
+    seen[table->start] = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t letter = 1; letter < DFA_TABLE_ALPHABET; letter++)
+        {
+            int32_t target =
+                table->transitions[order[i] * DFA_TABLE_ALPHABET + letter];
+            if (target == DFA_NO_STATE)
+                continue;
+            referenced[target] = 1;
+            if (!seen[target])
+            {
+                seen[target] = 1;
+                order[count++] = target;
+            }
+        }
+    }
+    free(seen);
+
+    return count;
+}
+
+static void write_letter(FILE *out, size_t letter)
+{
+    if (isprint((int)letter) && letter != '\'' && letter != '\\')
+        fprintf(out, "'%c'", (char)letter);
+    else
+        fprintf(out, "0x%02zx", letter);
+}
+
+/**
+ * Write the comment at the top of the generated file, the pattern is
+ * altered so that it cannot end the comment.
+ */
+static void write_header(FILE *out, const DfaTable *table)
+{
+    fprintf(out, "/*\n * Generated by rationl-gen, do not edit.\n");
+    if (table->pattern != NULL && *table->pattern != 0)
+    {
+        fprintf(out, " * Pattern: ");
+        for (const char *c = table->pattern; *c != 0; c++)
+        {
+            if (*c == '*' && c[1] == '/')
+                fputs("* ", out);
+            else if (isprint((unsigned char)*c))
+                fputc(*c, out);
+            else
+                fputc('?', out);
+        }
+        fputc('\n', out);
+    }
+    fprintf(out, " */\n\n#include <stddef.h>\n#include <string.h>\n\n");
+}
+
+static void write_tag_actions(FILE *out, const DfaTable *table,
+                              const DfaTag *tag, int leaving,
+                              const char *indent)
+{
+    if (tag == NULL)
+        return;
+
+    size_t offset = leaving ? tag->leave_offset : tag->enter_offset;
+    size_t count = leaving ? tag->leave_count : tag->enter_count;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t group = table->groups[offset + i];
+        if (!leaving)
+        {
+            fprintf(out, "%sopen[%u] = p - begin;\n", indent, group);
+            continue;
+        }
+        fprintf(out, "%sif (open[%u] >= 0)\n", indent, group);
+        fprintf(out, "%s{\n", indent);
+        fprintf(out, "%s    live[%u] = open[%u];\n", indent, 2 * group, group);
+        fprintf(out, "%s    live[%u] = p - begin;\n", indent, 2 * group + 1);
+        fprintf(out, "%s    open[%u] = -1;\n", indent, group);
+        fprintf(out, "%s}\n", indent);
+    }
+}
+
+/**
+ * Write the code of a state: what is done when reaching it and a switch
+ * jumping to the next state.
+ * @param tagged If non zero, group bounds are tracked in the `open` and
+ * `live` arrays and copied to `groups` when a terminal state is reached.
+ */
+static void write_state(FILE *out, const DfaTable *table, int32_t state,
+                        const uint8_t *referenced, int tagged)
+{
+    const int32_t *row = table->transitions + state * DFA_TABLE_ALPHABET;
+    const DfaTag *state_tag =
+        tagged ? dfa_table_get_tag(table, state, DFA_TAG_STATE) : NULL;
+
+    if (referenced[state])
+        fprintf(out, "s%d:\n", state);
+    if (table->terminal[state])
+    {
+        write_tag_actions(out, table, state_tag, 1, "    ");
+        fprintf(out, "    end = p - begin;\n");
+        if (tagged)
+            fprintf(out, "    memcpy(groups, live, sizeof(live));\n");
+    }
+    size_t letter_count = 0;
+    for (size_t letter = 1; letter < DFA_TABLE_ALPHABET; letter++)
+        letter_count += row[letter] != DFA_NO_STATE;
+    if (letter_count == 0)
+    {
+        fprintf(out, "    return end;\n");
+        return;
+    }
+    fprintf(out, "    switch (%s)\n    {\n", tagged ? "*p" : "*p++");
+
+    uint8_t written[DFA_TABLE_ALPHABET] = { 0 };
+    for (size_t letter = 1; letter < DFA_TABLE_ALPHABET; letter++)
+    {
+        if (row[letter] == DFA_NO_STATE || written[letter])
+            continue;
+
+        // Letters sharing the target and the tags share the case
+        const DfaTag *tag =
+            tagged ? dfa_table_get_tag(table, state, letter) : NULL;
+        for (size_t other = letter; other < DFA_TABLE_ALPHABET; other++)
+        {
+            if (row[other] != row[letter] || written[other]
+                || (tagged && dfa_table_get_tag(table, state, other) != tag))
+                continue;
+            written[other] = 1;
+            fprintf(out, "    case ");
+            write_letter(out, other);
+            fprintf(out, ":\n");
+        }
+
+        if (tagged)
+        {
+            write_tag_actions(out, table, tag, 1, "        ");
+            write_tag_actions(out, table, state_tag, 1, "        ");
+            write_tag_actions(out, table, state_tag, 0, "        ");
+            fprintf(out, "        p++;\n");
+            write_tag_actions(out, table, tag, 0, "        ");
+        }
+        fprintf(out, "        goto s%d;\n", row[letter]);
+    }
+    fprintf(out, "    default:\n        return end;\n    }\n");
+}
+
+static void write_states(FILE *out, const DfaTable *table,
+                         const int32_t *order, size_t count,
+                         const uint8_t *referenced, int tagged)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i != 0)
+            fputc('\n', out);
+        write_state(out, table, order[i], referenced, tagged);
+    }
+}
+
+static void write_functions(FILE *out, const DfaTable *table,
+                            const char *prefix)
+{
+    int32_t *order = NULL;
+    uint8_t *referenced = NULL;
+    size_t count = 0;
+    if (table->start != DFA_NO_STATE)
+    {
+        order = SAFEMALLOC(table->size * sizeof(int32_t));
+        referenced = SAFECALLOC(table->size, sizeof(uint8_t));
+        count = reachable_states(table, order, referenced);
+    }
+    int tagged = table->tag_count != 0;
+    size_t nb_groups = table->nb_groups;
+
+    fprintf(out, "long %s_match(const char *string)\n{\n", prefix);
+    if (count == 0)
+        fprintf(out, "    (void)string;\n    return -1;\n");
+    else
+    {
+        fprintf(out, "    const unsigned char *begin = "
+                     "(const unsigned char *)string;\n");
+        fprintf(out, "    const unsigned char *p = begin;\n");
+        fprintf(out, "    long end = -1;\n\n");
+        write_states(out, table, order, count, referenced, 0);
+    }
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "static long %s_scan(const unsigned char *begin, "
+                 "const unsigned char *p,\n", prefix);
+    fprintf(out, "                     long *groups)\n{\n");
+    if (nb_groups == 0)
+        fprintf(out, "    (void)groups;\n");
+    else
+        fprintf(out, "    for (size_t i = 0; i < %zu; i++)\n"
+                     "        groups[i] = -1;\n", 2 * nb_groups);
+    if (count == 0)
+        fprintf(out, "    (void)begin;\n    (void)p;\n    return -1;\n");
+    else
+    {
+        if (tagged)
+        {
+            fprintf(out, "    long open[%zu];\n", nb_groups);
+            fprintf(out, "    long live[%zu];\n", 2 * nb_groups);
+            fprintf(out, "    for (size_t i = 0; i < %zu; i++)\n"
+                         "        open[i] = -1;\n", nb_groups);
+            fprintf(out, "    memcpy(live, groups, sizeof(live));\n");
+        }
+        fprintf(out, "    long end = -1;\n\n");
+        write_states(out, table, order, count, referenced, tagged);
+    }
+    fprintf(out, "}\n\n");
+
+    fprintf(out,
+            "int %s_search(const char *string, size_t from,\n"
+            "    struct %s_result *result)\n"
+            "{\n"
+            "    const unsigned char *begin = (const unsigned char *)string;\n"
+            "    for (size_t start = from; begin[start] != 0; start++)\n"
+            "    {\n"
+            "        long end = %s_scan(begin, begin + start, "
+            "result->groups);\n"
+            "        if (end > (long)start)\n"
+            "        {\n"
+            "            result->start = start;\n"
+            "            result->length = end - start;\n"
+            "            return 1;\n"
+            "        }\n"
+            "    }\n"
+            "\n"
+            "    return 0;\n"
+            "}\n",
+            prefix, prefix, prefix);
+
+    free(order);
+    free(referenced);
+}
+
+int codegen_write_table(const DfaTable *table, const char *prefix, FILE *out)
+{
+    if (!is_identifier(prefix))
+    {
+        rationl_errno = EBADFMT;
+        return -1;
+    }
+
+    write_header(out, table);
+
+    fprintf(out, "#define ");
+    for (const char *c = prefix; *c != 0; c++)
+        fputc(toupper((unsigned char)*c), out);
+    fprintf(out, "_NB_GROUPS %zu\n\n", table->nb_groups);
+
+    fprintf(out,
+            "struct %s_result\n"
+            "{\n"
+            "    size_t start;\n"
+            "    size_t length;\n"
+            "    /*\n"
+            "     * The group n matched between groups[2 * n] and\n"
+            "     * groups[2 * n + 1], both are -1 if it did not match.\n"
+            "     */\n"
+            "    long groups[%zu];\n"
+            "};\n\n",
+            prefix, 2 * table->nb_groups + 1);
+
+    write_functions(out, table, prefix);
+
+    if (ferror(out))
+    {
+        rationl_errno = ENOFILE;
+        return -1;
+    }
+
+    return 0;
+}
+
+int codegen_write(const Automaton *automaton, const char *pattern,
+                  const char *prefix, FILE *out)
+{
+    DfaTable *table = dfa_table_build(automaton, pattern);
+    if (table == NULL)
+    {
+        rationl_errno = EBADFMT;
+        return -1;
+    }
+
+    int res = codegen_write_table(table, prefix, out);
+    dfa_table_free(table);
+
+    return res;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "automaton/automaton.h"
+#include "automaton/dfa_table.h"
+
+/**
+ * Emit a standalone C source file matching the same language as a table.
+ * The file only depends on the C library and defines, where `prefix` is
+ * replaced by the given prefix:
+ *
+ * - `PREFIX_NB_GROUPS`, the number of groups of the pattern.
+ * - `struct prefix_result`, the bounds of a match and of its groups.
+ * - `long prefix_match(const char *string)`, the length of the longest
+ *   match at the beginning of the string or -1.
+ * - `int prefix_search(const char *string, size_t from,
+ *   struct prefix_result *result)`, which finds the leftmost longest non
+ *   empty match starting at or after `from` and returns 1 if there is one.
+ *
+ * Each state is a label and its transitions a switch on the current
+ * character, so that the C compiler can optimize the whole automaton.
+ * @param prefix A valid C identifier used to name the generated symbols.
+ * @return 0 on success, -1 on error with rationl_errno set accordingly.
+ */
+int codegen_write_table(const DfaTable *table, const char *prefix, FILE *out);
+
+/**
+ * Same as codegen_write_table for a deterministic automaton.
+ * @param pattern The pattern written in the header comment, can be NULL.
+ * @return 0 on success, -1 on error with rationl_errno set accordingly.
+ */
+int codegen_write(const Automaton *automaton, const char *pattern,
+                  const char *prefix, FILE *out);
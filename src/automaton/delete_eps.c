@@ -53,15 +53,16 @@ void add_to_pred_lists(Array * pred_lists, State * src, State * trg, Letter valu
 }
 
 void transfer_all_transitions(Automaton * automaton, State * src, 
-    State * new_src, Map * eps_leaving, Array * pred_lists)
+    State * new_src, BitSet * eps_leaving, Array * pred_lists)
 {
     LinkedList * src_list;
     State * trg;
     LinkedList * new_src_list;
     Letter c;
-    Map * tr_entering;
-    Map * tr_leaving;
+    BitSet * tr_entering;
+    BitSet * tr_leaving;
 
+    automaton_thaw(automaton);
     for(size_t i = 0; i < NUMBER_OF_SYMB; i++)
     {
         c = (i == EPSILON_INDEX) ? 'A' : i;
@@ -93,8 +94,8 @@ void transfer_all_transitions(Automaton * automaton, State * src,
                 //deal with entering
                 if(eps_leaving != NULL)
                 {
-                    map_foreach_key(
-                        size_t, grp, eps_leaving,
+                    bitset_foreach(
+                        grp, eps_leaving,
                         {
                             automaton_mark_leaving(automaton, new_src, trg,
                                 c, i == EPSILON_INDEX, grp);
@@ -104,8 +105,8 @@ void transfer_all_transitions(Automaton * automaton, State * src,
 
                 if(tr_leaving != NULL)
                 {
-                    map_foreach_key(
-                        size_t, grp, tr_leaving,
+                    bitset_foreach(
+                        grp, tr_leaving,
                         {
                             automaton_mark_leaving(automaton, new_src, trg,
                                 c, i == EPSILON_INDEX, grp);
@@ -116,8 +117,8 @@ void transfer_all_transitions(Automaton * automaton, State * src,
                 //deal with leaving
                 if(tr_entering != NULL)
                 {
-                    map_foreach_key(
-                        size_t, grp, tr_entering,
+                    bitset_foreach(
+                        grp, tr_entering,
                         {
                             automaton_mark_entering(automaton, new_src, trg, 
                                 c, i == EPSILON_INDEX, grp);
@@ -134,8 +135,8 @@ void automaton_delete_epsilon_tr(Automaton * automaton)
 {
     LinkedList * eps_list;
     State * dst;
-    Map * entering_set;
-    Map * leaving_set;
+    BitSet * entering_set;
+    BitSet * leaving_set;
     Array * pred_lists = build_pred_lists(automaton);
     LinkedList * pred;
     State * aux;
@@ -156,8 +157,8 @@ void automaton_delete_epsilon_tr(Automaton * automaton)
                 pred = *(LinkedList **)array_get(pred_lists, s->id);
                 if(entering_set != NULL)
                 {
-                    map_foreach_key(
-                        size_t, grp, entering_set,
+                    bitset_foreach(
+                        grp, entering_set,
                         {
                             list_foreach(Transition, tr, pred)
                             {
@@ -178,8 +179,8 @@ void automaton_delete_epsilon_tr(Automaton * automaton)
                 {
                     if(leaving_set != NULL)
                     {
-                        map_foreach_key(
-                            size_t, grp, leaving_set,
+                        bitset_foreach(
+                            grp, leaving_set,
                             {
                                 automaton_mark_leaving(automaton, s, NULL, 0, 1, grp);
                             }
@@ -192,8 +193,8 @@ void automaton_delete_epsilon_tr(Automaton * automaton)
                 {
                     if(entering_set != NULL)
                     {
-                        map_foreach_key(
-                            size_t, grp, entering_set,
+                        bitset_foreach(
+                            grp, entering_set,
                             {
                                 automaton_mark_entering(automaton, NULL, s, 0, 1, grp);
                             }
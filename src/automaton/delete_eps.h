@@ -12,7 +12,7 @@
  */
 
 void transfer_all_transitions(Automaton * automaton, State * src, 
-    State * new_src, Map * eps_entering, Array * pred_lists);
+    State * new_src, BitSet * eps_entering, Array * pred_lists);
 
 /**
  * @author Vlad Argatu
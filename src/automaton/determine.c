@@ -3,81 +3,110 @@
 #include <printf.h>
 
 #include "datatypes/map.h"
+#include "utils/memory_utils.h"
 
 static void free_powersets(Map *);
 
+int budget_exceeded(const DeterminizeBudget *budget,
+                    const Automaton *automaton)
+{
+    if (budget == NULL)
+        return 0;
+    if (budget->max_states != 0 && automaton->size > budget->max_states)
+        return 1;
+    return budget->max_bytes != 0
+        && allocation_counters().bytes - budget->base_bytes
+        > budget->max_bytes;
+}
+
 Automaton *determine(const Automaton *source)
 {
+    return determine_bounded(source, NULL);
+}
+
+Automaton *determine_bounded(const Automaton *source,
+                             const DeterminizeBudget *budget)
+{
+    const AutomatonCsr *csr = automaton_freeze((Automaton *)source);
     Automaton *automaton = Automaton(1, source->lookup_used);
     automaton->is_determined = 1;
     automaton->nb_groups = source->nb_groups;
     // Associate each powerset to a state id
-    Map *powersets = Map(Set *, size_t, &hash_set, &compare_sets);
+    Map *powersets = Map(BitSet *, size_t, &hash_bitset, &compare_bitsets);
     // For each iterations, collect the set of ids associated to each letter
-    Map *state_sets = Map(Letter, Set *, &hash_char, &compare_uchars);
-    LinkedList *set_queue = LinkedList(Set *);
+    Map *state_sets = Map(Letter, BitSet *, &hash_char, &compare_uchars);
+    LinkedList *set_queue = LinkedList(BitSet *);
 
     // Initialize the starting state
     int terminal = 0;
-    Set *start_set = Set(size_t, &hash_size_t, &compare_size_t);
-    Set *entering_groups = Set(size_t, &hash_size_t, &compare_size_t);
+    BitSet *start_set = BitSet(source->size);
+    BitSet *entering_groups = BitSet(source->nb_groups);
     arr_foreach(State *, starting_state, source->starting_states)
     {
         if (starting_state->terminal)
             terminal = 1;
-        set_add(start_set, &starting_state->id);
+        bitset_add(start_set, starting_state->id);
 
-        Set *groups = get_entering_groups((Automaton *)source, NULL,
-                                          starting_state, 0, 1);
+        BitSet *groups = get_entering_groups((Automaton *)source, NULL,
+                                             starting_state, 0, 1);
         if (groups != NULL)
-        {
-            map_foreach_key(size_t, group, groups,
-                            set_add(entering_groups, &group);)
-        }
+            bitset_union(entering_groups, groups);
     }
     // Push it in the queue
     State *first_state = State(terminal);
     automaton_add_state(automaton, first_state, 1);
     {
-        map_foreach_key(size_t, group, entering_groups, {
+        bitset_foreach(group, entering_groups, {
             automaton_mark_entering(automaton, NULL, first_state, 0, 0, group);
         });
     }
-    map_free(entering_groups);
+    bitset_free(entering_groups);
     map_set(powersets, &start_set, &first_state->id);
     list_push_back(set_queue, &start_set);
 
     // Add states until we can't
     while (!list_empty(set_queue))
     {
-        Set *current_set = *(Set **)list_pop_front_value(set_queue);
+        // Every set is owned by `powersets` between two iterations
+        if (budget_exceeded(budget, automaton))
+        {
+            list_free(set_queue);
+            map_free(state_sets);
+            free_powersets(powersets);
+            automaton_free(automaton);
+            return NULL;
+        }
+
+        BitSet *current_set = *(BitSet **)list_pop_front_value(set_queue);
         size_t current_id = *(size_t *)map_get(powersets, &current_set);
         State *src_state = *(State **)array_get(automaton->states, current_id);
 
         map_clear(state_sets);
 
         // Initialize the `state_sets` dict
-        { map_foreach_key(
-            size_t, state_id, current_set,
+        { bitset_foreach(
+            state_id, current_set,
             {
-                for (Letter c = 0; c < 255; c++)
+                for (size_t e = csr->offsets[state_id];
+                     e < csr->offsets[state_id + 1]; e++)
                 {
-                    LinkedList *list =
-                        get_matrix_elt(source, state_id, c, c == 0);
-                    if (list_empty(list))
+                    // Epsilon transitions are stored with the letter 0
+                    uint16_t label = csr->edges[e].label;
+                    if (label == 0)
                         continue;
+                    Letter c = label == EPSILON_INDEX ? 0 : label;
 
-                    Set *set;
+                    BitSet *set;
                     void *ptr = map_get(state_sets, &c);
                     if (ptr == NULL)
                     {
-                        set = Set(size_t, &hash_size_t, &compare_size_t);
+                        set = BitSet(source->size);
                         map_set(state_sets, &c, &set);
                     }
                     else
-                        set = *(Set **)ptr;
+                        set = *(BitSet **)ptr;
 
-                    list_foreach(State *, next, list) set_add(set, &next->id);
+                    bitset_add(set, csr->edges[e].target);
                 }
             }) }
 
@@ -85,7 +114,7 @@ Automaton *determine(const Automaton *source)
         // create a corresponding state and map it.
         // Create a transition from the current state to the next one.
         map_foreach_key(Letter, value, state_sets, {
-            Set *set = *(Set **)map_get(state_sets, &value);
+            BitSet *set = *(BitSet **)map_get(state_sets, &value);
             State *dst_state;
             void *ptr = map_get(powersets, &set);
             int free_set = 0;
@@ -94,12 +123,12 @@ Automaton *determine(const Automaton *source)
                 // If at least one dst_state is terminal in the source,
                 // the new dst_state is terminal.
                 terminal = 0;
-                map_foreach_key(size_t, id, set, {
+                bitset_foreach(id, set, {
                     State *state = *(State **)array_get(source->states, id);
                     if (state->terminal)
                     {
                         terminal = 1;
-                        // map_foreach_key uses two loops, break isn't
+                        // bitset_foreach uses two loops, break isn't
                         // enough
                         goto out101;
                     }
@@ -118,16 +147,16 @@ Automaton *determine(const Automaton *source)
 
             automaton_add_transition(automaton, src_state, dst_state, value, 0);
 
-            map_foreach_key(size_t, src_id, current_set, {
+            bitset_foreach(src_id, current_set, {
                 State *src = *(State **)array_get(source->states, src_id);
-                map_foreach_key(size_t, dst_id, set, {
+                bitset_foreach(dst_id, set, {
                     State *dst = *(State **)array_get(source->states, dst_id);
 
-                    Set *groups = get_entering_groups((Automaton *)source, src,
-                                                      dst, value, 0);
+                    BitSet *groups = get_entering_groups(
+                        (Automaton *)source, src, dst, value, 0);
                     if (groups != NULL)
                     {
-                        map_foreach_key(size_t, group, groups, {
+                        bitset_foreach(group, groups, {
                             automaton_mark_entering(automaton, src_state,
                                                     dst_state, value, 0, group);
                         })
@@ -137,7 +166,7 @@ Automaton *determine(const Automaton *source)
                                                value, 0);
                     if (groups != NULL)
                     {
-                        map_foreach_key(size_t, group, groups, {
+                        bitset_foreach(group, groups, {
                             automaton_mark_leaving(automaton, src_state,
                                                    dst_state, value, 0, group);
                         })
@@ -145,15 +174,15 @@ Automaton *determine(const Automaton *source)
                 });
             });
 
-            map_foreach_key(size_t, dst_id, set, {
+            bitset_foreach(dst_id, set, {
                 State *dst = *(State **)array_get(source->states, dst_id);
                 if (dst->terminal)
                 {
-                    Set *groups =
+                    BitSet *groups =
                         get_leaving_group((Automaton *)source, dst, NULL, 0, 0);
                     if (groups != NULL)
                     {
-                        map_foreach_key(size_t, group, groups, {
+                        bitset_foreach(group, groups, {
                             automaton_mark_leaving(automaton, dst_state, NULL,
                                                    value, 0, group);
                         })
@@ -162,7 +191,7 @@ Automaton *determine(const Automaton *source)
             });
 
             if (free_set)
-                map_free(set);
+                bitset_free(set);
         })
     }
 
@@ -267,5 +296,6 @@ Automaton *build_search_dfa(Automaton *source)
 
 static void free_powersets(Map *powersets)
 {
-    map_foreach_key(Set *, set, powersets, map_free(set);) map_free(powersets);
+    map_foreach_key(BitSet *, set, powersets, bitset_free(set);)
+    map_free(powersets);
 }
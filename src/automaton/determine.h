@@ -1,6 +1,21 @@
 #pragma once
 #include "automaton.h"
 
+/**
+ * @struct DeterminizeBudget
+ * @brief Limits of a determinization, 0 for no limit.
+ */
+typedef struct DeterminizeBudget
+{
+    size_t max_states;
+    /**
+     * Maximum number of bytes allocated by the calling thread since it had
+     * allocated `base_bytes`, see allocation_counters.
+     */
+    size_t max_bytes;
+    size_t base_bytes;
+} DeterminizeBudget;
+
 /**
  * Determine an automaton using the powerset construction
  * @param source The source NFA without epsilon-moves.
@@ -8,6 +23,20 @@
  */
 Automaton *determine(const Automaton *source);
 
+/**
+ * Same as determine, giving up as soon as the DFA goes over a budget.
+ * @param budget The limits, NULL for none.
+ * @return An equivalent DFA, or NULL if it does not fit in the budget.
+ */
+Automaton *determine_bounded(const Automaton *source,
+                             const DeterminizeBudget *budget);
+
+/**
+ * @return Non zero if an automaton being built is over a budget.
+ */
+int budget_exceeded(const DeterminizeBudget *budget,
+                    const Automaton *automaton);
+
 /**
  * Build a DFA with extra transitions for optimal
  * substring search without having to backtrack.
@@ -0,0 +1,426 @@
+#include "automaton/dfa_table.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "automaton/jit.h"
+#include "datatypes/array.h"
+#include "datatypes/map.h"
+#include "utils/errors.h"
+#include "utils/memory_utils.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define TAG_STRIDE (DFA_TABLE_ALPHABET + 1)
+
+/**
+ * A single group entered or left by a transition, before the tags are
+ * packed in the image.
+ */
+typedef struct RawTag
+{
+    uint32_t key;
+    int leaving;
+    uint32_t group;
+} RawTag;
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static uint64_t fnv1a(const unsigned char *data, size_t size)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static int compare_raw_tags(const void *lhs, const void *rhs)
+{
+    const RawTag *a = lhs;
+    const RawTag *b = rhs;
+    if (a->key != b->key)
+        return a->key > b->key ? 1 : -1;
+    if (a->leaving != b->leaving)
+        return a->leaving - b->leaving;
+    if (a->group != b->group)
+        return a->group > b->group ? 1 : -1;
+    return 0;
+}
+
+/**
+ * Turn the entries of a tag map of the automaton into raw tags.
+ * Transitions between two states are keyed by their source and letter,
+ * transitions from or to the outside by the state they touch. Transitions
+ * that can't be queried at match time are ignored.
+ */
+static void collect_tags(const Automaton *automaton, Map *map, int leaving,
+                         Array *raw_tags)
+{
+    map_foreach_key(Transition, tr, map, {
+        size_t state;
+        size_t letter;
+        if (tr.old_src != 0 && tr.old_dst != 0 && !tr.is_epsilon)
+        {
+            state = tr.old_src - 1;
+            letter = tr.letter;
+        }
+        else if (!leaving && tr.old_src == 0 && tr.old_dst != 0)
+        {
+            state = tr.old_dst - 1;
+            letter = DFA_TAG_STATE;
+        }
+        else if (leaving && tr.old_src != 0 && tr.old_dst == 0)
+        {
+            state = tr.old_src - 1;
+            letter = DFA_TAG_STATE;
+        }
+        else
+            continue;
+
+        if (state >= automaton->size)
+            continue;
+
+        BitSet *groups = *(BitSet **)map_get(map, &tr);
+        bitset_foreach(group, groups, {
+            RawTag raw;
+            raw.key = state * TAG_STRIDE + letter;
+            raw.leaving = leaving;
+            raw.group = group;
+            array_append(raw_tags, &raw);
+        })
+    })
+}
+
+static DfaTable *dfa_table_from_image(const void *image, size_t image_size,
+                                      int mapped)
+{
+    const DfaImageHeader *header = image;
+    const char *base = image;
+
+    DfaTable *table = SAFEMALLOC(sizeof(DfaTable));
+    table->size = header->size;
+    table->start = header->start;
+    table->nb_groups = header->nb_groups;
+    table->transitions =
+        (const int32_t *)(base + header->transitions_offset);
+    table->terminal = (const uint8_t *)(base + header->terminal_offset);
+    table->tags = (const DfaTag *)(base + header->tags_offset);
+    table->tag_count = header->tag_count;
+    table->groups = (const uint32_t *)(base + header->groups_offset);
+    table->pattern = base + header->pattern_offset;
+    table->image = image;
+    table->image_size = image_size;
+    table->mapped = mapped;
+    table->jit = NULL;
+
+    return table;
+}
+
+DfaTable *dfa_table_build(const Automaton *automaton, const char *pattern)
+{
+    if (automaton->starting_states->size > 1)
+        return NULL;
+
+    size_t size = automaton->size;
+    int32_t start = DFA_NO_STATE;
+    if (automaton->starting_states->size == 1)
+        start = (*(State **)array_get(automaton->starting_states, 0))->id;
+
+    // Gather the tags first to know the size of the image
+    Array *raw_tags = Array(RawTag);
+    collect_tags(automaton, automaton->entering_transitions, 0, raw_tags);
+    collect_tags(automaton, automaton->leaving_transitions, 1, raw_tags);
+    qsort(raw_tags->data, raw_tags->size, sizeof(RawTag), compare_raw_tags);
+
+    size_t tag_count = 0;
+    for (size_t i = 0; i < raw_tags->size; i++)
+    {
+        RawTag *raw = array_get(raw_tags, i);
+        if (i == 0 || raw->key != ((RawTag *)array_get(raw_tags, i - 1))->key)
+            tag_count++;
+    }
+
+    size_t pattern_length = pattern == NULL ? 0 : strlen(pattern);
+
+    DfaImageHeader header;
+    memset(&header, 0, sizeof(DfaImageHeader));
+    memcpy(header.magic, DFA_TABLE_MAGIC, sizeof(DFA_TABLE_MAGIC));
+    header.byte_order = DFA_TABLE_BYTE_ORDER;
+    header.version = DFA_TABLE_VERSION;
+    header.size = size;
+    header.start = start;
+    header.nb_groups = automaton->nb_groups;
+    header.tag_count = tag_count;
+    header.group_count = raw_tags->size;
+    header.pattern_length = pattern_length;
+
+    size_t offset = align8(sizeof(DfaImageHeader));
+    header.transitions_offset = offset;
+    offset += align8(size * DFA_TABLE_ALPHABET * sizeof(int32_t));
+    header.tags_offset = offset;
+    offset += align8(tag_count * sizeof(DfaTag));
+    header.groups_offset = offset;
+    offset += align8(raw_tags->size * sizeof(uint32_t));
+    header.terminal_offset = offset;
+    offset += align8(size);
+    header.pattern_offset = offset;
+    offset += align8(pattern_length + 1);
+    header.image_size = offset;
+
+    char *image = SAFECALLOC(offset, 1);
+
+    // Transitions
+    int32_t *transitions = (int32_t *)(image + header.transitions_offset);
+    for (size_t state = 0; state < size; state++)
+    {
+        int32_t *row = transitions + state * DFA_TABLE_ALPHABET;
+        row[0] = DFA_NO_STATE;
+        for (size_t letter = 1; letter < DFA_TABLE_ALPHABET; letter++)
+        {
+            LinkedList *list = get_matrix_elt(automaton, state, letter, 0);
+            if (list_empty(list))
+            {
+                row[letter] = DFA_NO_STATE;
+                continue;
+            }
+            if (list->next->next != NULL)
+            {
+                SAFEFREE(image);
+                array_free(raw_tags);
+                return NULL;
+            }
+            row[letter] = (*(State **)list->next->data)->id;
+        }
+    }
+
+    // Terminal states
+    uint8_t *terminal = (uint8_t *)(image + header.terminal_offset);
+    arr_foreach(State *, state, automaton->states)
+        terminal[state->id] = state->terminal != 0;
+
+    // Tags, each key gets a record pointing to its entering then
+    // leaving groups in the group array.
+    DfaTag *tags = (DfaTag *)(image + header.tags_offset);
+    uint32_t *groups = (uint32_t *)(image + header.groups_offset);
+    size_t tag_index = 0;
+    for (size_t i = 0; i < raw_tags->size; i++)
+    {
+        RawTag *raw = array_get(raw_tags, i);
+        if (i > 0 && tags[tag_index].key != raw->key)
+            tag_index++;
+        DfaTag *tag = tags + tag_index;
+        if (tag->enter_count == 0 && tag->leave_count == 0)
+        {
+            tag->key = raw->key;
+            tag->enter_offset = i;
+            tag->leave_offset = i;
+        }
+        if (raw->leaving)
+        {
+            if (tag->leave_count == 0)
+                tag->leave_offset = i;
+            tag->leave_count++;
+        }
+        else
+            tag->enter_count++;
+        groups[i] = raw->group;
+    }
+    array_free(raw_tags);
+
+    if (pattern != NULL)
+        memcpy(image + header.pattern_offset, pattern, pattern_length);
+
+    header.checksum = fnv1a((unsigned char *)image + sizeof(DfaImageHeader),
+                            header.image_size - sizeof(DfaImageHeader));
+    memcpy(image, &header, sizeof(DfaImageHeader));
+
+    return dfa_table_from_image(image, header.image_size, 0);
+}
+
+int dfa_table_save(const DfaTable *table, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        rationl_errno = ENOFILE;
+        return -1;
+    }
+
+    size_t written = fwrite(table->image, 1, table->image_size, file);
+    if (fclose(file) != 0 || written != table->image_size)
+    {
+        rationl_errno = ENOFILE;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int check_section(const DfaImageHeader *header, uint64_t offset,
+                         uint64_t size)
+{
+    return offset % 8 == 0 && offset >= sizeof(DfaImageHeader)
+        && offset <= header->image_size
+        && size <= header->image_size - offset;
+}
+
+/**
+ * Verify that an image is well formed so that the matching functions never
+ * read outside of it.
+ * @return 0 if the image is valid, else the corresponding error code.
+ */
+static int check_image(const void *image, size_t image_size)
+{
+    const DfaImageHeader *header = image;
+    if (image_size < sizeof(DfaImageHeader)
+        || memcmp(header->magic, DFA_TABLE_MAGIC, sizeof(DFA_TABLE_MAGIC))
+            != 0)
+        return EBADFMT;
+    if (header->byte_order != DFA_TABLE_BYTE_ORDER
+        || header->version != DFA_TABLE_VERSION)
+        return EBADVER;
+    if (header->image_size != image_size)
+        return EBADFMT;
+
+    const unsigned char *bytes = image;
+    if (fnv1a(bytes + sizeof(DfaImageHeader),
+              image_size - sizeof(DfaImageHeader))
+        != header->checksum)
+        return EBADSUM;
+
+    uint64_t size = header->size;
+    if (!check_section(header, header->transitions_offset,
+                       size * DFA_TABLE_ALPHABET * sizeof(int32_t))
+        || !check_section(header, header->tags_offset,
+                          (uint64_t)header->tag_count * sizeof(DfaTag))
+        || !check_section(header, header->groups_offset,
+                          (uint64_t)header->group_count * sizeof(uint32_t))
+        || !check_section(header, header->terminal_offset, size)
+        || !check_section(header, header->pattern_offset,
+                          (uint64_t)header->pattern_length + 1))
+        return EBADFMT;
+
+    if (header->start < DFA_NO_STATE || header->start >= (int64_t)size)
+        return EBADFMT;
+
+    const int32_t *transitions =
+        (const int32_t *)(bytes + header->transitions_offset);
+    for (uint64_t i = 0; i < size * DFA_TABLE_ALPHABET; i++)
+        if (transitions[i] < DFA_NO_STATE || transitions[i] >= (int64_t)size)
+            return EBADFMT;
+
+    const DfaTag *tags = (const DfaTag *)(bytes + header->tags_offset);
+    for (uint32_t i = 0; i < header->tag_count; i++)
+    {
+        if ((i > 0 && tags[i].key <= tags[i - 1].key)
+            || tags[i].key >= size * TAG_STRIDE
+            || (uint64_t)tags[i].enter_offset + tags[i].enter_count
+                > header->group_count
+            || (uint64_t)tags[i].leave_offset + tags[i].leave_count
+                > header->group_count)
+            return EBADFMT;
+    }
+
+    const uint32_t *groups = (const uint32_t *)(bytes + header->groups_offset);
+    for (uint32_t i = 0; i < header->group_count; i++)
+        if (groups[i] >= header->nb_groups)
+            return EBADFMT;
+
+    if (bytes[header->pattern_offset + header->pattern_length] != 0)
+        return EBADFMT;
+
+    return 0;
+}
+
+DfaTable *dfa_table_load(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        rationl_errno = ENOFILE;
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(DfaImageHeader))
+    {
+        close(fd);
+        rationl_errno = EBADFMT;
+        return NULL;
+    }
+
+    size_t image_size = st.st_size;
+    void *image = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        rationl_errno = ENOFILE;
+        return NULL;
+    }
+
+    int error = check_image(image, image_size);
+    if (error != 0)
+    {
+        munmap(image, image_size);
+        rationl_errno = error;
+        return NULL;
+    }
+
+    return dfa_table_from_image(image, image_size, 1);
+}
+
+const DfaTag *dfa_table_get_tag(const DfaTable *table, size_t state,
+                                size_t letter)
+{
+    uint32_t key = state * TAG_STRIDE + letter;
+    size_t low = 0;
+    size_t high = table->tag_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (table->tags[mid].key == key)
+            return table->tags + mid;
+        if (table->tags[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
+void dfa_table_free(DfaTable *table)
+{
+    if (table == NULL)
+        return;
+    dfa_jit_free(table->jit);
+    if (table->mapped)
+        munmap((void *)table->image, table->image_size);
+    else
+        free((void *)table->image);
+    free(table);
+}
+
+size_t dfa_table_memory_usage(const DfaTable *table)
+{
+    if (table == NULL)
+        return 0;
+
+    size_t bytes = sizeof(DfaTable) + table->image_size;
+    if (table->jit != NULL)
+    {
+        // The native code is mapped in whole pages
+        size_t page = sysconf(_SC_PAGESIZE);
+        bytes += sizeof(DfaJit) + (table->jit->size + page - 1) / page * page;
+    }
+    return bytes;
+}
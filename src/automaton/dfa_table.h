@@ -0,0 +1,171 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "automaton/automaton.h"
+
+#define DFA_TABLE_MAGIC "RATIONL"
+#define DFA_TABLE_VERSION 1
+#define DFA_TABLE_BYTE_ORDER 0x01020304
+#define DFA_TABLE_ALPHABET 256
+#define DFA_NO_STATE (-1)
+
+/**
+ * Letter index used in a tag key for the tags attached to a state itself
+ * (entering it from outside the automaton or leaving it to the outside).
+ */
+#define DFA_TAG_STATE DFA_TABLE_ALPHABET
+
+/**
+ * @struct DfaImageHeader
+ * @brief Header at the beginning of a compiled DFA image.
+ * The image is a single contiguous block that is both the in-memory
+ * representation of a DfaTable and its on-disk format, so that a saved file
+ * can be mapped in memory and used as is.
+ * All offsets are relative to the beginning of the image and aligned on
+ * 8 bytes.
+ */
+typedef struct DfaImageHeader
+{
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint64_t image_size;
+    /**
+     * FNV-1a hash of everything that follows the header.
+     */
+    uint64_t checksum;
+
+    uint32_t size;
+    int32_t start;
+    uint32_t nb_groups;
+    uint32_t tag_count;
+    uint32_t group_count;
+    uint32_t pattern_length;
+
+    uint64_t transitions_offset;
+    uint64_t tags_offset;
+    uint64_t groups_offset;
+    uint64_t terminal_offset;
+    uint64_t pattern_offset;
+} DfaImageHeader;
+
+/**
+ * @struct DfaTag
+ * @brief Groups entered and left when taking a transition of a DfaTable.
+ * The key is `state * (DFA_TABLE_ALPHABET + 1) + letter`. When the letter
+ * is DFA_TAG_STATE, `enter` contains the groups entered when starting a
+ * match in the state and `leave` the groups left when a match ends in it.
+ * The group ids themselves are stored in the `groups` array of the table.
+ */
+typedef struct DfaTag
+{
+    uint32_t key;
+    uint32_t enter_offset;
+    uint32_t enter_count;
+    uint32_t leave_offset;
+    uint32_t leave_count;
+} DfaTag;
+
+/**
+ * @struct DfaTable
+ * @brief Flat representation of a deterministic automaton used at match time.
+ * Every array points inside `image`, which is either heap allocated or
+ * mapped from a file by dfa_table_load.
+ */
+typedef struct DfaTable
+{
+    /**
+     * Number of states. States are numbered from 0 to size - 1.
+     */
+    size_t size;
+
+    /**
+     * The starting state, DFA_NO_STATE if the automaton recognizes nothing.
+     */
+    int32_t start;
+
+    size_t nb_groups;
+
+    /**
+     * Transition table with DFA_TABLE_ALPHABET columns per state.
+     * A cell contains the target state or DFA_NO_STATE.
+     */
+    const int32_t *transitions;
+
+    /**
+     * Non zero for terminal states.
+     */
+    const uint8_t *terminal;
+
+    /**
+     * Tags sorted by key, see DfaTag.
+     */
+    const DfaTag *tags;
+    size_t tag_count;
+
+    const uint32_t *groups;
+
+    /**
+     * The pattern the table was compiled from.
+     */
+    const char *pattern;
+
+    const void *image;
+    size_t image_size;
+
+    /**
+     * True if the image is mapped from a file rather than allocated.
+     */
+    int mapped;
+
+    /**
+     * Native code for the table, NULL unless compiled by dfa_jit_compile.
+     */
+    struct DfaJit *jit;
+} DfaTable;
+
+/**
+ * Flatten a deterministic automaton into a DfaTable.
+ * @param automaton An automaton with at most one starting state and at most
+ * one target per state and letter.
+ * @param pattern The pattern stored along with the table, can be NULL.
+ * @return The new table, or NULL if the automaton is not deterministic.
+ */
+DfaTable *dfa_table_build(const Automaton *automaton, const char *pattern);
+
+/**
+ * Write the image of a table to a file.
+ * @return 0 on success, -1 on error with rationl_errno set accordingly.
+ */
+int dfa_table_save(const DfaTable *table, const char *path);
+
+/**
+ * Map a file written by dfa_table_save in memory.
+ * The version, checksum and bounds of the image are verified, the
+ * tables are then used directly from the mapping without any copy.
+ * @return The table, or NULL on error with rationl_errno set accordingly.
+ */
+DfaTable *dfa_table_load(const char *path);
+
+/**
+ * Get the tags of a transition.
+ * @param letter The letter of the transition or DFA_TAG_STATE.
+ * @return The tag, or NULL if the transition neither enters nor leaves
+ * a group.
+ */
+const DfaTag *dfa_table_get_tag(const DfaTable *table, size_t state,
+                                size_t letter);
+
+/**
+ * Frees a table, or unmaps it if it was loaded from a file, along with its
+ * native code.
+ */
+void dfa_table_free(DfaTable *table);
+
+/**
+ * @return The bytes held by a table: its image, mapped or not, and its
+ * native code.
+ */
+size_t dfa_table_memory_usage(const DfaTable *table);
@@ -0,0 +1,65 @@
+#include "automaton/flat_nfa.h"
+
+#include "utils/memory_utils.h"
+
+FlatNfa *flat_nfa_build(Automaton *automaton)
+{
+    const AutomatonCsr *csr = automaton_freeze(automaton);
+    FlatNfa *nfa = SAFEMALLOC(sizeof(FlatNfa));
+    nfa->size = automaton->size;
+    nfa->states = SAFEMALLOC((automaton->size + 1) * sizeof(FlatState));
+    nfa->edges =
+        SAFEMALLOC((csr->offsets[automaton->size] + 1) * sizeof(FlatEdge));
+
+    size_t edge_count = 0;
+    for (size_t i = 0; i < automaton->size; i++)
+    {
+        State *state = *(State **)array_get(automaton->states, i);
+        FlatState *flat_state = nfa->states + i;
+        flat_state->offset = edge_count;
+        flat_state->terminal = state->terminal;
+        for (size_t e = csr->offsets[i]; e < csr->offsets[i + 1]; e++)
+        {
+            const AutomatonEdge *edge = csr->edges + e;
+            if (edge->label == EPSILON_INDEX)
+                continue;
+            FlatEdge *flat_edge = nfa->edges + edge_count++;
+            flat_edge->target = edge->target;
+            flat_edge->letter = edge->label;
+        }
+        flat_state->count = edge_count - flat_state->offset;
+    }
+
+    nfa->start_count = automaton->starting_states->size;
+    nfa->starts = SAFEMALLOC((nfa->start_count + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < nfa->start_count; i++)
+        nfa->starts[i] =
+            (*(State **)array_get(automaton->starting_states, i))->id;
+
+    return nfa;
+}
+
+void flat_nfa_free(FlatNfa *nfa)
+{
+    if (nfa == NULL)
+        return;
+    free(nfa->states);
+    free(nfa->edges);
+    free(nfa->starts);
+    free(nfa);
+}
+
+size_t flat_nfa_memory_usage(const FlatNfa *nfa)
+{
+    if (nfa == NULL)
+        return 0;
+
+    size_t edges = 0;
+    for (size_t i = 0; i < nfa->size; i++)
+        edges += nfa->states[i].count;
+
+    // Every array has room for one more element, see flat_nfa_build
+    return sizeof(FlatNfa) + (nfa->size + 1) * sizeof(FlatState)
+        + (edges + 1) * sizeof(FlatEdge)
+        + (nfa->start_count + 1) * sizeof(uint32_t);
+}
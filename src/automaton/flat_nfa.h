@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "automaton/automaton.h"
+
+/**
+ * @struct FlatEdge
+ * @brief A transition of a flat NFA.
+ */
+typedef struct FlatEdge
+{
+    uint32_t target;
+    Letter letter;
+} FlatEdge;
+
+/**
+ * @struct FlatState
+ * @brief A state of a flat NFA, its transitions are edges[offset] to
+ * edges[offset + count - 1], sorted by letter.
+ */
+typedef struct FlatState
+{
+    uint32_t offset;
+    uint32_t count;
+    int terminal;
+} FlatState;
+
+/**
+ * @struct FlatNfa
+ * @brief Flat copy of an epsilon free NFA, matched in place of the
+ * automaton by the expressions without a table.
+ */
+typedef struct FlatNfa
+{
+    size_t size;
+    FlatState *states;
+    FlatEdge *edges;
+    uint32_t *starts;
+    size_t start_count;
+} FlatNfa;
+
+/**
+ * Flatten an epsilon free NFA.
+ */
+FlatNfa *flat_nfa_build(Automaton *automaton);
+
+void flat_nfa_free(FlatNfa *nfa);
+
+/**
+ * @return The bytes held by a flat NFA, 0 for NULL.
+ */
+size_t flat_nfa_memory_usage(const FlatNfa *nfa);
@@ -0,0 +1,277 @@
+#include "automaton/jit.h"
+
+#if defined(ENABLE_JIT) && defined(__x86_64__)
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "datatypes/array.h"
+#include "utils/memory_utils.h"
+
+/**
+ * States with more ranges of letters than this use a jump table.
+ */
+#define JIT_MAX_COMPARE_RANGES 6
+
+#define JIT_RET_LABEL (-1)
+
+typedef struct JitBuffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} JitBuffer;
+
+/**
+ * A 32 bits value to patch once every state is placed: the offset of the
+ * `label` block relative to `base`.
+ */
+typedef struct JitFixup
+{
+    size_t at;
+    size_t base;
+    int32_t label;
+} JitFixup;
+
+/**
+ * Consecutive letters going to the same state.
+ */
+typedef struct JitRange
+{
+    size_t first;
+    size_t last;
+    int32_t target;
+} JitRange;
+
+static void emit(JitBuffer *buffer, const uint8_t *bytes, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = 2 * (buffer->size + size);
+        buffer->data = SAFEREALLOC(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+static void emit_i32(JitBuffer *buffer, int32_t value)
+{
+    emit(buffer, (const uint8_t *)&value, sizeof(value));
+}
+
+/**
+ * Emit a 32 bits placeholder patched with the offset of a label.
+ */
+static void emit_label(JitBuffer *buffer, Array *fixups, size_t base,
+                       int32_t label)
+{
+    JitFixup fixup = { .at = buffer->size, .base = base, .label = label };
+    array_append(fixups, &fixup);
+    emit_i32(buffer, 0);
+}
+
+/**
+ * Emit a conditional jump, `condition` being the second opcode byte.
+ */
+static void emit_jcc(JitBuffer *buffer, Array *fixups, uint8_t condition,
+                     int32_t label)
+{
+    const uint8_t code[] = { 0x0f, condition };
+    emit(buffer, code, sizeof(code));
+    emit_label(buffer, fixups, buffer->size + 4, label);
+}
+
+#define JCC_JE 0x84
+#define JCC_JBE 0x86
+
+static size_t state_ranges(const DfaTable *table, int32_t state,
+                           JitRange *ranges)
+{
+    const int32_t *row = table->transitions + state * DFA_TABLE_ALPHABET;
+    size_t count = 0;
+    for (size_t letter = 1; letter < DFA_TABLE_ALPHABET; letter++)
+    {
+        if (row[letter] == DFA_NO_STATE)
+            continue;
+        if (count != 0 && ranges[count - 1].last == letter - 1
+            && ranges[count - 1].target == row[letter])
+        {
+            ranges[count - 1].last = letter;
+            continue;
+        }
+        ranges[count].first = letter;
+        ranges[count].last = letter;
+        ranges[count].target = row[letter];
+        count++;
+    }
+
+    return count;
+}
+
+static void emit_compare_chain(JitBuffer *buffer, Array *fixups,
+                               const JitRange *ranges, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ranges[i].first == ranges[i].last)
+        {
+            // cmp ecx, letter; je target
+            const uint8_t cmp[] = { 0x81, 0xf9 };
+            emit(buffer, cmp, sizeof(cmp));
+            emit_i32(buffer, ranges[i].first);
+            emit_jcc(buffer, fixups, JCC_JE, ranges[i].target);
+            continue;
+        }
+
+        // lea edx, [rcx - first]; cmp edx, last - first; jbe target
+        const uint8_t lea[] = { 0x8d, 0x91 };
+        emit(buffer, lea, sizeof(lea));
+        emit_i32(buffer, -(int32_t)ranges[i].first);
+        const uint8_t cmp[] = { 0x81, 0xfa };
+        emit(buffer, cmp, sizeof(cmp));
+        emit_i32(buffer, ranges[i].last - ranges[i].first);
+        emit_jcc(buffer, fixups, JCC_JBE, ranges[i].target);
+    }
+
+    const uint8_t ret[] = { 0xc3 };
+    emit(buffer, ret, sizeof(ret));
+}
+
+static void emit_jump_table(JitBuffer *buffer, Array *fixups,
+                            const DfaTable *table, int32_t state)
+{
+    // lea rdx, [rip + table]; movsxd rcx, [rdx + rcx * 4]; add rcx, rdx;
+    // jmp rcx, the table follows the jump aligned on 4 bytes
+    size_t after_lea = buffer->size + 7;
+    size_t table_start = (buffer->size + 16 + 3) & ~(size_t)3;
+    const uint8_t lea[] = { 0x48, 0x8d, 0x15 };
+    emit(buffer, lea, sizeof(lea));
+    emit_i32(buffer, table_start - after_lea);
+    const uint8_t jump[] = { 0x48, 0x63, 0x0c, 0x8a, 0x48,
+                             0x01, 0xd1, 0xff, 0xe1 };
+    emit(buffer, jump, sizeof(jump));
+    const uint8_t int3[] = { 0xcc };
+    while (buffer->size < table_start)
+        emit(buffer, int3, sizeof(int3));
+
+    const int32_t *row = table->transitions + state * DFA_TABLE_ALPHABET;
+    for (size_t letter = 0; letter < DFA_TABLE_ALPHABET; letter++)
+        emit_label(buffer, fixups, table_start,
+                   row[letter] == DFA_NO_STATE ? JIT_RET_LABEL : row[letter]);
+}
+
+/**
+ * Generate the code of the table. The string is read from rdi, rsi keeps
+ * its beginning and rax the end of the longest match found so far.
+ */
+static void generate(JitBuffer *buffer, const DfaTable *table,
+                     size_t *labels, size_t *ret_label)
+{
+    Array *fixups = Array(JitFixup);
+    JitRange ranges[DFA_TABLE_ALPHABET];
+
+    // mov rsi, rdi; mov rax, -1; jmp start
+    const uint8_t prologue[] = { 0x48, 0x89, 0xfe, 0x48, 0xc7,
+                                 0xc0, 0xff, 0xff, 0xff, 0xff, 0xe9 };
+    emit(buffer, prologue, sizeof(prologue));
+    emit_label(buffer, fixups, buffer->size + 4, table->start);
+
+    *ret_label = buffer->size;
+    const uint8_t ret[] = { 0xc3 };
+    emit(buffer, ret, sizeof(ret));
+
+    for (size_t state = 0; state < table->size; state++)
+    {
+        labels[state] = buffer->size;
+        if (table->terminal[state])
+        {
+            // mov rax, rdi; sub rax, rsi
+            const uint8_t end[] = { 0x48, 0x89, 0xf8, 0x48, 0x29, 0xf0 };
+            emit(buffer, end, sizeof(end));
+        }
+
+        size_t count = state_ranges(table, state, ranges);
+        if (count == 0)
+        {
+            emit(buffer, ret, sizeof(ret));
+            continue;
+        }
+
+        // movzx ecx, byte [rdi]; inc rdi
+        const uint8_t next[] = { 0x0f, 0xb6, 0x0f, 0x48, 0xff, 0xc7 };
+        emit(buffer, next, sizeof(next));
+        if (count <= JIT_MAX_COMPARE_RANGES)
+            emit_compare_chain(buffer, fixups, ranges, count);
+        else
+            emit_jump_table(buffer, fixups, table, state);
+    }
+
+    for (size_t i = 0; i < fixups->size; i++)
+    {
+        JitFixup *fixup = array_get(fixups, i);
+        size_t target =
+            fixup->label == JIT_RET_LABEL ? *ret_label : labels[fixup->label];
+        int32_t value = (int64_t)target - (int64_t)fixup->base;
+        memcpy(buffer->data + fixup->at, &value, sizeof(value));
+    }
+    array_free(fixups);
+}
+
+DfaJit *dfa_jit_compile(const DfaTable *table)
+{
+    if (table->start == DFA_NO_STATE)
+        return NULL;
+
+    JitBuffer buffer = { .data = NULL, .size = 0, .capacity = 0 };
+    size_t *labels = SAFEMALLOC(table->size * sizeof(size_t));
+    size_t ret_label;
+    generate(&buffer, table, labels, &ret_label);
+    free(labels);
+
+    void *code = mmap(NULL, buffer.size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        free(buffer.data);
+        return NULL;
+    }
+    memcpy(code, buffer.data, buffer.size);
+    free(buffer.data);
+    if (mprotect(code, buffer.size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(code, buffer.size);
+        return NULL;
+    }
+
+    DfaJit *jit = SAFEMALLOC(sizeof(DfaJit));
+    jit->code = code;
+    jit->size = buffer.size;
+    // The cast from an object pointer is allowed by POSIX for dlsym
+    *(void **)&jit->run = code;
+
+    return jit;
+}
+
+void dfa_jit_free(DfaJit *jit)
+{
+    if (jit == NULL)
+        return;
+    munmap(jit->code, jit->size);
+    free(jit);
+}
+
+#else
+
+DfaJit *dfa_jit_compile(const DfaTable *table)
+{
+    (void)table;
+    return NULL;
+}
+
+void dfa_jit_free(DfaJit *jit)
+{
+    (void)jit;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "automaton/dfa_table.h"
+
+/**
+ * Native matcher returning the length of the longest match at the
+ * beginning of the string, or -1 if there is none.
+ */
+typedef long (*DfaJitFunction)(const unsigned char *string);
+
+/**
+ * @struct DfaJit
+ * @brief Native code compiled from a DfaTable.
+ * Every state is a block reading the next character and dispatching on it
+ * with a chain of comparisons, or through a jump table for states with
+ * many distinct transitions.
+ */
+typedef struct DfaJit
+{
+    DfaJitFunction run;
+
+    /**
+     * The executable mapping holding the code.
+     */
+    void *code;
+    size_t size;
+} DfaJit;
+
+/**
+ * Compile a table to native code.
+ * The JIT is only available on x86-64 when the library is configured with
+ * --enable-jit, the table matchers are used otherwise.
+ * @return The compiled code, or NULL if the JIT is not available or if
+ * executable memory cannot be allocated.
+ */
+DfaJit *dfa_jit_compile(const DfaTable *table);
+
+void dfa_jit_free(DfaJit *jit);
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "minimization.h"
 #include "datatypes/array.h"
 #include "automaton.h"
@@ -5,11 +7,55 @@
 #include "delete_eps.h"
 #include "prune.h"
 
+/**
+ * Build the transition table of the reverse of an automaton, with the same
+ * columns. Only the populated cells are visited.
+ * @param states The states the reversed transitions point to, indexed like
+ * the states of the source.
+ * @param drop_tags If non zero, the tags of the reversed transitions are
+ * removed from the source.
+ */
+static Matrix *reversed_table(Automaton *source, Array *states,
+                              int drop_tags)
+{
+    Matrix *table = source->transition_table;
+    Matrix *reversed = Matrix(table->height, table->width);
+
+    size_t symbols[NUMBER_OF_SYMB];
+    for (size_t symb = 0; symb < NUMBER_OF_SYMB; symb++)
+        if (source->lookup_table[symb] != -1)
+            symbols[source->lookup_table[symb]] = symb;
+    drop_tags = drop_tags && (source->entering_transitions->size != 0
+                              || source->leaving_transitions->size != 0);
+
+    arr_foreach(State *, src, source->states)
+    {
+        for (size_t x = 0; x < table->width; x++)
+        {
+            list_foreach(State *, dst, matrix_get(table, x, src->id))
+            {
+                LinkedList *sources = matrix_get(reversed, x, dst->id);
+                if (sources == NULL)
+                {
+                    sources = LinkedList(State *);
+                    matrix_set(reversed, x, dst->id, sources);
+                }
+                list_push_back(sources, array_get(states, src->id));
+                if (drop_tags)
+                    _automaton_remove_transition_from_maps(
+                        source, src, dst, symbols[x],
+                        symbols[x] == EPSILON_INDEX);
+            }
+        }
+    }
+
+    return reversed;
+}
+
 Automaton *transpose(Automaton *source)
 {
-    Automaton *automaton = automaton_create(source->size, 256);
+    Automaton *automaton = automaton_create(source->size, 1);
     automaton->capacity = source->capacity;
-    automaton->lookup_used = source->lookup_used;
 
     arr_foreach(State *, state, source->states)
     {
@@ -24,26 +70,19 @@ Automaton *transpose(Automaton *source)
         new_state->terminal = 1;
     }
 
-    for(size_t j = 0; j < source->size; j++)
-    {
-        State *old_src = *(State **)(array_get(automaton->states, j));
-
-        for (size_t letter = 0; letter < 256; letter++)
-        {
-            list_foreach(State *, old_dst, get_matrix_elt(source, j, letter, letter == 0))
-            {
-                State *new_dst = *(State **)array_get(automaton->states, old_dst->id);
-                automaton_add_transition(automaton, new_dst, old_src, letter, letter == 0);
-            }
-        }
-    }
+    Matrix *reversed = reversed_table(source, automaton->states, 0);
+    matrix_free(automaton->transition_table);
+    automaton->transition_table = reversed;
+    memcpy(automaton->lookup_table, source->lookup_table,
+           NUMBER_OF_SYMB * sizeof(int));
+    automaton->lookup_used = source->lookup_used;
 
     return automaton;
 }
 
 void tr(Automaton *source)
 {
-    Array *new_transitions = Array(Transition);
+    automaton_thaw(source);
     Array *new_starting_states = Array(size_t);
 
     arr_foreach(State *, state_src, source->states)
@@ -54,30 +93,6 @@ void tr(Automaton *source)
             state_src->terminal = 0;
             array_append(new_starting_states, &state_src->id);
         }
-
-        // Update the new_transitions list
-        for (int i = 0; i < 256; i++)
-        {
-            if (source->lookup_table[i] != -1)
-            {
-                LinkedList *transitions =
-                    matrix_get(source->transition_table,
-                               source->lookup_table[i], state_src->id);
-                if (transitions == NULL)
-                    continue;
-
-                list_foreach(State *, state_dst, transitions)
-                {
-                    //Add the reversed transition to transitions
-                    Transition transition;
-                    transition.old_src = state_src->id;
-                    transition.old_dst = state_dst->id;
-                    transition.letter = i;
-                    transition.is_epsilon = (i == EPSILON_INDEX);
-                    array_append(new_transitions, &transition);
-                }
-            }
-        }
     }
 
     // Switch from starting state to terminal
@@ -93,33 +108,32 @@ void tr(Automaton *source)
         array_append(source->starting_states, (State **)array_get(source->states, position));
     }
 
-    arr_foreach(Transition, tr, new_transitions)
-    {
-        automaton_remove_transition(source,
-                                    *(State **)array_get(source->states, tr.old_src),
-                                    *(State **)array_get(source->states, tr.old_dst),
-                                    tr.letter, tr.letter==0);
-        automaton_add_transition(source,
-                                 *(State **)array_get(source->states, tr.old_dst),
-                                 *(State **)array_get(source->states, tr.old_src),
-                                 tr.letter, tr.letter==0);
-    }
+    // Reverse every transition, their tags are dropped
+    Matrix *reversed = reversed_table(source, source->states, 1);
+    matrix_free(source->transition_table);
+    source->transition_table = reversed;
 
-
-    array_free(new_transitions);
     array_free(new_starting_states);
 }
 
 Automaton *minimize(Automaton *source)
+{
+    return minimize_bounded(source, NULL);
+}
+
+Automaton *minimize_bounded(Automaton *source,
+                            const DeterminizeBudget *budget)
 {
     tr(source);
     Automaton *atm1;
-    atm1 = determine(source);
+    atm1 = determine_bounded(source, budget);
     tr(source);
+    if (atm1 == NULL)
+        return NULL;
 
     tr(atm1);
     Automaton *atm2;
-    atm2 = determine(atm1);
+    atm2 = determine_bounded(atm1, budget);
     automaton_free(atm1);
 
     return atm2;
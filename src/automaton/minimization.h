@@ -1,6 +1,7 @@
 #pragma once
 
 #include "automaton.h"
+#include "determine.h"
 
 /**
  * @author Antoine Sicard
@@ -9,3 +10,14 @@
  * @return : The minimized automaton
  */
 Automaton *minimize(Automaton *source);
+
+/**
+ * Same as minimize, giving up as soon as one of the two determinizations
+ * goes over a budget.
+ * @param budget The limits, NULL for none.
+ * @return The minimized automaton, or NULL if it does not fit in the
+ * budget. In both cases the source keeps its states and transitions, but
+ * loses its group tags.
+ */
+Automaton *minimize_bounded(Automaton *source,
+                            const DeterminizeBudget *budget);
@@ -3,7 +3,7 @@
 
 size_t _automaton_prune(Automaton * automaton, State * s, size_t * pref, int * escape, State ** higher, size_t * cpt)
 {
-    LinkedList * list;
+    const AutomatonCsr * csr = automaton_freeze(automaton);
     State * adj;
     (*cpt)++;
     escape[s->id] = s->terminal;
@@ -12,32 +12,24 @@ size_t _automaton_prune(Automaton * automaton, State * s, size_t * pref, int * e
     size_t hpref = *cpt;
     size_t adj_hpref;
 
-    for(size_t c = 0; c < automaton->transition_table->width; c++)
+    for(size_t e = csr->offsets[s->id]; e < csr->offsets[s->id + 1]; e++)
     {
-        list = matrix_get(automaton->transition_table, c, s->id);
-        if(list != NULL)
+        adj = *(State **)array_get(automaton->states, csr->edges[e].target);
+        if(higher[adj->id] == NULL)
         {
-            while(list->next != NULL)
+            adj_hpref = _automaton_prune(automaton, adj, pref, escape, higher, cpt);
+            if(adj_hpref < hpref)
             {
-                adj = *(State **)list->next->data;
-                if(higher[adj->id] == NULL)
-                {
-                    adj_hpref = _automaton_prune(automaton, adj, pref, escape, higher, cpt);
-                    if(adj_hpref < hpref)
-                    {
-                        hpref = adj_hpref;
-                        higher[s->id] = higher[adj->id];
-                    }
-                }
-                else if(pref[s->id] > pref[adj->id])
-                {
-                    higher[s->id] = higher[adj->id];
-                    hpref = pref[adj->id];
-                }
-                escape[s->id] = escape[s->id] | escape[adj->id];
-                list = list->next;
+                hpref = adj_hpref;
+                higher[s->id] = higher[adj->id];
             }
         }
+        else if(pref[s->id] > pref[adj->id])
+        {
+            higher[s->id] = higher[adj->id];
+            hpref = pref[adj->id];
+        }
+        escape[s->id] = escape[s->id] | escape[adj->id];
     }
     return hpref;
 }
@@ -57,7 +49,7 @@ void automaton_prune(Automaton * automaton)
     size_t * pref = SAFECALLOC(automaton->size, sizeof(size_t));
     int * escape = SAFECALLOC(automaton->size, sizeof(int));
     State ** higher = SAFECALLOC(automaton->size, sizeof(State *));
-    Array * to_delete = Array(State *);
+    uint8_t * to_delete = SAFECALLOC(automaton->size, sizeof(uint8_t));
     size_t cpt = 0;
 
     arr_foreach(State *, entry, automaton->starting_states)
@@ -75,20 +67,14 @@ void automaton_prune(Automaton * automaton)
 
     arr_foreach(State *, s, automaton->states)
     {
-        if((higher[s->id] == NULL) || (escape[s->id] == 0))
-        {
-            array_append(to_delete, &s);
-        }
+        to_delete[s->id] = (higher[s->id] == NULL) || (escape[s->id] == 0);
     }
 
-    arr_foreach(State *, s_r, to_delete)
-    {
-        automaton_remove_state(automaton, s_r);
-    }
+    automaton_remove_states(automaton, to_delete);
 
-    free(higher);
-    free(pref);
-    free(escape);
-    array_free(to_delete);
+    SAFEFREE(higher);
+    SAFEFREE(pref);
+    SAFEFREE(escape);
+    SAFEFREE(to_delete);
 }
 
@@ -163,5 +163,5 @@ static void free_adj_mat(Array **mat, size_t size)
         if (mat[i] != NULL)
             array_free(mat[i]);
 
-    free(mat);
+    SAFEFREE(mat);
 }
@@ -9,19 +9,19 @@
 
 int _leaves_self(Automaton * aut, State * src, size_t grp)
 {
-    Set * set = get_leaving_group(aut, src, NULL, 0, 1);
+    BitSet * set = get_leaving_group(aut, src, NULL, 0, 1);
     if(set != NULL)
-        return (map_get(set, &grp) != NULL);
+        return bitset_contains(set, grp);
     return 0;
 }
 
-void _transfer_leaving_set_to(Automaton * aut, Set * set, State * src, State * dst)
+void _transfer_leaving_set_to(Automaton * aut, BitSet * set, State * src, State * dst)
 {
     //CAREFULL ONLY WITH EPSILONS
     if(set != NULL)
     {
-        map_foreach_key(
-            size_t, grp, set,
+        bitset_foreach(
+            grp, set,
             {
                 automaton_mark_leaving(aut, src, dst, 
                         0, 1, grp);
@@ -30,13 +30,13 @@ void _transfer_leaving_set_to(Automaton * aut, Set * set, State * src, State * d
     }
 }
 
-void _transfer_entering_set_to(Automaton * aut, Set * set, State * src, State * dst)
+void _transfer_entering_set_to(Automaton * aut, BitSet * set, State * src, State * dst)
 {
     //CAREFULL ONLY WITH EPSILONS
     if(set != NULL)
     {
-        map_foreach_key(
-            size_t, grp, set,
+        bitset_foreach(
+            grp, set,
             {
                 automaton_mark_entering(aut, src, dst, 
                         0, 1, grp);
@@ -48,7 +48,7 @@ void _transfer_entering_set_to(Automaton * aut, Set * set, State * src, State *
 void _build_epsilon(Automaton * aut, State * src, State * dst, int src_grp, size_t dst_grp)
 {
     automaton_add_transition(aut, src, dst, 'e', 1);
-    Map * set;
+    BitSet * set;
     int dst_n = dst_grp;
     if(src_grp != dst_n)
     {
@@ -69,7 +69,7 @@ void concatenate(Automaton *aut, size_t left_grp, size_t right_grp, size_t curre
 {
     State *entry_to_patch = *(State **)array_get(
         aut->starting_states, aut->starting_states->size - 2);
-    Set * set;
+    BitSet * set;
     for (int i = aut->states->size - 1; i >= 0; i--)
     {
         State *end_to_patch = *(State **)array_get(aut->states, i);
@@ -153,7 +153,7 @@ void kleene(Automaton *aut)
     State *new_end = State(0);
     State *current_start = *(State **)array_get(aut->starting_states,
                                                 aut->starting_states->size - 1);
-    Set * set;
+    BitSet * set;
     automaton_add_state(aut, new_start, 0);
     automaton_add_state(aut, new_end, 0);
     for (int i = aut->states->size - 1; i >= 0; i--)
@@ -183,7 +183,7 @@ void exists(Automaton *aut)
     State *new_end = State(0);
     State *current_start = *(State **)array_get(aut->starting_states,
                                                 aut->starting_states->size - 1);
-    Set * set;
+    BitSet * set;
     automaton_add_state(aut, new_end, 0);
     automaton_add_transition(aut, new_end, current_start, 'e', 1);
     for (int i = aut->states->size - 1; i >= 0; i--)
@@ -207,7 +207,7 @@ void maybe(Automaton *aut)
     State *new_end = State(0);
     State *start = *(State **)array_get(aut->starting_states,
                                         aut->starting_states->size - 1);
-    Set * set;
+    BitSet * set;
     automaton_add_state(aut, new_start, 0);
     automaton_add_state(aut, new_end, 0);
     for (int i = aut->states->size - 1; i >= 0; i--)
@@ -100,12 +100,21 @@ void array_clear(Array *array)
     array->size = 0;
 }
 
+void array_reserve(Array *array, size_t capacity)
+{
+    if (capacity <= array->capacity)
+        return;
+    while (array->capacity < capacity)
+        array->capacity *= ARR_GROWTH_FACTOR;
+    array->data = SAFEREALLOC(array->data, array->capacity * array->data_size);
+}
+
 void array_free(Array *array)
 {
     array->size = 0;
     array->capacity = 0;
-    free(array->data);
-    free(array);
+    SAFEFREE(array->data);
+    SAFEFREE(array);
 }
 
 void array_map(Array *array, void (*function)(void *))
@@ -106,6 +106,12 @@ void array_insert(Array *array, size_t index, const void *value);
  */
 void array_clear(Array *array);
 
+/**
+ * Makes room for at least `capacity` elements, so that appending up to
+ * that many elements does not reallocate the array.
+ */
+void array_reserve(Array *array, size_t capacity);
+
 /**
  * Frees an array and all its elements, making it impossible to use.
  * @author Rostan Tabet
@@ -23,10 +23,10 @@ void bintree_free(BinTree *tree)
 {
     if (tree != NULL)
     {
-        free(tree->data);
+        SAFEFREE(tree->data);
         bintree_free(tree->left);
         bintree_free(tree->right);
-        free(tree);
+        SAFEFREE(tree);
     }
 }
 //LCOV_EXCL_START
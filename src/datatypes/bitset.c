@@ -0,0 +1,180 @@
+#include "datatypes/bitset.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "utils/memory_utils.h"
+
+static size_t word_count_for(size_t capacity)
+{
+    return (capacity + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+static void bitset_reserve(BitSet *set, size_t word_count)
+{
+    if (word_count <= set->word_count)
+        return;
+
+    if (word_count < 2 * set->word_count)
+        word_count = 2 * set->word_count;
+    set->words = SAFEREALLOC(set->words, word_count * sizeof(uint64_t));
+    memset(set->words + set->word_count, 0,
+           (word_count - set->word_count) * sizeof(uint64_t));
+    set->word_count = word_count;
+}
+
+/**
+ * The number of words up to the last non-zero one.
+ */
+static size_t used_words(const BitSet *set)
+{
+    size_t count = set->word_count;
+    while (count != 0 && set->words[count - 1] == 0)
+        count--;
+    return count;
+}
+
+BitSet *bitset_init(size_t capacity)
+{
+    BitSet *set = SAFEMALLOC(sizeof(BitSet));
+    set->word_count = word_count_for(capacity);
+    set->words = set->word_count == 0
+                     ? NULL
+                     : SAFECALLOC(set->word_count, sizeof(uint64_t));
+    set->size = 0;
+
+    return set;
+}
+
+void bitset_add(BitSet *set, size_t element)
+{
+    size_t word = element / BITSET_WORD_BITS;
+    uint64_t bit = (uint64_t)1 << (element % BITSET_WORD_BITS);
+    bitset_reserve(set, word + 1);
+    if ((set->words[word] & bit) == 0)
+    {
+        set->words[word] |= bit;
+        set->size++;
+    }
+}
+
+void bitset_remove(BitSet *set, size_t element)
+{
+    size_t word = element / BITSET_WORD_BITS;
+    uint64_t bit = (uint64_t)1 << (element % BITSET_WORD_BITS);
+    if (word < set->word_count && (set->words[word] & bit) != 0)
+    {
+        set->words[word] &= ~bit;
+        set->size--;
+    }
+}
+
+int bitset_contains(const BitSet *set, size_t element)
+{
+    size_t word = element / BITSET_WORD_BITS;
+    return word < set->word_count
+           && (set->words[word] >> (element % BITSET_WORD_BITS) & 1);
+}
+
+void bitset_clear(BitSet *set)
+{
+    if (set->size != 0)
+        memset(set->words, 0, set->word_count * sizeof(uint64_t));
+    set->size = 0;
+}
+
+void bitset_union(BitSet *dst, const BitSet *src)
+{
+    size_t count = used_words(src);
+    bitset_reserve(dst, count);
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        dst->words[i] |= src->words[i];
+        size += __builtin_popcountll(dst->words[i]);
+    }
+    for (size_t i = count; i < dst->word_count; i++)
+        size += __builtin_popcountll(dst->words[i]);
+    dst->size = size;
+}
+
+BitSet *bitset_copy(const BitSet *set)
+{
+    BitSet *copy = SAFEMALLOC(sizeof(BitSet));
+    copy->word_count = used_words(set);
+    copy->words = NULL;
+    if (copy->word_count != 0)
+    {
+        copy->words = SAFEMALLOC(copy->word_count * sizeof(uint64_t));
+        memcpy(copy->words, set->words, copy->word_count * sizeof(uint64_t));
+    }
+    copy->size = set->size;
+
+    return copy;
+}
+
+void bitset_free(BitSet *set)
+{
+    if (set == NULL)
+        return;
+    SAFEFREE(set->words);
+    SAFEFREE(set);
+}
+
+int compare_bitsets(const void *lhs, const void *rhs)
+{
+    const BitSet *set1 = *(BitSet **)lhs;
+    const BitSet *set2 = *(BitSet **)rhs;
+
+    if (set1->size != set2->size)
+        return set1->size > set2->size ? 1 : -1;
+
+    size_t count = used_words(set1);
+    if (count != used_words(set2))
+        return count > used_words(set2) ? 1 : -1;
+
+    return memcmp(set1->words, set2->words, count * sizeof(uint64_t));
+}
+
+uint64_t hash_bitset(const void *set)
+{
+    const BitSet *bitset = *(BitSet **)set;
+
+    // FNV-1a on the words, then a final mix so that the low bits used by
+    // the map depend on every word
+    uint64_t hash = 0xcbf29ce484222325;
+    size_t count = used_words(bitset);
+    for (size_t i = 0; i < count; i++)
+        hash = (hash ^ bitset->words[i]) * 0x100000001b3;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+char *stringify_bitset(const BitSet *set, char pref)
+{
+    size_t n = 0;
+    if (set != NULL)
+    {
+        bitset_foreach(element, set, {
+            n += snprintf(NULL, 0, ",%zu", element);
+        })
+    }
+
+    char *result = malloc((n == 0 ? 1 : n + 2) * sizeof(char));
+    result[0] = 0;
+    if (n != 0)
+    {
+        size_t length = 0;
+        result[length++] = pref;
+        bitset_foreach(element, set, {
+            length += sprintf(result + length, ",%zu", element);
+        })
+    }
+
+    return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BITSET_WORD_BITS 64
+
+#define BitSet(capacity) bitset_init(capacity)
+
+/**
+ * Iterate over the elements of a bitset in increasing order.
+ * The body may use goto but not break, the iteration uses two loops.
+ */
+#define bitset_foreach(var, set, body)                                         \
+    for (size_t __##var##_word = 0; __##var##_word < (set)->word_count;        \
+         __##var##_word++)                                                     \
+    {                                                                          \
+        for (uint64_t __##var##_bits = (set)->words[__##var##_word];           \
+             __##var##_bits != 0; __##var##_bits &= __##var##_bits - 1)        \
+        {                                                                      \
+            size_t var = __##var##_word * BITSET_WORD_BITS                     \
+                         + __builtin_ctzll(__##var##_bits);                    \
+            body                                                               \
+        }                                                                      \
+    }
+
+/**
+ * @struct BitSet
+ * @brief A set of small integers, one bit per possible element.
+ * State and group ids are dense, so sets of them are stored as bitsets:
+ * unions, comparisons and hashes work on whole words.
+ */
+typedef struct BitSet
+{
+    uint64_t *words;
+
+    /**
+     * The number of allocated words, the set grows when a larger element
+     * is added. Words past the largest element are zero.
+     */
+    size_t word_count;
+
+    /**
+     * The number of elements in the set.
+     */
+    size_t size;
+} BitSet;
+
+/**
+ * Initializes an empty bitset.
+ * @param capacity The number of elements that can be stored before the set
+ *        has to grow, 0 delays the allocation to the first insertion.
+ */
+BitSet *bitset_init(size_t capacity);
+
+void bitset_add(BitSet *set, size_t element);
+
+void bitset_remove(BitSet *set, size_t element);
+
+int bitset_contains(const BitSet *set, size_t element);
+
+/**
+ * Removes every element, the allocated words are kept.
+ */
+void bitset_clear(BitSet *set);
+
+/**
+ * Add the elements of the source to the destination.
+ */
+void bitset_union(BitSet *dst, const BitSet *src);
+
+BitSet *bitset_copy(const BitSet *set);
+
+void bitset_free(BitSet *set);
+
+/**
+ * Hash and comparison functions of pointers to bitsets, to use them as the
+ * keys of a Map. Two sets holding the same elements are equal whatever
+ * their allocated size.
+ */
+int compare_bitsets(const void *lhs, const void *rhs);
+uint64_t hash_bitset(const void *set);
+
+/**
+ * Turns a bitset into a heap allocated string that wants to be free,
+ * in the format of stringify_set.
+ */
+char *stringify_bitset(const BitSet *set, char pref);
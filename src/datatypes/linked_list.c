@@ -107,12 +107,12 @@ int list_free(LinkedList *list)
         return 0;
     LinkedList *start = list;
     list = list->next;
-    free(start);
+    SAFEFREE(start);
     while (list != NULL)
     {
         LinkedList *next = list->next;
-        free(list->data);
-        free(list);
+        SAFEFREE(list->data);
+        SAFEFREE(list);
         list = next;
     }
     return 1;
@@ -125,8 +125,8 @@ int list_free_from(LinkedList *list)
     while (list != NULL)
     {
         LinkedList *next = list->next;
-        free(list->data);
-        free(list);
+        SAFEFREE(list->data);
+        SAFEFREE(list);
         list = next;
     }
     return 1;
@@ -136,7 +136,7 @@ void *list_pop_value(LinkedList* list)
 {
     LinkedList *popped = list_pop(list);
     void *data = popped->data;
-    free(popped);
+    SAFEFREE(popped);
     return data;
 }
 
@@ -144,7 +144,7 @@ void *list_pop_front_value(LinkedList* list)
 {
     LinkedList *popped = list_pop_front(list);
     void *data = popped->data;
-    free(popped);
+    SAFEFREE(popped);
     return data;
 }
 
@@ -152,7 +152,7 @@ void *list_pop_at_value(LinkedList* list, ssize_t position)
 {
     LinkedList *popped = list_pop_at(list, position);
     void *data = popped->data;
-    free(popped);
+    SAFEFREE(popped);
     return data;
 }
 
@@ -12,8 +12,12 @@
 #define INT_HASH_MAGIC_NUMBER 0x45d9f3b
 
 
-static void map_grow(Map *map);
-static void _map_set(Map *map, const void *key, const void *value);
+static void map_rebuild(Map *map, size_t capacity);
+
+static size_t align_entry(size_t size)
+{
+    return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
 
 Map *map_init(size_t key_size, size_t val_size,
               uint64_t (*hash)(const void *),
@@ -24,102 +28,185 @@ Map *map_init(size_t key_size, size_t val_size,
     map->hash = hash;
     map->compare = compare;
     map->size = 0;
+    map->deleted = 0;
     map->key_size = key_size;
     map->val_size = val_size;
     map->load_factor = MAP_LOAD_FACTOR;
     map->growth_factor = MAP_GROWTH_FACTOR;
-    map->buckets = Array(LinkedList *);
-    for (size_t i = 0; i < MAP_INITIAL_CAP; i++)
-    {
-        LinkedList *list = LinkedList(MapNode *);
-        array_append(map->buckets, &list);
-    }
+    map->value_offset = MAP_KEY_OFFSET + align_entry(key_size);
+    map->entry_size = align_entry(map->value_offset + val_size);
+    map->capacity = MAP_INITIAL_CAP;
+    map->slots = SAFECALLOC(map->capacity, sizeof(uint32_t));
+    map->entries_capacity = 0;
+    map->entries = NULL;
 
     return map;
 }
 
 void map_clear(Map *map)
 {
-    arr_foreach(LinkedList *, bucket, map->buckets)
+    if (map->size + map->deleted != 0)
+        memset(map->slots, 0, map->capacity * sizeof(uint32_t));
+    map->size = 0;
+    map->deleted = 0;
+}
+
+Map *map_copy(const Map *map)
+{
+    Map *copy = SAFEMALLOC(sizeof(Map));
+    memcpy(copy, map, sizeof(Map));
+    copy->slots = SAFEMALLOC(map->capacity * sizeof(uint32_t));
+    memcpy(copy->slots, map->slots, map->capacity * sizeof(uint32_t));
+    copy->entries_capacity = map->size;
+    copy->entries = NULL;
+    if (map->size != 0)
     {
-        list_foreach(MapNode *, node, bucket)
-        {
-            free(node->key);
-            free(node->value);
-            free(node);
-        }
-        bucket->next = NULL;
+        copy->entries = SAFEMALLOC(map->size * map->entry_size);
+        memcpy(copy->entries, map->entries, map->size * map->entry_size);
     }
+
+    return copy;
 }
 
 void map_free(Map *map)
 {
-    arr_foreach(LinkedList *, bucket, map->buckets)
+    SAFEFREE(map->slots);
+    SAFEFREE(map->entries);
+    SAFEFREE(map);
+}
+
+/**
+ * Find the slot of a key.
+ * @return The slot pointing to the entry of the key, or the slot where it
+ * would be inserted: the first deleted slot met or the empty slot ending
+ * the probe.
+ */
+static size_t map_find(const Map *map, const void *key, uint64_t hash,
+                       int *found)
+{
+    size_t mask = map->capacity - 1;
+    size_t free_slot = SIZE_MAX;
+    *found = 0;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
     {
-        list_foreach(MapNode *, node, bucket)
+        uint32_t slot = map->slots[i];
+        if (slot == MAP_SLOT_EMPTY)
+            return free_slot == SIZE_MAX ? i : free_slot;
+        if (slot == MAP_SLOT_DELETED)
         {
-            free(node->key);
-            free(node->value);
-            free(node);
+            if (free_slot == SIZE_MAX)
+                free_slot = i;
+            continue;
+        }
+
+        const unsigned char *entry =
+            map->entries + (slot - 1) * map->entry_size;
+        if (*(const uint64_t *)entry == hash
+            && map->compare(entry + MAP_KEY_OFFSET, key) == 0)
+        {
+            *found = 1;
+            return i;
         }
-        list_free(bucket);
     }
-    array_free(map->buckets);
-    free(map);
 }
 
 void *map_get(const Map *map, const void *key)
 {
-    size_t index = map->hash(key) % map->buckets->size;
-    LinkedList *bucket = *(LinkedList **) array_get(map->buckets, index);
+    if (map->size == 0)
+        return NULL;
+
+    int found;
+    size_t i = map_find(map, key, map->hash(key), &found);
+    if (!found)
+        return NULL;
+
+    return map_entry_value(map, map->slots[i] - 1);
+}
 
-    list_foreach(MapNode *, node, bucket)
+int map_delete(Map *map, const void *key, void *value)
+{
+    if (map->size == 0)
+        return 0;
+
+    int found;
+    size_t i = map_find(map, key, map->hash(key), &found);
+    if (!found)
+        return 0;
+
+    size_t entry = map->slots[i] - 1;
+    if (value != NULL)
+        memcpy(value, map_entry_value(map, entry), map->val_size);
+    map->slots[i] = MAP_SLOT_DELETED;
+    map->deleted++;
+    map->size--;
+
+    // Move the last entry to keep the entries contiguous
+    if (entry != map->size)
     {
-        if (map->compare(node->key, key) == 0)
-            return node->value;
+        unsigned char *last = map->entries + map->size * map->entry_size;
+        size_t j = map_find(map, last + MAP_KEY_OFFSET, *(uint64_t *)last,
+                            &found);
+        map->slots[j] = entry + 1;
+        memcpy(map->entries + entry * map->entry_size, last, map->entry_size);
     }
 
-    return NULL;
+    return 1;
 }
 
-void * map_delete(Map * map, const void * key)
+/**
+ * Set the value of a key whose hash is already known.
+ */
+static void map_set_hashed(Map *map, const void *key, uint64_t hash,
+                           const void *value)
 {
-    size_t index = map->hash(key) % map->buckets->size;
-    LinkedList *bucket = *(LinkedList **) array_get(map->buckets, index);
-    size_t list_index = 0;
-    void *cpy;
-    list_foreach(MapNode *, node, bucket)
+    int found;
+    size_t i = map_find(map, key, hash, &found);
+    if (found)
     {
-        if (map->compare(node->key, key) == 0)
-        {
-            cpy = node->value;
-            free(node->key);
-            list_free_from(list_pop_at(bucket, list_index));
-            free(node);
-            map->size--;
-            return cpy;
-        }
-        list_index++;
+        if (map->val_size != 0)
+            memcpy(map_entry_value(map, map->slots[i] - 1), value,
+                   map->val_size);
+        return;
+    }
+
+    if (map->size == map->entries_capacity)
+    {
+        map->entries_capacity =
+            map->entries_capacity == 0 ? 4 : 2 * map->entries_capacity;
+        map->entries = SAFEREALLOC(map->entries,
+                                   map->entries_capacity * map->entry_size);
     }
 
-    return NULL;
+    unsigned char *entry = map->entries + map->size * map->entry_size;
+    *(uint64_t *)entry = hash;
+    memcpy(entry + MAP_KEY_OFFSET, key, map->key_size);
+    if (map->val_size != 0)
+        memcpy(entry + map->value_offset, value, map->val_size);
+
+    if (map->slots[i] == MAP_SLOT_DELETED)
+        map->deleted--;
+    map->slots[i] = ++map->size;
 }
 
 void map_set(Map *map, const void *key, const void *value)
 {
-    _map_set(map, key, value);
+    map_set_hashed(map, key, map->hash(key), value);
 
-    if ((float)map->size / map->buckets->size > map->load_factor)
-        map_grow(map);
+    if ((float)(map->size + map->deleted) / map->capacity > map->load_factor)
+    {
+        // Only drop the deleted slots if they are the reason of the load
+        if ((float)map->size / map->capacity > map->load_factor)
+            map_rebuild(map, map->capacity * map->growth_factor);
+        else
+            map_rebuild(map, map->capacity);
+    }
 }
 
 void map_union(Map *dst, const Map *src)
 {
-    arr_foreach(LinkedList *, bucket, src->buckets)
-    {
-        list_foreach(MapNode *, node, bucket)
-            map_set(dst, node->key, node->value);
-    }
+    for (size_t i = 0; i < src->size; i++)
+        map_set(dst, map_entry_key(src, i), map_entry_value(src, i));
 }
 
 
@@ -218,94 +305,44 @@ int compare_sets(const void *lhs, const void *rhs)
     if (map1->size != map2->size)
         return (int)((long)map1->size - (long)map2->size);
 
-    arr_foreach(LinkedList *, bucket, map1->buckets)
-    {
-        list_foreach(MapNode *, node, bucket)
-            if (!map_get(map2, node->key))
-                return 1;
-    }
+    for (size_t i = 0; i < map1->size; i++)
+        if (!map_get(map2, map_entry_key(map1, i)))
+            return 1;
 
     return 0;
 }
 
 uint64_t hash_set(const void *set)
 {
+    // The hashes of the keys are summed so that equal sets have the same
+    // hash whatever the order in which their elements were added
     uint64_t hash = 0;
 
     const Map *map = *(Map **)set;
-    arr_foreach(LinkedList *, bucket, map->buckets)
-    {
-        list_foreach(MapNode *, node, bucket)
-            hash = ((hash << 5) + hash) + map->hash(node->key);
-    }
+    for (size_t i = 0; i < map->size; i++)
+        hash += *(uint64_t *)(map->entries + i * map->entry_size);
 
-    return hash;
+    return hash_number(hash);
 }
 
 // Local functions
 
-static void map_grow(Map *map)
-{
-    // Move the old buckets
-    Array *buckets = Array(LinkedList *);
-    for (size_t i = 0; i < map->buckets->size; i++)
-    {
-        LinkedList *bucket = LinkedList(MapNode *);
-        LinkedList *old_bucket = *(LinkedList **)array_get(map->buckets, i);
-        bucket->next = old_bucket->next;
-        old_bucket->next = NULL;
-        if (bucket->next != NULL)
-            bucket->next->previous = bucket;
-
-        array_append(buckets, &bucket);
-    }
-
-    // Expand the array
-    size_t new_size = map->buckets->size * map->growth_factor;
-    for (size_t i = map->buckets->size; i < new_size; i++)
-    {
-        LinkedList *bucket = LinkedList(MapNode *);
-        array_append(map->buckets, &bucket);
-    }
-
-    // Re-hash and free the new bucket array
-    map->size = 0;
-    arr_foreach(LinkedList *, bucket, buckets)
-    {
-        list_foreach(MapNode *, node, bucket)
-        {
-            _map_set(map, node->key, node->value);
-            free(node->key);
-            free(node->value);
-            free(node);
-        }
-        list_free(bucket);
-    }
-    array_free(buckets);
-}
-
-static void _map_set(Map *map, const void *key, const void *value)
+static void map_rebuild(Map *map, size_t capacity)
 {
-    size_t index = map->hash(key) % map->buckets->size;
-    LinkedList *bucket = *(LinkedList **) array_get(map->buckets, index);
+    map->capacity = capacity;
+    map->slots = SAFEREALLOC(map->slots, capacity * sizeof(uint32_t));
+    memset(map->slots, 0, capacity * sizeof(uint32_t));
+    map->deleted = 0;
 
-    list_foreach(MapNode *, node, bucket)
+    size_t mask = capacity - 1;
+    for (size_t entry = 0; entry < map->size; entry++)
     {
-        if (map->compare(node->key, key) == 0)
-        {
-            memcpy(node->value, value, map->val_size);
-            return;
-        }
+        uint64_t hash = *(uint64_t *)(map->entries + entry * map->entry_size);
+        size_t i = hash & mask;
+        while (map->slots[i] != MAP_SLOT_EMPTY)
+            i = (i + 1) & mask;
+        map->slots[i] = entry + 1;
     }
-
-    MapNode *new_node = SAFEMALLOC(sizeof(MapNode));
-    new_node->key = SAFEMALLOC(map->key_size);
-    new_node->value = SAFEMALLOC(map->val_size);
-    memcpy(new_node->key, key, map->key_size);
-    memcpy(new_node->value, value, map->val_size);
-    list_push_front(bucket, &new_node);
-
-    map->size++;
 }
 
 uint64_t hash_transition(const void *key)
@@ -11,59 +11,91 @@
 #define MAP_LOAD_FACTOR 0.75
 
 #define Map(K, V, hash, compare) map_init(sizeof(K), sizeof(V), hash, compare)
+
+/**
+ * The entries are stored contiguously, iterating over a map only visits its
+ * elements whatever its capacity. The body may use break or goto.
+ */
 #define map_foreach_key(T, var, set, body)                                     \
-    T var; \
-    arr_foreach(LinkedList *, __##set##_bucket, (set)->buckets)                \
+    T var;                                                                     \
+    for (size_t __##set##_entry = 0; __##set##_entry < (set)->size;            \
+         __##set##_entry++)                                                    \
     {                                                                          \
-        list_foreach(MapNode *, __##set##_node, __##set##_bucket)                \
-        {                                                                      \
-            var = *(T *)__##set##_node->key;                                  \
-            body                                                               \
-        }                                                                      \
+        var = *(T *)map_entry_key(set, __##set##_entry);                       \
+        body                                                                   \
     }
 
-#define map_foreach_value(VT, var, map, body)                                     \
-    VT var; \
-    arr_foreach(LinkedList *, __##map##_bucket, (map)->buckets)                \
+#define map_foreach_value(VT, var, map, body)                                  \
+    VT var;                                                                    \
+    for (size_t __##map##_entry = 0; __##map##_entry < (map)->size;            \
+         __##map##_entry++)                                                    \
     {                                                                          \
-        list_foreach(MapNode *, __##map##_node, __##map##_bucket)                \
-        {                                                                      \
-            var = *(VT *)__##map##_node->value;                                  \
-            body                                                               \
-        }                                                                      \
+        var = *(VT *)map_entry_value(map, __##map##_entry);                    \
+        body                                                                   \
     }
 
+#define map_entry_key(map, i)                                                  \
+    ((void *)((map)->entries + (i) * (map)->entry_size + MAP_KEY_OFFSET))
+#define map_entry_value(map, i)                                                \
+    ((void *)((map)->entries + (i) * (map)->entry_size + (map)->value_offset))
+
 /**
- * @struct MapNode
- * @brief A simple key-value pair used in a hash map
+ * Every entry starts with the hash of its key, the key follows.
  */
-typedef struct MapNode
-{
-    void *key;
-    void *value;
-} MapNode;
+#define MAP_KEY_OFFSET sizeof(uint64_t)
+
+/**
+ * Values of the index: an empty slot, a slot whose entry was deleted, any
+ * other value is the position of an entry plus one.
+ */
+#define MAP_SLOT_EMPTY 0
+#define MAP_SLOT_DELETED UINT32_MAX
 
 /**
  * @struct Map
  * @brief Implementation of a generic hash map
+ * The map is an open-addressing index of 32 bits slots probed linearly,
+ * pointing into a dense array of entries. Keys and values are stored inline
+ * in the entries, inserting does not allocate unless the map has to grow.
  * @author Rostan Tabet
  * @date 26/04/2021
  */
 typedef struct Map
 {
     /**
-     * Each bucket is a linked list of nodes.
-     * The array contains pointers to linked lists,
-     * the linked lists contain nodes.
-     * The capacity of the hash map is the size of the bucket array.
+     * The index, its size is the capacity of the map and is a power of two.
      */
-    Array *buckets;
+    uint32_t *slots;
+
+    size_t capacity;
+
+    /**
+     * The entries in insertion order, an entry being moved to fill the hole
+     * left by a deleted one.
+     * Each entry is the hash of the key, the key and the value.
+     */
+    unsigned char *entries;
+
+    /**
+     * The number of entries that can be stored before reallocating them.
+     */
+    size_t entries_capacity;
+
+    size_t entry_size;
+
+    size_t value_offset;
 
     /**
      * The number of elements in the hash map
      */
     size_t size;
 
+    /**
+     * The number of deleted slots, they are reused by insertions and
+     * dropped when the index is rebuilt.
+     */
+    size_t deleted;
+
     /**
      * The function used to hash the keys.
      * This function takes a pointer to the key as a parameter.
@@ -108,7 +140,7 @@ Map *map_init(size_t key_size, size_t val_size,
               int (*compare)(const void *, const void *));
 
 /**
- * Clears and frees all the buckets.
+ * Removes every element, the capacity of the map is kept.
  * @param map The map to clear.
  */
 void map_clear(Map *map);
@@ -116,6 +148,7 @@ void map_clear(Map *map);
 
 /**
  * Returns a pointer to the element associated to the key in the hash map.
+ * The pointer is valid until the map is modified.
  * @param map The map in which to look for the element.
  * @param key A pointer to the key.
  * @return If the key is present in the map, a pointer to the associated value,
@@ -124,16 +157,14 @@ void map_clear(Map *map);
 void *map_get(const Map *map, const void *key);
 
 /**
- * Returns a pointer to the element associated to the key in the hash map.
- * This element will be deleted from the hashmap, however the user
- * has to free the returned pointer because it is allocated by map_set.
+ * Deletes the element associated to the key in the hash map.
  * @param map The map in which to look for the element.
  * @param key A pointer to the key.
- * @return If the key is present in the map, a pointer to the associated value,
- *         else NULL.
+ * @param value If not NULL and the key is present, the associated value is
+ *        copied there.
+ * @return 1 if the key was present in the map, else 0.
  */
-
-void * map_delete(Map * map, const void * key);
+int map_delete(Map *map, const void *key, void *value);
 
 /**
  * Associate a value to a key in a hash map.
@@ -154,6 +185,12 @@ void map_set(Map *map, const void *key, const void *value);
  */
 void map_union(Map *dst, const Map *src);
 
+/**
+ * Copy a map with its index and entries as they are, without hashing the
+ * keys again. Keys and values are copied bit for bit.
+ */
+Map *map_copy(const Map *map);
+
 void map_free(Map *map);
 
 // Hash and comparison functions
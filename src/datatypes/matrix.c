@@ -22,8 +22,8 @@ void matrix_free(Matrix *mat)
         size_t len = mat->height * mat->width;
         for (size_t i = 0; i < len; i++)
             list_free(mat->mat[i]);
-        free(mat->mat);
-        free(mat);
+        SAFEFREE(mat->mat);
+        SAFEFREE(mat);
     }
 }
 
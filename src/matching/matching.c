@@ -2,7 +2,9 @@
 
 #include <printf.h>
 #include <string.h>
+#include <time.h>
 
+#include "automaton/jit.h"
 #include "utils/memory_utils.h"
 /*
  * Recursive function that has been replaced by an iterative one (see below)
@@ -89,55 +91,440 @@ static int match_nfa_from_state(const Automaton *automaton, const char *string,
 }
  */
 
-static char *submatch_nfa_from_state(const Automaton *, const char *, State *);
+/**
+ * @struct GroupMark
+ * A group entered or left while reading a match, see search_table.
+ */
+typedef struct GroupMark
+{
+    /**
+     * Offset from the start of the match.
+     */
+    size_t position;
+    uint32_t group;
+    int leaving;
+} GroupMark;
 
-Match *match_nfa(const Automaton *automaton, const char *string)
+/**
+ * @struct BacktrackJob
+ * An instruction of the backtracker to run at a position of the string, or
+ * a slot to restore once the instructions after it were all tried.
+ */
+typedef struct BacktrackJob
+{
+    /**
+     * The instruction, or BACKTRACK_RESTORE.
+     */
+    uint32_t inst;
+    /**
+     * The slot restored by a BACKTRACK_RESTORE job.
+     */
+    uint32_t slot;
+    /**
+     * Offset of the instruction in the string, or the value of the slot
+     * restored.
+     */
+    size_t position;
+} BacktrackJob;
+
+/**
+ * The instruction of the jobs restoring a slot.
+ */
+#define BACKTRACK_RESTORE UINT32_MAX
+
+/**
+ * Make room for the states of an automaton in the state sets of a scratch.
+ */
+static void reserve_states(MatchScratch *scratch, size_t size)
+{
+    if (size <= scratch->nfa_capacity)
+        return;
+
+    scratch->current = SAFEREALLOC(scratch->current, size * sizeof(size_t));
+    scratch->next = SAFEREALLOC(scratch->next, size * sizeof(size_t));
+    scratch->seen = SAFEREALLOC(scratch->seen, size * sizeof(size_t));
+    memset(scratch->seen, 0, size * sizeof(size_t));
+    scratch->generation = 0;
+    scratch->nfa_capacity = size;
+}
+
+/**
+ * Add a state to the set being built, unless it is already in it.
+ * @return The new size of the set.
+ */
+static size_t add_state(MatchScratch *scratch, size_t *set, size_t count,
+                        size_t state)
+{
+    if (scratch->seen[state] == scratch->generation)
+        return count;
+    scratch->seen[state] = scratch->generation;
+    set[count++] = state;
+    return count;
+}
+
+/**
+ * Add a state and the states it reaches with epsilon transitions to the
+ * set being built, unless they are already in it.
+ * @return The new size of the set.
+ */
+static size_t add_closure(const Automaton *automaton, MatchScratch *scratch,
+                          size_t *set, size_t count, size_t state)
+{
+    size_t first = count;
+    count = add_state(scratch, set, count, state);
+
+    // The end of the set is the work list of the closure
+    for (size_t i = first; i < count; i++)
+    {
+        LinkedList *targets = get_matrix_elt(automaton, set[i], 0, 1);
+        for (LinkedList *l = targets == NULL ? NULL : targets->next; l != NULL;
+             l = l->next)
+            count = add_state(scratch, set, count, (*(State **)l->data)->id);
+    }
+
+    return count;
+}
+
+/**
+ * Test whether a NFA matches a prefix of a string.
+ * The sets of states reached after each letter are computed in the scratch,
+ * every state being in a set at most once.
+ * @param automaton Some NFA
+ * @param string The string to test
+ * @param scratch The scratch holding the sets of states
+ * @return The end of the longest match if there is a match, else NULL.
+ */
+static const char *submatch_nfa(const Automaton *automaton,
+                                const char *string, MatchScratch *scratch)
 {
+    reserve_states(scratch, automaton->size);
+    scratch->generation++;
+    size_t count = 0;
     arr_foreach(State *, start, automaton->starting_states)
+        count = add_closure(automaton, scratch, scratch->current, count,
+                            start->id);
+
+    const char *end = NULL;
+    while (count != 0)
     {
-        char *end = submatch_nfa_from_state(automaton, string, start);
-        if (end != NULL)
+        for (size_t i = 0; i < count; i++)
         {
-            Match *match = SAFEMALLOC(sizeof(Match));
-            match->string = string;
-            match->start = 0;
-            match->length = end - string;
+            State *state =
+                *(State **)array_get(automaton->states, scratch->current[i]);
+            if (state->terminal)
+            {
+                end = string;
+                break;
+            }
+        }
+        if (*string == 0)
+            break;
 
-            // TODO: Fix when groups are supported
-            match->nb_groups = 0;
-            match->groups = NULL;
+        scratch->generation++;
+        size_t next_count = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            LinkedList *targets =
+                get_matrix_elt(automaton, scratch->current[i], *string, 0);
+            for (LinkedList *l = targets == NULL ? NULL : targets->next;
+                 l != NULL; l = l->next)
+                next_count = add_closure(automaton, scratch, scratch->next,
+                                         next_count,
+                                         (*(State **)l->data)->id);
+        }
 
-            return match;
+        size_t *swap = scratch->current;
+        scratch->current = scratch->next;
+        scratch->next = swap;
+        count = next_count;
+        string++;
+    }
+
+    return end;
+}
+
+/**
+ * Same as submatch_nfa, on the flat copy of a NFA without epsilon
+ * transitions.
+ */
+static const char *submatch_flat(const FlatNfa *nfa, const char *string,
+                                 MatchScratch *scratch)
+{
+    reserve_states(scratch, nfa->size);
+    scratch->generation++;
+    size_t count = 0;
+    for (size_t i = 0; i < nfa->start_count; i++)
+        count = add_state(scratch, scratch->current, count, nfa->starts[i]);
+
+    const char *end = NULL;
+    while (count != 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (nfa->states[scratch->current[i]].terminal)
+            {
+                end = string;
+                break;
+            }
         }
+        if (*string == 0)
+            break;
+
+        // The transitions are sorted by letter
+        scratch->generation++;
+        size_t next_count = 0;
+        Letter letter = *string;
+        for (size_t i = 0; i < count; i++)
+        {
+            const FlatState *src = nfa->states + scratch->current[i];
+            const FlatEdge *edge = nfa->edges + src->offset;
+            const FlatEdge *last = edge + src->count;
+            while (edge < last && edge->letter < letter)
+                edge++;
+            for (; edge < last && edge->letter == letter; edge++)
+                next_count = add_state(scratch, scratch->next, next_count,
+                                       edge->target);
+        }
+
+        size_t *swap = scratch->current;
+        scratch->current = scratch->next;
+        scratch->next = swap;
+        count = next_count;
+        string++;
     }
-    return NULL;
+
+    return end;
 }
 
-Array *search_nfa(const Automaton *automaton, const char *string)
+/**
+ * Run either form of a NFA, see submatch_nfa.
+ * @param automaton The NFA, or NULL when its flat copy is given.
+ * @param flat The flat copy of the NFA, or NULL.
+ */
+static const char *submatch_either(const Automaton *automaton,
+                                   const FlatNfa *flat,
+                                   const char *string, MatchScratch *scratch)
+{
+    if (flat != NULL)
+        return submatch_flat(flat, string, scratch);
+    return submatch_nfa(automaton, string, scratch);
+}
+
+MatchScratch *match_scratch_create(size_t nfa_size, size_t nb_groups,
+                                   size_t capacity)
+{
+    MatchScratch *scratch = SAFEMALLOC(sizeof(MatchScratch));
+    scratch->marks = Array(GroupMark);
+    scratch->open = Array(size_t);
+    array_reserve(scratch->open, nb_groups);
+    scratch->matches = Array(Match);
+    array_reserve(scratch->matches, capacity);
+    scratch->bounds = Array(size_t);
+    array_reserve(scratch->bounds, 2 * nb_groups * capacity);
+    scratch->groups = Array(char *);
+    array_reserve(scratch->groups, nb_groups * capacity);
+    scratch->text = Array(char);
+
+    scratch->current = NULL;
+    scratch->next = NULL;
+    scratch->seen = NULL;
+    scratch->nfa_capacity = 0;
+    scratch->generation = 0;
+    reserve_states(scratch, nfa_size);
+    scratch->visited = NULL;
+    scratch->visited_capacity = 0;
+    scratch->jobs = Array(BacktrackJob);
+    scratch->slots = Array(size_t);
+    scratch->best_slots = Array(size_t);
+    scratch->thread_slots = Array(size_t);
+    memset(&scratch->captured, 0, sizeof(Match));
+    scratch->replacements = 0;
+    scratch->timed = 0;
+    scratch->capture_seconds = 0;
+
+    return scratch;
+}
+
+void match_scratch_free(MatchScratch *scratch)
+{
+    if (scratch == NULL)
+        return;
+    array_free(scratch->marks);
+    array_free(scratch->open);
+    array_free(scratch->matches);
+    array_free(scratch->bounds);
+    array_free(scratch->groups);
+    array_free(scratch->text);
+    free(scratch->current);
+    free(scratch->next);
+    free(scratch->seen);
+    free(scratch->visited);
+    array_free(scratch->jobs);
+    array_free(scratch->slots);
+    array_free(scratch->best_slots);
+    array_free(scratch->thread_slots);
+    free(scratch);
+}
+
+Match *match_copy(const Match *match)
+{
+    Match *copy = SAFEMALLOC(sizeof(Match));
+    *copy = *match;
+    if (match->groups == NULL)
+        return copy;
+
+    copy->groups = SAFECALLOC(match->nb_groups, sizeof(char *));
+    for (size_t i = 0; i < match->nb_groups; i++)
+    {
+        if (match->groups[i] == NULL)
+            continue;
+        copy->groups[i] =
+            SAFEMALLOC((strlen(match->groups[i]) + 1) * sizeof(char));
+        strcpy(copy->groups[i], match->groups[i]);
+    }
+
+    return copy;
+}
+
+/**
+ * Copy the matches of a scratch in an array of matches allocated in the
+ * heap.
+ */
+static Array *copy_matches(const MatchScratch *scratch)
 {
     Array *matches = Array(Match *);
+    array_reserve(matches, scratch->matches->size);
+    for (size_t i = 0; i < scratch->matches->size; i++)
+    {
+        Match *match = match_copy((Match *)scratch->matches->data + i);
+        array_append(matches, &match);
+    }
+
+    return matches;
+}
+
+/**
+ * Copy the text of a scratch in the heap.
+ */
+static char *copy_text(const MatchScratch *scratch)
+{
+    char *copy = SAFEMALLOC(scratch->text->size * sizeof(char));
+    return memcpy(copy, scratch->text->data, scratch->text->size);
+}
+
+/**
+ * Append characters to the text of a scratch.
+ */
+static void append_text(Array *text, const char *string, size_t size)
+{
+    array_reserve(text, text->size + size);
+    memcpy((char *)text->data + text->size, string, size);
+    text->size += size;
+}
+
+/**
+ * Append a match without groups to the matches of a scratch.
+ */
+static void add_match(MatchScratch *scratch, const char *string,
+                      const char *start, const char *end)
+{
+    Match match = {
+        .string = string,
+        .start = start - string,
+        .length = end - start,
+        .nb_groups = 0,
+        .groups = NULL,
+    };
+    array_append(scratch->matches, &match);
+}
+
+static const Match *match_either_scratch(const Automaton *automaton,
+                                         const FlatNfa *flat,
+                                         const char *string,
+                                         MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
+    const char *end = submatch_either(automaton, flat, string, scratch);
+    if (end == NULL)
+        return NULL;
+
+    // TODO: Fix when groups are supported
+    add_match(scratch, string, string, end);
+    return scratch->matches->data;
+}
+
+const Match *match_nfa_scratch(const Automaton *automaton, const char *string,
+                               MatchScratch *scratch)
+{
+    return match_either_scratch(automaton, NULL, string, scratch);
+}
+
+const Match *match_flat_scratch(const FlatNfa *nfa, const char *string,
+                                MatchScratch *scratch)
+{
+    return match_either_scratch(NULL, nfa, string, scratch);
+}
+
+Match *match_nfa(const Automaton *automaton, const char *string)
+{
+    MatchScratch *scratch = match_scratch_create(automaton->size, 0, 1);
+    const Match *match = match_nfa_scratch(automaton, string, scratch);
+    Match *copy = match == NULL ? NULL : match_copy(match);
+    match_scratch_free(scratch);
+
+    return copy;
+}
+
+Match *match_flat(const FlatNfa *nfa, const char *string)
+{
+    MatchScratch *scratch = match_scratch_create(nfa->size, 0, 1);
+    const Match *match = match_flat_scratch(nfa, string, scratch);
+    Match *copy = match == NULL ? NULL : match_copy(match);
+    match_scratch_free(scratch);
+
+    return copy;
+}
+
+static size_t search_either_scratch(const Automaton *automaton,
+                                    const FlatNfa *flat,
+                                    const char *string, MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
     const char *string_start = string;
     for (; *string != 0; string++)
     {
-        arr_foreach(State *, start, automaton->starting_states)
+        // Empty matches are skipped, as with the DFA
+        const char *end = submatch_either(automaton, flat, string, scratch);
+        if (end != NULL && end != string)
         {
-            char *end = submatch_nfa_from_state(automaton, string, start);
-            if (end != NULL)
-            {
-                Match *match = SAFEMALLOC(sizeof(Match));
-                match->string = string_start;
-                match->start = string - string_start;
-                match->length = end - string;
-                // TODO: Fix when groups are supported
-                match->nb_groups = 0;
-                match->groups = NULL;
-                array_append(matches, &match);
-                string = end - 1;
-                break;
-            }
+            // TODO: Fix when groups are supported
+            add_match(scratch, string_start, string, end);
+            string = end - 1;
         }
     }
 
+    return scratch->matches->size;
+}
+
+size_t search_nfa_scratch(const Automaton *automaton, const char *string,
+                          MatchScratch *scratch)
+{
+    return search_either_scratch(automaton, NULL, string, scratch);
+}
+
+size_t search_flat_scratch(const FlatNfa *nfa, const char *string,
+                           MatchScratch *scratch)
+{
+    return search_either_scratch(NULL, nfa, string, scratch);
+}
+
+Array *search_nfa(const Automaton *automaton, const char *string)
+{
+    MatchScratch *scratch = match_scratch_create(automaton->size, 0, 0);
+    search_nfa_scratch(automaton, string, scratch);
+    Array *matches = copy_matches(scratch);
+    match_scratch_free(scratch);
+
     return matches;
 }
 
@@ -237,30 +624,30 @@ Array *search_dfa(const Automaton *automaton, const char *string)
         State *prev_curr = curr;
         curr = *(State **)tr->next->data;
         // Adding elements to the queue
-        Set *leaving = get_leaving_group((Automaton *)automaton,
-                                         prev_curr, curr, *(string - 1), 0);
+        BitSet *leaving = get_leaving_group(automaton,
+                                            prev_curr, curr, *(string - 1), 0);
         if (leaving != NULL)
         {
-            map_foreach_key(size_t, group, leaving, {
+            bitset_foreach(group, leaving, {
                 int mark = -(2 * group + 1);
                 list_push_back(queue, &mark);
             })
         }
-        leaving = get_leaving_group((Automaton *)automaton,
+        leaving = get_leaving_group(automaton,
                                     prev_curr, NULL, *(string - 1), 0);
 
         if (leaving != NULL)
         {
-            map_foreach_key(size_t, group, leaving, {
+            bitset_foreach(group, leaving, {
                 int mark = -(2 * group + 1);
                 list_push_back(queue, &mark);
             })
         }
-        Set *entering = get_entering_groups((Automaton *)automaton, NULL,
-                                            prev_curr, *(string - 1), 0);
+        BitSet *entering = get_entering_groups(automaton, NULL,
+                                               prev_curr, *(string - 1), 0);
         if (entering != NULL)
         {
-            map_foreach_key(size_t, group, entering, {
+            bitset_foreach(group, entering, {
                 int mark = -2 * group;
                 list_push_back(queue, &mark);
             })
@@ -270,11 +657,11 @@ Array *search_dfa(const Automaton *automaton, const char *string)
             int mark = (unsigned char)*(string - 1);
             list_push_back(queue, &mark);
         }
-        entering = get_entering_groups((Automaton *)automaton,
+        entering = get_entering_groups(automaton,
                                             prev_curr, curr, *(string - 1), 0);
         if (entering != NULL)
         {
-            map_foreach_key(size_t, group, entering, {
+            bitset_foreach(group, entering, {
                 int mark = -2 * group;
                 list_push_back(queue, &mark);
             })
@@ -344,10 +731,10 @@ Array *search_dfa(const Automaton *automaton, const char *string)
 
         if (curr->terminal)
         {
-            Set *groups = get_leaving_group((Automaton *)automaton, curr, NULL, 0, 0);
+            BitSet *groups = get_leaving_group(automaton, curr, NULL, 0, 0);
             if (groups != NULL)
             {
-                map_foreach_key(size_t, group, groups, {
+                bitset_foreach(group, groups, {
                     int mark = -(2 * group + 1);
                     list_push_back(queue, &mark);
                 })
@@ -414,132 +801,941 @@ Array *search_dfa(const Automaton *automaton, const char *string)
     return matches;
 }
 
+static const char *replace_either_scratch(const Automaton *automaton,
+                                          const FlatNfa *flat,
+                                          const char *string,
+                                          const char *replace,
+                                          MatchScratch *scratch)
+{
+    Array *result = scratch->text;
+    array_clear(result);
+    scratch->replacements = 0;
+    size_t repl_size = strlen(replace);
+    while (*string != 0)
+    {
+        const char *end = submatch_either(automaton, flat, string, scratch);
+        if (end == NULL || end == string)
+        {
+            array_append(result, string++);
+            continue;
+        }
+        for (size_t i = 0; i < repl_size; i++)
+            array_append(result, replace + i);
+        scratch->replacements++;
+        string = end;
+    }
+
+    char end_char = 0;
+    array_append(result, &end_char);
+
+    return result->data;
+}
+
+const char *replace_nfa_scratch(const Automaton *automaton, const char *string,
+                                const char *replace, MatchScratch *scratch)
+{
+    return replace_either_scratch(automaton, NULL, string, replace, scratch);
+}
+
+const char *replace_flat_scratch(const FlatNfa *nfa, const char *string,
+                                 const char *replace, MatchScratch *scratch)
+{
+    return replace_either_scratch(NULL, nfa, string, replace, scratch);
+}
+
 char *replace_nfa(const Automaton *automaton, const char *string,
                   const char *replace)
 {
-    typedef struct
+    MatchScratch *scratch = match_scratch_create(automaton->size, 0, 0);
+    replace_nfa_scratch(automaton, string, replace, scratch);
+    char *result = copy_text(scratch);
+    match_scratch_free(scratch);
+
+    return result;
+}
+
+/**
+ * Run a DFA table from the start of a string, with its native code if it
+ * was compiled.
+ * @return The end of the longest match, or NULL if there is none.
+ */
+static const char *table_longest_match(const DfaTable *table,
+                                        const char *string)
+{
+    if (table->jit != NULL)
+    {
+        long length = table->jit->run((const unsigned char *)string);
+        return length < 0 ? NULL : string + length;
+    }
+    if (table->start == DFA_NO_STATE)
+        return NULL;
+
+    int32_t state = table->start;
+    const char *end = table->terminal[state] ? string : NULL;
+    for (; *string != 0; string++)
     {
-        size_t start;
-        size_t end;
-    } match_bounds;
-    Array *matches = Array(match_bounds);
+        state = table->transitions[state * DFA_TABLE_ALPHABET
+                                   + (unsigned char)*string];
+        if (state == DFA_NO_STATE)
+            break;
+        if (table->terminal[state])
+            end = string + 1;
+    }
+
+    return end;
+}
+
+const Match *match_table_scratch(const DfaTable *table, const char *string,
+                                 MatchScratch *scratch)
+{
+    const char *end = table_longest_match(table, string);
+    if (end == NULL)
+        return NULL;
+
+    array_clear(scratch->matches);
+    add_match(scratch, string, string, end);
+
+    return scratch->matches->data;
+}
+
+Match *match_table(const DfaTable *table, const char *string)
+{
+    const char *end = table_longest_match(table, string);
+    if (end == NULL)
+        return NULL;
+
+    Match *match = SAFEMALLOC(sizeof(Match));
+    match->string = string;
+    match->start = 0;
+    match->length = end - string;
+    match->nb_groups = 0;
+    match->groups = NULL;
+
+    return match;
+}
+
+/**
+ * Push the group markers of a tag in the markers of a scratch.
+ * @param position The offset of the marker from the start of the match.
+ */
+static void push_tag_marks(const DfaTable *table, Array *marks,
+                           const DfaTag *tag, int leaving, size_t position)
+{
+    if (tag == NULL)
+        return;
+
+    size_t offset = leaving ? tag->leave_offset : tag->enter_offset;
+    size_t count = leaving ? tag->leave_count : tag->enter_count;
+    for (size_t i = 0; i < count; i++)
+    {
+        GroupMark mark = {
+            .position = position,
+            .group = table->groups[offset + i],
+            .leaving = leaving,
+        };
+        array_append(marks, &mark);
+    }
+}
+
+static double clock_seconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * Append the bounds of the groups of a match to the scratch, from the first
+ * `size` markers. A group is bounded by the last time it is entered and the
+ * first time it is left afterwards.
+ * @param match_start The offset of the match in the string.
+ */
+static void bounds_from_marks(MatchScratch *scratch, size_t size,
+                              size_t nb_groups, size_t match_start)
+{
+    size_t none = SIZE_MAX;
+    array_clear(scratch->open);
+    for (size_t group = 0; group < nb_groups; group++)
+    {
+        array_append(scratch->open, &none);
+        array_append(scratch->bounds, &none);
+        array_append(scratch->bounds, &none);
+    }
+
+    size_t *open = scratch->open->data;
+    size_t *bounds =
+        (size_t *)scratch->bounds->data + scratch->bounds->size - 2 * nb_groups;
+    const GroupMark *marks = scratch->marks->data;
+    for (size_t i = 0; i < size; i++)
+    {
+        size_t group = marks[i].group;
+        if (!marks[i].leaving)
+            open[group] = marks[i].position;
+        else if (open[group] != SIZE_MAX)
+        {
+            bounds[2 * group] = match_start + open[group];
+            bounds[2 * group + 1] = match_start + marks[i].position;
+            open[group] = SIZE_MAX;
+        }
+    }
+}
+
+/**
+ * Copy the content of the groups whose bounds are in a scratch to its text.
+ * @return The groups, in the scratch.
+ */
+static char **copy_groups(MatchScratch *scratch, const char *string)
+{
+    const size_t *bounds = scratch->bounds->data;
+    size_t count = scratch->bounds->size / 2;
+    size_t text_size = 0;
+    for (size_t i = 0; i < count; i++)
+        if (bounds[2 * i] != SIZE_MAX)
+            text_size += bounds[2 * i + 1] - bounds[2 * i] + 1;
+
+    array_clear(scratch->text);
+    array_reserve(scratch->text, text_size);
+    array_clear(scratch->groups);
+    array_reserve(scratch->groups, count);
+    char *text = scratch->text->data;
+    char **groups = scratch->groups->data;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (bounds[2 * i] == SIZE_MAX)
+        {
+            groups[i] = NULL;
+            continue;
+        }
+        size_t length = bounds[2 * i + 1] - bounds[2 * i];
+        memcpy(text, string + bounds[2 * i], length);
+        text[length] = 0;
+        groups[i] = text;
+        text += length + 1;
+    }
+    scratch->text->size = text_size;
+    scratch->groups->size = count;
+
+    return scratch->groups->data;
+}
+
+/**
+ * Copy the content of the groups of the matches of a scratch from their
+ * bounds, once the matches are all found so that the pointers to the text
+ * stay valid.
+ */
+static void fill_groups(MatchScratch *scratch, const char *string,
+                        size_t nb_groups)
+{
+    char **groups = copy_groups(scratch, string);
+    Match *matches = scratch->matches->data;
+    for (size_t i = 0; i < scratch->matches->size; i++)
+        matches[i].groups = groups + i * nb_groups;
+}
+
+size_t search_table_prefix_scratch(const DfaTable *table, const char *string,
+                                   const char *prefix, MatchScratch *scratch)
+{
+    return search_table_capture_scratch(table, NULL, string, prefix, scratch);
+}
+
+size_t search_table_scratch(const DfaTable *table, const char *string,
+                            MatchScratch *scratch)
+{
+    return search_table_prefix_scratch(table, string, NULL, scratch);
+}
 
-    size_t final_size = strlen(string);
+Array *search_table(const DfaTable *table, const char *string,
+                    MatchScratch *scratch)
+{
+    search_table_scratch(table, string, scratch);
+    return copy_matches(scratch);
+}
+
+const char *replace_table_prefix_scratch(const DfaTable *table,
+                                         const char *string,
+                                         const char *prefix,
+                                         const char *replace,
+                                         MatchScratch *scratch)
+{
+    Array *result = scratch->text;
+    array_clear(result);
+    scratch->replacements = 0;
     size_t repl_size = strlen(replace);
-    for (const char *curr = string; *curr != 0; curr++)
+    while (*string != 0)
     {
-        arr_foreach(State *, start, automaton->starting_states)
+        if (prefix != NULL)
         {
-            char *end = submatch_nfa_from_state(automaton, curr, start);
-            if (end != NULL)
-            {
-                size_t len = end - curr;
-                final_size = final_size - len + repl_size;
-
-                match_bounds bounds;
-                bounds.start = curr - string;
-                bounds.end = end - string - 1;
-                array_append(matches, &bounds);
-                curr = string + bounds.end;
+            const char *next = strstr(string, prefix);
+            if (next == NULL)
+                next = string + strlen(string);
+            append_text(result, string, next - string);
+            string = next;
+            if (*string == 0)
                 break;
-            }
         }
-    }
 
-    const char *start = string;
-    char *final = SAFECALLOC(final_size + 1, sizeof(char));
-    char *result = final; // Keep a pointer to the head of the string
-    size_t last_bound = 0;
-    arr_foreach(match_bounds, bounds, matches)
-    {
-        memcpy(final, string, bounds.start - last_bound);
-        final += bounds.start - last_bound;
-        last_bound = bounds.end + 1;
-        strcpy(final, replace);
-        final += repl_size;
-        string = start + last_bound;
+        const char *end = table_longest_match(table, string);
+        if (end == NULL || end == string)
+        {
+            array_append(result, string++);
+            continue;
+        }
+        for (size_t i = 0; i < repl_size; i++)
+            array_append(result, replace + i);
+        scratch->replacements++;
+        string = end;
     }
-    // Add the remaining characters that do not need to be changed
-    for (; *string != 0; string++, final++)
-        *final = *string;
 
-    array_free(matches);
+    char end_char = 0;
+    array_append(result, &end_char);
+
+    return result->data;
+}
+
+const char *replace_table_scratch(const DfaTable *table, const char *string,
+                                  const char *replace, MatchScratch *scratch)
+{
+    return replace_table_prefix_scratch(table, string, NULL, replace,
+                                        scratch);
+}
+
+char *replace_table(const DfaTable *table, const char *string,
+                    const char *replace)
+{
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    replace_table_scratch(table, string, replace, scratch);
+    char *result = copy_text(scratch);
+    match_scratch_free(scratch);
 
     return result;
 }
 
+const Match *match_literal_scratch(const char *literal, const char *string,
+                                   MatchScratch *scratch)
+{
+    size_t length = strlen(literal);
+    if (strncmp(string, literal, length) != 0)
+        return NULL;
+
+    array_clear(scratch->matches);
+    add_match(scratch, string, string, string + length);
+
+    return scratch->matches->data;
+}
+
+Match *match_literal(const char *literal, const char *string)
+{
+    size_t length = strlen(literal);
+    if (strncmp(string, literal, length) != 0)
+        return NULL;
+
+    Match *match = SAFEMALLOC(sizeof(Match));
+    match->string = string;
+    match->start = 0;
+    match->length = length;
+    match->nb_groups = 0;
+    match->groups = NULL;
+
+    return match;
+}
+
+size_t search_literal_scratch(const char *literal, const char *string,
+                              MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
+    array_clear(scratch->bounds);
+    size_t length = strlen(literal);
+    // Only the non empty matches are returned
+    if (length == 0)
+        return 0;
+
+    for (const char *start = strstr(string, literal); start != NULL;
+         start = strstr(start + length, literal))
+        add_match(scratch, string, start, start + length);
+
+    return scratch->matches->size;
+}
+
+const char *replace_literal_scratch(const char *literal, const char *string,
+                                    const char *replace,
+                                    MatchScratch *scratch)
+{
+    Array *result = scratch->text;
+    array_clear(result);
+    scratch->replacements = 0;
+    size_t length = strlen(literal);
+    size_t repl_size = strlen(replace);
+    const char *start = length == 0 ? NULL : strstr(string, literal);
+    for (; start != NULL; start = strstr(string, literal))
+    {
+        append_text(result, string, start - string);
+        append_text(result, replace, repl_size);
+        scratch->replacements++;
+        string = start + length;
+    }
+    append_text(result, string, strlen(string) + 1);
+
+    return result->data;
+}
+
 /**
- * Test whether a string contains a substring recognized by a suffix of a NFA.
- * @param automaton Some NFA
- * @param string The string to test
- * @param start The state from which the search starts
- * @return The end pointer when the match ends if there is a match, else NULL.
+ * Empty the (instruction, position) set of a scratch for a string.
  */
-static char *submatch_nfa_from_state(const Automaton *automaton,
-                                     const char *string, State *start)
+static void reset_visited(const Backtracker *backtracker, size_t length,
+                          MatchScratch *scratch)
 {
-    char *max_str = NULL;
-
-    struct LinkedList *state_queue = LinkedList(size_t);
-    struct LinkedList *str_queue = LinkedList(char *);
-    list_push_back(state_queue, &start);
-    list_push_back(str_queue, &string);
-    while (!list_empty(state_queue))
+    size_t words = ((length + 1) * backtracker->size + 63) / 64;
+    if (words > scratch->visited_capacity)
     {
-        // Get the current id
-        LinkedList *curr_state_list = list_pop_front(state_queue);
-        State *curr_state = *(State **)curr_state_list->data;
-        // Get the current string
-        LinkedList *curr_str_list = list_pop_front(str_queue);
-        char *curr_str = *(char **)curr_str_list->data;
+        free(scratch->visited);
+        scratch->visited = SAFEMALLOC(words * sizeof(uint64_t));
+        scratch->visited_capacity = words;
+    }
+    memset(scratch->visited, 0, words * sizeof(uint64_t));
+}
 
-        list_free_from(curr_state_list);
-        list_free_from(curr_str_list);
+/**
+ * Queue an instruction of the backtracker at a position of the string, or
+ * the restoring of a slot.
+ */
+static void push_backtrack_job(Array *jobs, uint32_t inst, uint32_t slot,
+                               size_t position)
+{
+    BacktrackJob job = { .inst = inst, .slot = slot, .position = position };
+    array_append(jobs, &job);
+}
+
+/**
+ * Keep the slots of a match of the backtracker in `best_slots`.
+ */
+static void keep_backtrack_slots(MatchScratch *scratch, const size_t *slots)
+{
+    Array *best_slots = scratch->best_slots;
+    array_clear(best_slots);
+    array_reserve(best_slots, scratch->slots->size);
+    memcpy(best_slots->data, slots, scratch->slots->size * sizeof(size_t));
+    best_slots->size = scratch->slots->size;
+}
 
-        if (curr_state->terminal)
+/**
+ * Empty the slots of the path being run by the backtracker.
+ */
+static void reset_backtrack_slots(const Backtracker *backtracker,
+                                  MatchScratch *scratch)
+{
+    Array *slots = scratch->slots;
+    array_clear(slots);
+    size_t none = SIZE_MAX;
+    for (size_t i = 0; i < 2 * backtracker->nb_groups; i++)
+        array_append(slots, &none);
+}
+
+/**
+ * Run a backtracker from an offset of a string, trying the paths in the
+ * order of the pattern. Each (instruction, position) pair is run once:
+ * the first path reaching it has the priority over the next ones, and
+ * what follows does not depend on the path. The slots of the first path
+ * reaching the longest match are left in `best_slots`.
+ * @param limit The length of the string, nothing is read from there on.
+ * @return The end offset of the longest match, possibly empty, or SIZE_MAX
+ * if there is none.
+ */
+static size_t longest_backtrack(const Backtracker *backtracker,
+                                const char *string, size_t start,
+                                size_t limit, MatchScratch *scratch)
+{
+    Array *slots = scratch->slots;
+    reset_backtrack_slots(backtracker, scratch);
+
+    Array *jobs = scratch->jobs;
+    array_clear(jobs);
+    push_backtrack_job(jobs, 0, 0, start);
+    size_t best = SIZE_MAX;
+    while (jobs->size != 0)
+    {
+        BacktrackJob job = ((BacktrackJob *)jobs->data)[--jobs->size];
+        size_t *values = slots->data;
+        if (job.inst == BACKTRACK_RESTORE)
         {
-            if (curr_str > max_str)
-                max_str = curr_str;
-            if (*curr_str == 0)
+            values[job.slot] = job.position;
+            continue;
+        }
+        size_t bit = job.position * backtracker->size + job.inst;
+        if (scratch->visited[bit / 64] >> bit % 64 & 1)
+            continue;
+        scratch->visited[bit / 64] |= (uint64_t)1 << bit % 64;
+
+        // The jobs are run last in first out, the preferred one is pushed
+        // last
+        const BacktrackInst *inst = backtracker->insts + job.inst;
+        switch (inst->op)
+        {
+        case BACKTRACK_CLASS: {
+            if (job.position == limit)
+                break;
+            Letter letter = string[job.position];
+            const uint64_t *class = backtracker->classes[inst->arg];
+            if (class[letter / 64] >> letter % 64 & 1)
+                push_backtrack_job(jobs, inst->next, 0, job.position + 1);
+            break;
+        }
+        case BACKTRACK_SPLIT:
+            push_backtrack_job(jobs, inst->arg, 0, job.position);
+            push_backtrack_job(jobs, inst->next, 0, job.position);
+            break;
+        case BACKTRACK_JUMP:
+            push_backtrack_job(jobs, inst->next, 0, job.position);
+            break;
+        case BACKTRACK_SAVE:
+            push_backtrack_job(jobs, BACKTRACK_RESTORE, inst->arg,
+                               values[inst->arg]);
+            values[inst->arg] = job.position;
+            push_backtrack_job(jobs, inst->next, 0, job.position);
+            break;
+        case BACKTRACK_MATCH:
+            if (best == SIZE_MAX || job.position > best)
             {
-                list_free(state_queue);
-                list_free(str_queue);
-                return max_str;
+                best = job.position;
+                keep_backtrack_slots(scratch, values);
             }
+            // No match is longer than the string
+            if (best == limit)
+                return best;
+            break;
         }
+    }
 
-        // Test epsilon transitions
-        LinkedList *transition =
-            get_matrix_elt(automaton, curr_state->id, 0, 1);
-        if (transition != NULL)
-            transition = transition->next;
-        for (; transition != NULL; transition = transition->next)
+    return best;
+}
+
+/**
+ * Add the threads reached from an instruction without reading a letter to
+ * the list being built, in the order of the pattern, unless they are
+ * already in it. The thread starts with the slots of the path being run.
+ * @param threads The instructions of the threads of the list.
+ * @param thread_slots The slots of the threads of the list.
+ * @return The new number of threads.
+ */
+static size_t add_pike_threads(const Backtracker *backtracker, uint32_t inst,
+                               size_t position, size_t *threads,
+                               size_t *thread_slots, size_t count,
+                               MatchScratch *scratch)
+{
+    size_t nb_slots = scratch->slots->size;
+    Array *jobs = scratch->jobs;
+    array_clear(jobs);
+    push_backtrack_job(jobs, inst, 0, position);
+    while (jobs->size != 0)
+    {
+        BacktrackJob job = ((BacktrackJob *)jobs->data)[--jobs->size];
+        size_t *values = scratch->slots->data;
+        if (job.inst == BACKTRACK_RESTORE)
         {
-            State *state = *(State **)transition->data;
-            list_push_back(state_queue, &state);
-            // An epsilon-transition doesn't increment the pointer on the string
-            list_push_back(str_queue, &curr_str);
+            values[job.slot] = job.position;
+            continue;
         }
+        if (scratch->seen[job.inst] == scratch->generation)
+            continue;
+        scratch->seen[job.inst] = scratch->generation;
 
-        // Test the current letter
-        if (*curr_str != 0)
+        const BacktrackInst *next = backtracker->insts + job.inst;
+        switch (next->op)
         {
-            transition =
-                get_matrix_elt(automaton, curr_state->id, *curr_str, 0);
-            if (transition != NULL)
-                transition = transition->next;
-            for (; transition != NULL; transition = transition->next)
+        case BACKTRACK_CLASS:
+        case BACKTRACK_MATCH:
+            memcpy(thread_slots + count * nb_slots, values,
+                   nb_slots * sizeof(size_t));
+            threads[count++] = job.inst;
+            break;
+        case BACKTRACK_SPLIT:
+            push_backtrack_job(jobs, next->arg, 0, position);
+            push_backtrack_job(jobs, next->next, 0, position);
+            break;
+        case BACKTRACK_JUMP:
+            push_backtrack_job(jobs, next->next, 0, position);
+            break;
+        case BACKTRACK_SAVE:
+            push_backtrack_job(jobs, BACKTRACK_RESTORE, next->arg,
+                               values[next->arg]);
+            values[next->arg] = position;
+            push_backtrack_job(jobs, next->next, 0, position);
+            break;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Run a backtracker over a whole string as a Pike VM, for the strings too
+ * long for its (instruction, position) set: the paths are run side by side
+ * a letter at a time, in the order of the pattern, and the first one
+ * reaching an instruction has the priority over the next ones, as with
+ * longest_backtrack. The memory used only depends on the backtracker.
+ * @return Non zero if the whole string matches, the slots of the first
+ * path matching it are then left in `best_slots`.
+ */
+static int pike_backtrack(const Backtracker *backtracker, const char *string,
+                          size_t length, MatchScratch *scratch)
+{
+    reserve_states(scratch, backtracker->size);
+    reset_backtrack_slots(backtracker, scratch);
+    size_t nb_slots = scratch->slots->size;
+    array_clear(scratch->thread_slots);
+    array_reserve(scratch->thread_slots, 2 * backtracker->size * nb_slots);
+    size_t *current = scratch->current;
+    size_t *next = scratch->next;
+    size_t *current_slots = scratch->thread_slots->data;
+    size_t *next_slots = current_slots + backtracker->size * nb_slots;
+
+    scratch->generation++;
+    size_t count = add_pike_threads(backtracker, 0, 0, current, current_slots,
+                                    0, scratch);
+    for (size_t position = 0; count != 0; position++)
+    {
+        scratch->generation++;
+        size_t next_count = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const BacktrackInst *inst = backtracker->insts + current[i];
+            const size_t *slots = current_slots + i * nb_slots;
+            if (inst->op == BACKTRACK_MATCH)
             {
-                State *state = *(State **)transition->data;
-                list_push_back(state_queue, &state);
-                char *next_str = curr_str + 1;
-                list_push_back(str_queue, &next_str);
+                // The threads after this one have a lower priority
+                if (position == length)
+                {
+                    keep_backtrack_slots(scratch, slots);
+                    return 1;
+                }
+                continue;
             }
+            if (position == length)
+                continue;
+
+            Letter letter = string[position];
+            const uint64_t *class = backtracker->classes[inst->arg];
+            if ((class[letter / 64] >> letter % 64 & 1) == 0)
+                continue;
+            memcpy(scratch->slots->data, slots, nb_slots * sizeof(size_t));
+            next_count = add_pike_threads(backtracker, inst->next, position + 1,
+                                          next, next_slots, next_count,
+                                          scratch);
         }
+
+        size_t *swap = current;
+        current = next;
+        next = swap;
+        swap = current_slots;
+        current_slots = next_slots;
+        next_slots = swap;
+        count = next_count;
+        if (position == length)
+            break;
     }
-    list_free(state_queue);
-    list_free(str_queue);
-    return max_str;
+
+    return 0;
+}
+
+/**
+ * Append the bounds of the groups of the longest match found by the
+ * backtracker to a scratch.
+ * @param offset The offset in the string of the positions of the slots.
+ * @param nb_groups The number of groups of the expression.
+ */
+static void add_backtrack_bounds(const Backtracker *backtracker,
+                                 size_t offset, size_t nb_groups,
+                                 MatchScratch *scratch)
+{
+    const size_t *slots = scratch->best_slots->data;
+    for (size_t group = 0; group < nb_groups; group++)
+    {
+        size_t start = SIZE_MAX;
+        size_t end = SIZE_MAX;
+        if (group < backtracker->nb_groups && slots[2 * group + 1] != SIZE_MAX)
+        {
+            start = offset + slots[2 * group];
+            end = offset + slots[2 * group + 1];
+        }
+        array_append(scratch->bounds, &start);
+        array_append(scratch->bounds, &end);
+    }
+}
+
+/**
+ * Append a match of the backtracker and the bounds of its groups to a
+ * scratch.
+ */
+static void add_backtrack_match(const Backtracker *backtracker,
+                                const char *string, size_t start, size_t end,
+                                MatchScratch *scratch)
+{
+    Match match = {
+        .string = string,
+        .start = start,
+        .length = end - start,
+        .nb_groups = backtracker->nb_groups,
+        .groups = NULL,
+    };
+    array_append(scratch->matches, &match);
+    if (backtracker->nb_groups == 0)
+        return;
+
+    double time = scratch->timed ? clock_seconds() : 0;
+    add_backtrack_bounds(backtracker, 0, backtracker->nb_groups, scratch);
+    if (scratch->timed)
+        scratch->capture_seconds += clock_seconds() - time;
+}
+
+/**
+ * Copy the content of the groups of the matches found by the backtracker.
+ */
+static void fill_backtrack_groups(const Backtracker *backtracker,
+                                  const char *string, MatchScratch *scratch)
+{
+    if (backtracker->nb_groups == 0)
+        return;
+
+    double time = scratch->timed ? clock_seconds() : 0;
+    fill_groups(scratch, string, backtracker->nb_groups);
+    if (scratch->timed)
+        scratch->capture_seconds += clock_seconds() - time;
+}
+
+const Match *match_backtrack_scratch(const Backtracker *backtracker,
+                                     const char *string,
+                                     MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
+    array_clear(scratch->bounds);
+    size_t length = strlen(string);
+    reset_visited(backtracker, length, scratch);
+
+    size_t end = longest_backtrack(backtracker, string, 0, length, scratch);
+    if (end == SIZE_MAX)
+        return NULL;
+
+    add_backtrack_match(backtracker, string, 0, end, scratch);
+    fill_backtrack_groups(backtracker, string, scratch);
+    return scratch->matches->data;
+}
+
+size_t search_backtrack_scratch(const Backtracker *backtracker,
+                                const char *string, MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
+    array_clear(scratch->bounds);
+    size_t length = strlen(string);
+    size_t words = ((length + 1) * backtracker->size + 63) / 64;
+    reset_visited(backtracker, length, scratch);
+
+    // No match is reachable from the pairs run from a position without
+    // match, they stay visited for the next positions
+    size_t start = 0;
+    const uint64_t *first = backtracker->first_letters;
+    while (start < length)
+    {
+        Letter letter = string[start];
+        if ((first[letter / 64] >> letter % 64 & 1) == 0)
+        {
+            start++;
+            continue;
+        }
+
+        size_t end =
+            longest_backtrack(backtracker, string, start, length, scratch);
+        if (end == SIZE_MAX || end == start)
+        {
+            start++;
+            continue;
+        }
+
+        add_backtrack_match(backtracker, string, start, end, scratch);
+        // The pairs after a match may lead to the next one
+        size_t first_word = end * backtracker->size / 64;
+        memset(scratch->visited + first_word, 0,
+               (words - first_word) * sizeof(uint64_t));
+        start = end;
+    }
+
+    fill_backtrack_groups(backtracker, string, scratch);
+    return scratch->matches->size;
+}
+
+/**
+ * Walk a DFA table over a match to read the markers of its groups from the
+ * tags of its transitions.
+ * @param string The start of the match.
+ * @param length The length of the match.
+ * @return The number of markers up to the end of the match.
+ */
+static size_t table_tag_marks(const DfaTable *table, const char *string,
+                              size_t length, MatchScratch *scratch)
+{
+    Array *marks = scratch->marks;
+    array_clear(marks);
+    int32_t state = table->start;
+    size_t marks_top = 0;
+    for (size_t position = 0; position < length; position++)
+    {
+        Letter letter = string[position];
+        int32_t next = table->transitions[state * DFA_TABLE_ALPHABET + letter];
+        if (next == DFA_NO_STATE)
+            break;
+
+        const DfaTag *tr_tag = dfa_table_get_tag(table, state, letter);
+        const DfaTag *state_tag = dfa_table_get_tag(table, state, DFA_TAG_STATE);
+        push_tag_marks(table, marks, tr_tag, 1, position);
+        push_tag_marks(table, marks, state_tag, 1, position);
+        push_tag_marks(table, marks, state_tag, 0, position);
+        push_tag_marks(table, marks, tr_tag, 0, position + 1);
+
+        state = next;
+        if (table->terminal[state])
+        {
+            push_tag_marks(table, marks,
+                           dfa_table_get_tag(table, state, DFA_TAG_STATE), 1,
+                           position + 1);
+            marks_top = marks->size;
+        }
+    }
+
+    return marks_top;
+}
+
+/**
+ * Capture the groups of a match whose bounds are already known, and append
+ * their bounds to the scratch. The backtracker runs over the match only,
+ * as a Pike VM when it is too long to be backtracked over. The tags of the
+ * table are only read without a backtracker.
+ * @param table The DFA table of the expression, or NULL.
+ * @param backtracker The backtracker of the expression, or NULL.
+ * @param nb_groups The number of groups of the expression.
+ */
+static void capture_bounds(const DfaTable *table,
+                           const Backtracker *backtracker, size_t nb_groups,
+                           const char *string, size_t start, size_t end,
+                           MatchScratch *scratch)
+{
+    size_t length = end - start;
+    if (backtracker != NULL && length <= backtracker_max_length(backtracker))
+    {
+        reset_visited(backtracker, length, scratch);
+        if (longest_backtrack(backtracker, string + start, 0, length, scratch)
+            == length)
+        {
+            add_backtrack_bounds(backtracker, start, nb_groups, scratch);
+            return;
+        }
+    }
+    else if (backtracker != NULL
+             && pike_backtrack(backtracker, string + start, length, scratch))
+    {
+        add_backtrack_bounds(backtracker, start, nb_groups, scratch);
+        return;
+    }
+
+    size_t marks_top = 0;
+    if (table != NULL && table->tag_count != 0)
+        marks_top = table_tag_marks(table, string + start, length, scratch);
+    bounds_from_marks(scratch, marks_top, nb_groups, start);
+}
+
+void capture_matches_scratch(const DfaTable *table,
+                             const Backtracker *backtracker, size_t nb_groups,
+                             const char *string, MatchScratch *scratch)
+{
+    array_clear(scratch->bounds);
+    if (nb_groups == 0)
+        return;
+
+    double time = scratch->timed ? clock_seconds() : 0;
+    Match *matches = scratch->matches->data;
+    for (size_t i = 0; i < scratch->matches->size; i++)
+    {
+        matches[i].nb_groups = nb_groups;
+        capture_bounds(table, backtracker, nb_groups, string, matches[i].start,
+                       matches[i].start + matches[i].length, scratch);
+    }
+    fill_groups(scratch, string, nb_groups);
+    if (scratch->timed)
+        scratch->capture_seconds += clock_seconds() - time;
+}
+
+size_t search_table_spans_scratch(const DfaTable *table, const char *string,
+                                  const char *prefix, MatchScratch *scratch)
+{
+    array_clear(scratch->matches);
+    array_clear(scratch->bounds);
+    if (table->start == DFA_NO_STATE)
+        return 0;
+
+    const char *match_start = string;
+    while (*match_start != 0)
+    {
+        if (prefix != NULL
+            && (match_start = strstr(match_start, prefix)) == NULL)
+            break;
+
+        const char *match_end = table_longest_match(table, match_start);
+        if (match_end == NULL || match_end == match_start)
+        {
+            match_start++;
+            continue;
+        }
+
+        add_match(scratch, string, match_start, match_end);
+        match_start = match_end;
+    }
+
+    return scratch->matches->size;
+}
+
+const Match *capture_match_scratch(const DfaTable *table,
+                                   const Backtracker *backtracker,
+                                   size_t nb_groups, const Match *match,
+                                   MatchScratch *scratch)
+{
+    Match *captured = &scratch->captured;
+    *captured = *match;
+    captured->nb_groups = nb_groups;
+    captured->groups = NULL;
+    if (nb_groups == 0)
+        return captured;
+
+    double time = scratch->timed ? clock_seconds() : 0;
+    array_clear(scratch->bounds);
+    capture_bounds(table, backtracker, nb_groups, match->string, match->start,
+                   match->start + match->length, scratch);
+    captured->groups = copy_groups(scratch, match->string);
+    if (scratch->timed)
+        scratch->capture_seconds += clock_seconds() - time;
+    return captured;
+}
+
+size_t search_table_capture_scratch(const DfaTable *table,
+                                    const Backtracker *backtracker,
+                                    const char *string, const char *prefix,
+                                    MatchScratch *scratch)
+{
+    // The bounds of the matches are found first, the groups are only
+    // looked for in the matches
+    search_table_spans_scratch(table, string, prefix, scratch);
+    capture_matches_scratch(table, backtracker, table->nb_groups, string,
+                            scratch);
+    return scratch->matches->size;
+}
+
+const Match *match_table_capture_scratch(const DfaTable *table,
+                                         const Backtracker *backtracker,
+                                         const char *string,
+                                         MatchScratch *scratch)
+{
+    if (match_table_scratch(table, string, scratch) == NULL)
+        return NULL;
+
+    capture_matches_scratch(table, backtracker, table->nb_groups, string,
+                            scratch);
+    return scratch->matches->data;
 }
 
 void free_match(Match *match)
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "automaton/automaton.h"
+#include "automaton/backtrack.h"
+#include "automaton/dfa_table.h"
+#include "automaton/flat_nfa.h"
 #include "datatypes/array.h"
 
 /**
@@ -35,6 +38,109 @@ typedef struct Match
     char **groups;
 } Match;
 
+/**
+ * @struct MatchScratch
+ * @brief Mutable state of the matching functions.
+ * The automata and tables are only read while matching, everything a search
+ * writes to lives in a scratch. A compiled expression can then be shared by
+ * many threads as long as each of them uses its own scratch. A scratch is
+ * reused from one search to the next: its buffers only grow, so once they
+ * fit the searches of an expression, matching does not allocate anymore.
+ */
+typedef struct MatchScratch
+{
+    /**
+     * Group markers of the match being built, see search_table.
+     */
+    Array *marks;
+    /**
+     * Position where each group was entered while reading the markers.
+     */
+    Array *open;
+
+    /**
+     * Matches found by the last call, see search_table_scratch.
+     * Their groups point into `groups`, whose strings are in `text`.
+     */
+    Array *matches;
+    /**
+     * Bounds of the groups of the matches, as offsets in the string, or
+     * SIZE_MAX for the groups that did not match.
+     */
+    Array *bounds;
+    Array *groups;
+    /**
+     * Content of the groups, or the result of the last replacement.
+     */
+    Array *text;
+
+    /**
+     * The ids of the two state sets of the NFA simulation, with room for
+     * `nfa_capacity` states each.
+     */
+    size_t *current;
+    size_t *next;
+    size_t nfa_capacity;
+    /**
+     * A state is in the set being built if its `seen` entry is equal to
+     * `generation`, so that the sets are emptied without being cleared.
+     */
+    size_t *seen;
+    size_t generation;
+
+    /**
+     * The (instruction, position) pairs already run by the backtracker,
+     * with room for `visited_capacity` words, see search_backtrack_scratch.
+     */
+    uint64_t *visited;
+    size_t visited_capacity;
+    /**
+     * Instructions left to run by the backtracker, the slots of the groups
+     * on the path being run, and those of the longest match found so far.
+     */
+    Array *jobs;
+    Array *slots;
+    Array *best_slots;
+    /**
+     * The slots of the paths run side by side in `current` and `next`
+     * when a match is too long to be backtracked over, see
+     * capture_match_scratch.
+     */
+    Array *thread_slots;
+    /**
+     * The match whose groups were captured last, see capture_match_scratch.
+     */
+    Match captured;
+
+    /**
+     * Number of replacements made by the last replacement function.
+     */
+    size_t replacements;
+    /**
+     * When set, the time spent by the table search extracting the groups
+     * of the matches is added to `capture_seconds`.
+     */
+    int timed;
+    double capture_seconds;
+} MatchScratch;
+
+/**
+ * Allocate a scratch sized for an expression.
+ * @param nfa_size The number of states of the automaton matched without a
+ * table, 0 if there is none.
+ * @param nb_groups The number of groups of the expression.
+ * @param capacity The number of matches a search is expected to find.
+ */
+MatchScratch *match_scratch_create(size_t nfa_size, size_t nb_groups,
+                                   size_t capacity);
+
+void match_scratch_free(MatchScratch *scratch);
+
+/**
+ * Copy a match and its groups in the heap, e.g. a match of a scratch.
+ */
+Match *match_copy(const Match *match);
+
 /**
  * Test if an NFA matches the start of a string.
  * @author Rostan Tabet
@@ -46,6 +152,26 @@ typedef struct Match
  */
 Match *match_nfa(const Automaton *automaton, const char *string);
 
+/**
+ * Same as match_nfa, without allocating.
+ * @return The match, stored in the scratch until its next use, or NULL.
+ */
+const Match *match_nfa_scratch(const Automaton *automaton, const char *string,
+                               MatchScratch *scratch);
+
+/**
+ * Same as match_nfa, on the flat copy of a NFA without epsilon transitions
+ * kept by a finalized expression in place of the automaton.
+ */
+Match *match_flat(const FlatNfa *nfa, const char *string);
+
+/**
+ * Same as match_flat, without allocating.
+ * @return The match, stored in the scratch until its next use, or NULL.
+ */
+const Match *match_flat_scratch(const FlatNfa *nfa, const char *string,
+                                MatchScratch *scratch);
+
 /**
  * Return all matches in a string recognized by a given NFA.
  * @author Rostan Tabet
@@ -56,6 +182,20 @@ Match *match_nfa(const Automaton *automaton, const char *string);
  */
 Array *search_nfa(const Automaton *automaton, const char *string);
 
+/**
+ * Same as search_nfa, without allocating.
+ * @return The number of matches, stored in the `matches` array of the
+ * scratch until its next use.
+ */
+size_t search_nfa_scratch(const Automaton *automaton, const char *string,
+                          MatchScratch *scratch);
+
+/**
+ * Same as search_nfa_scratch, on the flat copy of a NFA, see match_flat.
+ */
+size_t search_flat_scratch(const FlatNfa *nfa, const char *string,
+                           MatchScratch *scratch);
+
 /**
  * Return all matches in a string recognized by a given DFA.
  * @author Rostan Tabet
@@ -79,6 +219,201 @@ Array *search_dfa(const Automaton *automaton, const char *string);
 char *replace_nfa(const Automaton *automaton, const char *string,
                   const char *replace);
 
+/**
+ * Same as replace_nfa, without allocating.
+ * @return The new string, stored in the scratch until its next use.
+ */
+const char *replace_nfa_scratch(const Automaton *automaton, const char *string,
+                                const char *replace, MatchScratch *scratch);
+
+/**
+ * Same as replace_nfa_scratch, on the flat copy of a NFA, see match_flat.
+ */
+const char *replace_flat_scratch(const FlatNfa *nfa, const char *string,
+                                 const char *replace, MatchScratch *scratch);
+
+/**
+ * Test if a DFA table matches the start of a string.
+ * The longest match is returned, as with match_nfa.
+ * @param table Some compiled DFA.
+ * @param string The string to test.
+ * @return A pointer to a `Match` struct if the string is recognized by the
+ * table, else NULL.
+ */
+Match *match_table(const DfaTable *table, const char *string);
+
+/**
+ * Same as match_table, without allocating.
+ * @return The match, stored in the scratch until its next use, or NULL.
+ */
+const Match *match_table_scratch(const DfaTable *table, const char *string,
+                                 MatchScratch *scratch);
+
+/**
+ * Same as match_table_scratch, along with the content of the groups of the
+ * match, captured once its bounds are found. See capture_match_scratch.
+ */
+const Match *match_table_capture_scratch(const DfaTable *table,
+                                         const Backtracker *backtracker,
+                                         const char *string,
+                                         MatchScratch *scratch);
+
+/**
+ * Return all the leftmost longest non empty matches in a string recognized by
+ * a DFA table, along with the content of their groups.
+ * @param table Some compiled DFA.
+ * @param string The string to extract substrings from.
+ * @param scratch The scratch of the calling thread.
+ * @return An array containing all the matches.
+ */
+Array *search_table(const DfaTable *table, const char *string,
+                    MatchScratch *scratch);
+
+/**
+ * Same as search_table, without allocating once the scratch is large
+ * enough.
+ * @return The number of matches, stored in the `matches` array of the
+ * scratch until its next use.
+ */
+size_t search_table_scratch(const DfaTable *table, const char *string,
+                            MatchScratch *scratch);
+
+/**
+ * Same as search_table_scratch, matches only start where a prefix is found.
+ * @param prefix A literal every match starts with, or NULL.
+ */
+size_t search_table_prefix_scratch(const DfaTable *table, const char *string,
+                                   const char *prefix, MatchScratch *scratch);
+
+/**
+ * Find the bounds of the leftmost longest non empty matches of a DFA table
+ * in a string, without their groups: the tags of the table are not read.
+ * @param prefix A literal every match starts with, or NULL.
+ * @return The number of matches, stored in the `matches` array of the
+ * scratch until its next use.
+ */
+size_t search_table_spans_scratch(const DfaTable *table, const char *string,
+                                  const char *prefix, MatchScratch *scratch);
+
+/**
+ * Same as search_table_prefix_scratch, in two phases: the bounds of the
+ * matches are found by search_table_spans_scratch, then the groups of each
+ * match are captured as with capture_match_scratch.
+ * @param backtracker The backtracker of the groups of the table, or NULL.
+ */
+size_t search_table_capture_scratch(const DfaTable *table,
+                                    const Backtracker *backtracker,
+                                    const char *string, const char *prefix,
+                                    MatchScratch *scratch);
+
+/**
+ * Capture the groups of a match whose bounds are known. The backtracker only
+ * explores the match, the matches too long for its (instruction, position)
+ * set are run by following all its paths side by side, with the same
+ * groups. The tags of the table are only read without a backtracker.
+ * @param table The DFA table of the expression, or NULL.
+ * @param backtracker The backtracker of the expression, or NULL. Without
+ * both, the groups are left unmatched.
+ * @param nb_groups The number of groups of the expression.
+ * @param match A match without groups, e.g. from search_table_spans_scratch.
+ * It is not modified.
+ * @return A copy of the match with its groups, stored in the scratch until
+ * its next capture. The matches of the scratch are kept.
+ */
+const Match *capture_match_scratch(const DfaTable *table,
+                                   const Backtracker *backtracker,
+                                   size_t nb_groups, const Match *match,
+                                   MatchScratch *scratch);
+
+/**
+ * Capture the groups of the matches of a scratch, found without them, e.g.
+ * by search_flat_scratch, as with capture_match_scratch.
+ */
+void capture_matches_scratch(const DfaTable *table,
+                             const Backtracker *backtracker, size_t nb_groups,
+                             const char *string, MatchScratch *scratch);
+
+/**
+ * Replace all the non empty substrings of a string recognized by a DFA
+ * table by another string.
+ * @param table Some compiled DFA.
+ * @param string The input string.
+ * @param replace The replacement string.
+ * @return A new string allocated in the heap containing all substitutions.
+ */
+char *replace_table(const DfaTable *table, const char *string,
+                    const char *replace);
+
+/**
+ * Same as replace_table, without allocating once the scratch is large
+ * enough.
+ * @return The new string, stored in the scratch until its next use.
+ */
+const char *replace_table_scratch(const DfaTable *table, const char *string,
+                                  const char *replace, MatchScratch *scratch);
+
+/**
+ * Same as replace_table_scratch, matches only start where a prefix is
+ * found.
+ * @param prefix A literal every match starts with, or NULL.
+ */
+const char *replace_table_prefix_scratch(const DfaTable *table,
+                                         const char *string,
+                                         const char *prefix,
+                                         const char *replace,
+                                         MatchScratch *scratch);
+
+/**
+ * Test if a string starts with a literal, the counterpart of match_table
+ * for the expressions without operators.
+ * @return A pointer to a `Match` struct, or NULL.
+ */
+Match *match_literal(const char *literal, const char *string);
+
+/**
+ * Same as match_literal, without allocating.
+ * @return The match, stored in the scratch until its next use, or NULL.
+ */
+const Match *match_literal_scratch(const char *literal, const char *string,
+                                   MatchScratch *scratch);
+
+/**
+ * Find the non overlapping occurrences of a literal in a string, from left
+ * to right.
+ * @return The number of matches, stored in the `matches` array of the
+ * scratch until its next use.
+ */
+size_t search_literal_scratch(const char *literal, const char *string,
+                              MatchScratch *scratch);
+
+/**
+ * Replace the non overlapping occurrences of a literal in a string.
+ * @return The new string, stored in the scratch until its next use.
+ */
+const char *replace_literal_scratch(const char *literal, const char *string,
+                                    const char *replace,
+                                    MatchScratch *scratch);
+
+/**
+ * Test if a backtracker matches the start of a string. The longest match is
+ * returned, with the content of its groups.
+ * @return The match, stored in the scratch until its next use, or NULL.
+ */
+const Match *match_backtrack_scratch(const Backtracker *backtracker,
+                                     const char *string,
+                                     MatchScratch *scratch);
+
+/**
+ * Find the leftmost longest non empty matches in a string by backtracking,
+ * along with the content of their groups. Each (instruction, position)
+ * pair is run at most once, the string should be short enough for their
+ * set to be small, see backtracker_max_length.
+ * @return The number of matches, stored in the `matches` array of the
+ * scratch until its next use.
+ */
+size_t search_backtrack_scratch(const Backtracker *backtracker,
+                                const char *string, MatchScratch *scratch);
+
 /**
  * Frees an allocated `Match` struct
  */
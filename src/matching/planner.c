@@ -0,0 +1,440 @@
+#include "matching/planner.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "datatypes/array.h"
+#include "parsing/parsing.h"
+#include "utils/memory_utils.h"
+
+/**
+ * Value of `count` when a tree matches too many literals, or literals too
+ * long, to keep track of them.
+ */
+#define LITERALS_UNKNOWN SIZE_MAX
+
+/**
+ * What is known of the strings matched by a subtree.
+ */
+typedef struct Literals
+{
+    size_t count;
+    char literals[PLAN_MAX_LITERALS][PLAN_LITERAL_SIZE];
+    char prefix[PLAN_LITERAL_SIZE];
+    char required[PLAN_LITERAL_SIZE];
+} Literals;
+
+static Literals *literals_create(size_t count)
+{
+    Literals *literals = SAFEMALLOC(sizeof(Literals));
+    literals->count = count;
+    literals->prefix[0] = 0;
+    literals->required[0] = 0;
+    return literals;
+}
+
+/**
+ * Copy the concatenation of two strings, truncated to PLAN_LITERAL_SIZE.
+ * @return Non zero if it was truncated.
+ */
+static int concat_literal(char *dst, const char *left, const char *right)
+{
+    size_t left_length = strlen(left);
+    size_t right_length = strlen(right);
+    int truncated = left_length + right_length >= PLAN_LITERAL_SIZE;
+    if (left_length >= PLAN_LITERAL_SIZE)
+        left_length = PLAN_LITERAL_SIZE - 1;
+    if (left_length + right_length >= PLAN_LITERAL_SIZE)
+        right_length = PLAN_LITERAL_SIZE - 1 - left_length;
+
+    memmove(dst, left, left_length);
+    memmove(dst + left_length, right, right_length);
+    dst[left_length + right_length] = 0;
+    return truncated;
+}
+
+/**
+ * Add the concatenation of two strings to the literals, or forget them
+ * when there are too many.
+ */
+static void add_literal(Literals *literals, const char *left,
+                        const char *right)
+{
+    if (literals->count == LITERALS_UNKNOWN)
+        return;
+    if (literals->count == PLAN_MAX_LITERALS
+        || concat_literal(literals->literals[literals->count], left, right))
+    {
+        literals->count = LITERALS_UNKNOWN;
+        return;
+    }
+    literals->count++;
+}
+
+/**
+ * Replace `dst` by `candidate` if it is longer.
+ */
+static void keep_longest(char *dst, const char *candidate)
+{
+    if (strlen(candidate) > strlen(dst))
+        strcpy(dst, candidate);
+}
+
+/**
+ * The prefix of the literals when they are all known.
+ */
+static void common_prefix(Literals *literals)
+{
+    if (literals->count == 0 || literals->count == LITERALS_UNKNOWN)
+        return;
+
+    strcpy(literals->prefix, literals->literals[0]);
+    for (size_t i = 1; i < literals->count; i++)
+    {
+        size_t length = 0;
+        while (literals->prefix[length] != 0
+               && literals->prefix[length] == literals->literals[i][length])
+            length++;
+        literals->prefix[length] = 0;
+    }
+}
+
+static Literals *analyze_letters(const Letter *letters, size_t size)
+{
+    Literals *literals = literals_create(0);
+    for (size_t i = 0; i < size; i++)
+    {
+        char letter[2] = { letters[i], 0 };
+        add_literal(literals, letter, "");
+    }
+    common_prefix(literals);
+    strcpy(literals->required, literals->prefix);
+    return literals;
+}
+
+static Literals *analyze_concatenation(const Literals *left,
+                                       const Literals *right)
+{
+    Literals *literals = literals_create(0);
+    if (left->count == LITERALS_UNKNOWN || right->count == LITERALS_UNKNOWN)
+        literals->count = LITERALS_UNKNOWN;
+    for (size_t i = 0; literals->count != LITERALS_UNKNOWN && i < left->count;
+         i++)
+        for (size_t j = 0; j < right->count; j++)
+            add_literal(literals, left->literals[i], right->literals[j]);
+
+    // The prefix goes on in the right side when the left one is a literal
+    if (left->count == 1)
+        concat_literal(literals->prefix, left->literals[0], right->prefix);
+    else
+        strcpy(literals->prefix, left->prefix);
+    if (literals->count != LITERALS_UNKNOWN)
+        common_prefix(literals);
+
+    strcpy(literals->required, left->required);
+    keep_longest(literals->required, right->required);
+    keep_longest(literals->required, literals->prefix);
+    return literals;
+}
+
+static Literals *analyze_union(const Literals *left, const Literals *right)
+{
+    Literals *literals = literals_create(0);
+    if (left->count == LITERALS_UNKNOWN || right->count == LITERALS_UNKNOWN)
+        literals->count = LITERALS_UNKNOWN;
+    for (size_t i = 0; i < left->count && literals->count != LITERALS_UNKNOWN;
+         i++)
+        add_literal(literals, left->literals[i], "");
+    for (size_t i = 0; i < right->count && literals->count != LITERALS_UNKNOWN;
+         i++)
+        add_literal(literals, right->literals[i], "");
+
+    size_t length = 0;
+    while (left->prefix[length] != 0
+           && left->prefix[length] == right->prefix[length])
+        length++;
+    memcpy(literals->prefix, left->prefix, length);
+    literals->prefix[length] = 0;
+
+    if (strcmp(left->required, right->required) == 0)
+        strcpy(literals->required, left->required);
+    keep_longest(literals->required, literals->prefix);
+    return literals;
+}
+
+static Literals *analyze_node(const BinTree *tree, PatternAnalysis *analysis)
+{
+    const Symbol *symbol = tree->data;
+    if (symbol->group != 0)
+        analysis->groups = 1;
+
+    if (symbol->type == LETTER)
+    {
+        analysis->positions++;
+        return analyze_letters(&symbol->value.letter, 1);
+    }
+    if (symbol->type == CHARACTER_CLASS)
+    {
+        analysis->positions++;
+        return analyze_letters(symbol->value.letters->data,
+                               symbol->value.letters->size);
+    }
+
+    Literals *left = analyze_node(tree->left, analysis);
+    Literals *right =
+        tree->right == NULL ? NULL : analyze_node(tree->right, analysis);
+    Literals *literals = NULL;
+    switch (symbol->value.operator)
+    {
+    case CONCATENATION:
+        literals = analyze_concatenation(left, right);
+        break;
+    case UNION:
+        literals = analyze_union(left, right);
+        break;
+    case MAYBE: {
+        Literals empty = { .count = 1, .prefix = "", .required = "" };
+        empty.literals[0][0] = 0;
+        literals = analyze_union(left, &empty);
+        break;
+    }
+    case EXISTS:
+        // Every match starts with a match of the subtree
+        literals = literals_create(LITERALS_UNKNOWN);
+        strcpy(literals->prefix, left->prefix);
+        strcpy(literals->required, left->required);
+        break;
+    default:
+        literals = literals_create(LITERALS_UNKNOWN);
+        break;
+    }
+
+    SAFEFREE(left);
+    SAFEFREE(right);
+    return literals;
+}
+
+/**
+ * Estimate the size of the DFA once the literals and positions are known.
+ */
+static void estimate_dfa(PatternAnalysis *analysis)
+{
+    if (analysis->literal_count != 0)
+    {
+        // A trie of the literals
+        analysis->dfa_estimate = 1;
+        for (size_t i = 0; i < analysis->literal_count; i++)
+            analysis->dfa_estimate += strlen(analysis->literals[i]);
+    }
+    else if (analysis->positions + 1 < sizeof(size_t) * 8)
+        analysis->dfa_estimate = (size_t)1 << (analysis->positions + 1);
+    else
+        analysis->dfa_estimate = SIZE_MAX;
+}
+
+void plan_analyze(const BinTree *tree, PatternAnalysis *analysis)
+{
+    memset(analysis, 0, sizeof(PatternAnalysis));
+    analysis->analyzed = 1;
+    Literals *literals = analyze_node(tree, analysis);
+
+    if (literals->count != LITERALS_UNKNOWN)
+    {
+        analysis->literal_count = literals->count;
+        memcpy(analysis->literals, literals->literals,
+               literals->count * PLAN_LITERAL_SIZE);
+    }
+    strcpy(analysis->prefix, literals->prefix);
+    strcpy(analysis->required, literals->required);
+    estimate_dfa(analysis);
+    SAFEFREE(literals);
+}
+
+void plan_analyze_literal(const char *literal, PatternAnalysis *analysis)
+{
+    memset(analysis, 0, sizeof(PatternAnalysis));
+    analysis->analyzed = 1;
+    analysis->positions = strlen(literal);
+    // Too long to be kept, only its start is required
+    if (!concat_literal(analysis->literals[0], literal, ""))
+        analysis->literal_count = 1;
+    concat_literal(analysis->prefix, literal, "");
+    strcpy(analysis->required, analysis->prefix);
+    estimate_dfa(analysis);
+    if (analysis->literal_count == 0)
+        analysis->dfa_estimate = analysis->positions + 1;
+}
+
+void plan_select(RegexPlan *plan, const DfaTable *table, const Automaton *nfa,
+                 const Backtracker *backtracker)
+{
+    const PatternAnalysis *analysis = &plan->analysis;
+    Engine engine = ENGINE_NONE;
+    if (table != NULL)
+        engine = ENGINE_DFA;
+    else if (nfa != NULL)
+        engine = ENGINE_NFA;
+
+    // strstr finds a literal faster than any automaton, but does not know
+    // about groups
+    if (engine != ENGINE_NONE && analysis->analyzed
+        && analysis->literal_count == 1 && !analysis->groups)
+        engine = ENGINE_LITERAL;
+
+    plan->match = engine;
+    plan->search = engine;
+    plan->sub = engine;
+    // Looking for the prefix already skips the strings without it
+    plan->check_required = (engine == ENGINE_DFA || engine == ENGINE_NFA)
+        && analysis->required[0] != 0
+        && (engine == ENGINE_NFA
+            || strcmp(analysis->required, analysis->prefix) != 0);
+    plan->check_prefix = (engine == ENGINE_DFA || engine == ENGINE_NFA)
+        && analysis->prefix[0] != 0;
+    plan->backtrack_length = engine == ENGINE_DFA || engine == ENGINE_NFA
+        ? backtracker_max_length(backtracker)
+        : 0;
+}
+
+int plan_backtracks(const RegexPlan *plan, const char *string)
+{
+    // The DFA finds the matches faster, and only they are backtracked over
+    size_t length = plan->backtrack_length;
+    return plan->search == ENGINE_NFA && length != 0
+        && strnlen(string, length + 1) <= length;
+}
+
+int plan_may_match(const RegexPlan *plan, const char *string)
+{
+    if (!plan->check_prefix)
+        return 1;
+    const char *prefix = plan->analysis.prefix;
+    return strncmp(string, prefix, strlen(prefix)) == 0;
+}
+
+int plan_may_search(const RegexPlan *plan, const char *string)
+{
+    return !plan->check_required
+        || strstr(string, plan->analysis.required) != NULL;
+}
+
+const char *engine_name(Engine engine)
+{
+    switch (engine)
+    {
+    case ENGINE_LITERAL:
+        return "literal";
+    case ENGINE_DFA:
+        return "dfa";
+    case ENGINE_NFA:
+        return "nfa";
+    default:
+        return "none";
+    }
+}
+
+static void explain_literal(FILE *out, const char *name, const char *literal)
+{
+    fprintf(out, "  %s: ", name);
+    if (*literal == 0)
+    {
+        fprintf(out, "none\n");
+        return;
+    }
+    fputc('"', out);
+    for (; *literal != 0; literal++)
+    {
+        unsigned char letter = *literal;
+        if (letter == '"' || letter == '\\')
+            fprintf(out, "\\%c", letter);
+        else if (letter < ' ' || letter >= 127)
+            fprintf(out, "\\x%02x", letter);
+        else
+            fputc(letter, out);
+    }
+    fprintf(out, "\"\n");
+}
+
+/**
+ * @param search Non zero for the operations looking for every match.
+ * @param groups Non zero for the operations returning the groups.
+ */
+static void explain_engine(FILE *out, const char *operation, Engine engine,
+                           const RegexPlan *plan, int search, int groups)
+{
+    fprintf(out, "  %s: %s", operation, engine_name(engine));
+    if (search && plan->check_required)
+        fprintf(out, ", skips strings without the required literal");
+    if (plan->check_prefix && (!search || engine == ENGINE_DFA))
+        fprintf(out, search ? ", starts matches at the prefix"
+                            : ", checks the prefix");
+    if (groups && plan->backtrack_length != 0 && engine == ENGINE_DFA)
+        fprintf(out, ", then backtracks over the matches of at most %zu bytes",
+                plan->backtrack_length);
+    else if (groups && plan->backtrack_length != 0 && engine == ENGINE_NFA)
+        fprintf(out, ", backtracks over strings of at most %zu bytes",
+                plan->backtrack_length);
+    fputc('\n', out);
+}
+
+char *plan_explain(const RegexPlan *plan, const char *pattern,
+                   const DfaTable *table, size_t nfa_size,
+                   const Backtracker *backtracker)
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (out == NULL)
+        errx(1, "Out of memory (explaining a plan)");
+
+    if (pattern != NULL)
+        fprintf(out, "pattern: %s\n", pattern);
+
+    const PatternAnalysis *analysis = &plan->analysis;
+    fprintf(out, "analysis:\n");
+    if (!analysis->analyzed)
+        fprintf(out, "  not analyzed, the expression was loaded\n");
+    else
+    {
+        fprintf(out, "  literals: ");
+        if (analysis->literal_count == 0)
+            fprintf(out, "not a set of literals\n");
+        else
+            fprintf(out, "%zu\n", analysis->literal_count);
+        explain_literal(out, "prefix", analysis->prefix);
+        explain_literal(out, "required", analysis->required);
+        fprintf(out, "  positions: %zu\n", analysis->positions);
+        fprintf(out, "  groups: %s\n", analysis->groups ? "yes" : "no");
+        if (analysis->dfa_estimate == SIZE_MAX)
+            fprintf(out, "  estimated dfa states: too many to count\n");
+        else
+            fprintf(out, "  estimated dfa states: at most %zu\n",
+                    analysis->dfa_estimate);
+    }
+
+    fprintf(out, "automaton:\n");
+    if (table != NULL)
+        fprintf(out, "  dfa: %zu states, %zu bytes, %s\n", table->size,
+                table->image_size,
+                table->jit != NULL ? "native code" : "interpreted");
+    else if (nfa_size != 0)
+        fprintf(out, "  nfa: %zu states, %s\n", nfa_size,
+                plan->dfa_skipped ? "no dfa was asked for"
+                                  : "the dfa was over budget");
+    else
+        fprintf(out, "  none, the compilation was over budget\n");
+    if (backtracker != NULL)
+        fprintf(out, "  backtracker: %zu instructions, %zu groups\n",
+                backtracker->size, backtracker->nb_groups);
+
+    fprintf(out, "plan:\n");
+    explain_engine(out, "match", plan->match, plan, 0, 1);
+    explain_engine(out, "search", plan->search, plan, 1, 1);
+    explain_engine(out, "sub", plan->sub, plan, 1, 0);
+
+    if (fclose(out) != 0)
+        errx(1, "Out of memory (explaining a plan)");
+    return text;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "automaton/automaton.h"
+#include "automaton/backtrack.h"
+#include "automaton/dfa_table.h"
+#include "datatypes/bin_tree.h"
+
+/**
+ * Size of the literals kept by the analysis, terminating null byte
+ * included. Longer literals are truncated, which keeps them required.
+ */
+#define PLAN_LITERAL_SIZE 64
+/**
+ * Largest set of literals the analysis keeps track of.
+ */
+#define PLAN_MAX_LITERALS 16
+
+/**
+ * The engines running an operation of an expression.
+ */
+typedef enum Engine
+{
+    /**
+     * The expression matches nothing, e.g. its compilation was over
+     * budget.
+     */
+    ENGINE_NONE,
+    /**
+     * The expression is a literal, searched for with strstr.
+     */
+    ENGINE_LITERAL,
+    /**
+     * The DFA table, or its native code when it was compiled.
+     */
+    ENGINE_DFA,
+    /**
+     * The simulation of the NFA, when the DFA is over budget.
+     */
+    ENGINE_NFA,
+} Engine;
+
+/**
+ * @struct PatternAnalysis
+ * @brief What a pattern tells about its matches, before it is compiled.
+ */
+typedef struct PatternAnalysis
+{
+    /**
+     * Zero if the pattern was not analyzed, e.g. a loaded table.
+     */
+    int analyzed;
+    /**
+     * The number of strings matched by the pattern when it matches a small
+     * set of short literals, listed in `literals`, 0 otherwise.
+     */
+    size_t literal_count;
+    char literals[PLAN_MAX_LITERALS][PLAN_LITERAL_SIZE];
+    /**
+     * A literal every match starts with, possibly empty.
+     */
+    char prefix[PLAN_LITERAL_SIZE];
+    /**
+     * The longest literal found in every match, possibly empty.
+     */
+    char required[PLAN_LITERAL_SIZE];
+    /**
+     * The number of letters and classes of the pattern.
+     */
+    size_t positions;
+    int groups;
+    /**
+     * Estimated number of states of the DFA: the states of a trie of the
+     * literals, or the 2^(positions + 1) bound of the subset construction.
+     * SIZE_MAX when it does not fit.
+     */
+    size_t dfa_estimate;
+} PatternAnalysis;
+
+/**
+ * @struct RegexPlan
+ * @brief The engines chosen for an expression, see regex_explain.
+ */
+typedef struct RegexPlan
+{
+    PatternAnalysis analysis;
+    Engine match;
+    Engine search;
+    Engine sub;
+    /**
+     * Non zero if the required literal of the analysis is looked for before
+     * running the engine: a string without it has no match.
+     */
+    int check_required;
+    /**
+     * Non zero if the prefix of the analysis is checked: regex_match fails
+     * on strings not starting with it, and the DFA only starts matches
+     * where it is found.
+     */
+    int check_prefix;
+    /**
+     * The groups the DFA drops are captured by backtracking over the
+     * matches of at most this length, once the DFA found their bounds.
+     * Without a DFA, the strings of at most this length are matched and
+     * searched by backtracking. 0 if the expression has no backtracker.
+     */
+    size_t backtrack_length;
+    /**
+     * Non zero if the options of the compilation asked for the NFA only,
+     * rather than the DFA going over budget.
+     */
+    int dfa_skipped;
+} RegexPlan;
+
+/**
+ * Analyze the tree of a pattern, before it is turned into an automaton.
+ */
+void plan_analyze(const BinTree *tree, PatternAnalysis *analysis);
+
+/**
+ * Analyze a pattern made of a single literal.
+ */
+void plan_analyze_literal(const char *literal, PatternAnalysis *analysis);
+
+/**
+ * Choose the engines of a compiled expression.
+ * @param plan The plan, with its analysis filled.
+ * @param table The DFA table of the expression, or NULL.
+ * @param nfa The NFA matched without a table, or NULL.
+ * @param backtracker The backtracker of the groups of the expression, or
+ * NULL.
+ */
+void plan_select(RegexPlan *plan, const DfaTable *table, const Automaton *nfa,
+                 const Backtracker *backtracker);
+
+/**
+ * @return Non zero if a string is short enough to be backtracked over as a
+ * whole, rather than simulating the NFA of an expression without DFA.
+ */
+int plan_backtracks(const RegexPlan *plan, const char *string);
+
+/**
+ * @return Zero if no match of the plan starts at the beginning of a string,
+ * whatever its engine.
+ */
+int plan_may_match(const RegexPlan *plan, const char *string);
+
+/**
+ * @return Zero if a string contains no match of the plan, whatever its
+ * engine.
+ */
+int plan_may_search(const RegexPlan *plan, const char *string);
+
+const char *engine_name(Engine engine);
+
+/**
+ * Describe a plan for humans.
+ * @param pattern The pattern of the expression, or NULL.
+ * @param nfa_size The number of states of the NFA matched without a table,
+ * 0 if there is none.
+ * @return A string allocated in the heap.
+ */
+char *plan_explain(const RegexPlan *plan, const char *pattern,
+                   const DfaTable *table, size_t nfa_size,
+                   const Backtracker *backtracker);
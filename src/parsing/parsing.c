@@ -352,3 +352,12 @@ BinTree *parse_symbols(Array *arr)
     }
     return b;
 }
+
+void parse_drop_groups(BinTree *tree)
+{
+    if (tree == NULL)
+        return;
+    ((Symbol *)tree->data)->group = 0;
+    parse_drop_groups(tree->left);
+    parse_drop_groups(tree->right);
+}
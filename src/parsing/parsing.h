@@ -63,6 +63,12 @@ typedef struct Symbol
 } Symbol;
 
 
+/**
+ * Turn the groups of a tree of symbols into plain parentheses, so that the
+ * automaton built from the tree has no group tags.
+ */
+void parse_drop_groups(BinTree *tree);
+
 /**
  * Turn an array of tokens into a binary tree of symbols.
  * @author Antoine Sicard
@@ -1,6 +1,9 @@
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
 #include "utils/memory_utils.h"
+#include "utils/errors.h"
 #include "datatypes/bin_tree.h"
 #include "datatypes/array.h"
 #include "automaton/automaton.h"
@@ -10,27 +13,186 @@
 #include "automaton/prune.h"
 #include "automaton/minimization.h"
 #include "automaton/stringify.h"
+#include "automaton/dfa_table.h"
+#include "automaton/codegen.h"
+#include "automaton/jit.h"
+#include "automaton/backtrack.h"
+#include "automaton/flat_nfa.h"
 #include "parsing/lexer.h"
 #include "parsing/parsing.h"
+#include "matching/planner.h"
+#include "rationl_internal.h"
+#include "utils/probes.h"
+#include "utils/worker.h"
 
-typedef struct reg_t
+RATIONL_PROBES(PROBE_DEFINE)
+
+
+/**
+ * Flatten a compiled automaton and compile the table to native code when
+ * the JIT is available.
+ * @param native Zero to keep the table interpreted.
+ */
+static DfaTable *build_table(Automaton *aut, const char *pattern, int native)
+{
+    DfaTable *table = dfa_table_build(aut, pattern);
+    if (table != NULL && native)
+        table->jit = dfa_jit_compile(table);
+    return table;
+}
+
+/**
+ * Statistics of a compilation being recorded, the clock is restarted at
+ * the end of every stage.
+ */
+typedef struct StatsRecorder
+{
+    regex_stats stats;
+    struct timespec start;
+    AllocationCounters allocations;
+} StatsRecorder;
+
+static void stats_start(StatsRecorder *recorder)
+{
+    memset(&recorder->stats, 0, sizeof(regex_stats));
+    recorder->allocations = allocation_counters();
+    clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+}
+
+/**
+ * Record the end of a stage.
+ * @param aut: The automaton built by the stage, or NULL.
+ */
+static void stats_stage(StatsRecorder *recorder, regex_stage stage,
+                        const Automaton *aut)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    regex_stage_stats *stats = recorder->stats.stages + stage;
+    stats->seconds = (end.tv_sec - recorder->start.tv_sec)
+        + (end.tv_nsec - recorder->start.tv_nsec) / 1e9;
+    if (aut != NULL)
+    {
+        stats->states = aut->size;
+        stats->transitions = automaton_transition_count(aut);
+    }
+    PROBE3(compile__stage, (int)stage, stats->states,
+           (unsigned long)(stats->seconds * 1e9));
+
+    // Counting the transitions is not part of the next stage
+    clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+}
+
+/**
+ * Record the building of the table, which ends the compilation.
+ */
+static const regex_stats *stats_finish(StatsRecorder *recorder,
+                                       const DfaTable *table)
 {
-    Automaton* aut;
-    char* pattern;
-} reg_t;
+    stats_stage(recorder, REGEX_STAGE_TABLE, NULL);
+    if (table != NULL)
+    {
+        regex_stage_stats *stats = recorder->stats.stages + REGEX_STAGE_TABLE;
+        stats->states = table->size;
+        size_t cells = table->size * DFA_TABLE_ALPHABET;
+        for (size_t i = 0; i < cells; i++)
+            stats->transitions += table->transitions[i] != DFA_NO_STATE;
+    }
+
+    AllocationCounters allocations = allocation_counters();
+    recorder->stats.allocations =
+        allocations.count - recorder->allocations.count;
+    recorder->stats.allocated_bytes =
+        allocations.bytes - recorder->allocations.bytes;
+    return &recorder->stats;
+}
 
-typedef struct match
+/**
+ * Wrap the result of a compilation in a program referenced once.
+ * The pattern is copied.
+ * @param stats: The statistics of the compilation, NULL if the program was
+ * not compiled.
+ * @param analysis: The analysis of the pattern, NULL if the program was not
+ * compiled.
+ * @param backtracker: The backtracker of the groups, or NULL.
+ */
+static reg_t program_create(Automaton *aut, const char *pattern,
+                            DfaTable *table, const regex_stats *stats,
+                            const PatternAnalysis *analysis,
+                            Backtracker *backtracker)
 {
-    const char *string;
-    size_t start;
-    size_t length;
-    size_t nb_groups;
-    char **groups;
-} match;
+    RegexProgram *program = SAFEMALLOC(sizeof(RegexProgram));
+    atomic_init(&program->refs, 1);
+    program->aut = aut;
+    program->aut_bytes = 0;
+    program->nfa = NULL;
+    program->pattern = NULL;
+    if (pattern != NULL)
+    {
+        program->pattern = SAFEMALLOC((strlen(pattern) + 1) * sizeof(char));
+        strcpy(program->pattern, pattern);
+    }
+    program->table = table;
+    program->backtracker = backtracker;
+    program->counters = NULL;
+    atomic_init(&program->upgrade, NULL);
+    program->async = NULL;
+
+    if (stats != NULL)
+        program->stats = *stats;
+    else
+        memset(&program->stats, 0, sizeof(regex_stats));
+    if (table != NULL)
+    {
+        program->stats.nb_groups = table->nb_groups;
+        program->stats.group_tags = table->tag_count;
+        program->stats.table_bytes = table->image_size;
+    }
+    else if (aut != NULL)
+        program->stats.nb_groups = aut->nb_groups;
+    if (backtracker != NULL)
+        program->stats.nb_groups = backtracker->nb_groups;
+
+    if (analysis != NULL)
+        program->plan.analysis = *analysis;
+    else
+        memset(&program->plan.analysis, 0, sizeof(PatternAnalysis));
+    plan_select(&program->plan, table, aut, backtracker);
+    program->plan.dfa_skipped =
+        aut != NULL && table == NULL && !program->stats.nfa_fallback;
+
+    reg_t re = { .program = program };
+    return re;
+}
+
+/**
+ * The program matching an expression: the one compiled in the background
+ * once the worker published it, the program of the expression otherwise.
+ */
+static const RegexProgram *active_program(reg_t re)
+{
+    const RegexProgram *upgrade =
+        atomic_load_explicit(&re.program->upgrade, memory_order_acquire);
+    return upgrade != NULL ? upgrade : re.program;
+}
+
+/**
+ * The number of states of the NFA of a program, in either form, 0 if it
+ * has none.
+ */
+static size_t program_nfa_size(const RegexProgram *program)
+{
+    if (program->nfa != NULL)
+        return program->nfa->size;
+    return program->aut == NULL ? 0 : program->aut->size;
+}
 
 reg_t regexp_compile_string(char *pattern)
 {
+    StatsRecorder recorder;
+    stats_start(&recorder);
     size_t size = strlen(pattern);
+    AllocationCounters allocations = allocation_counters();
     Automaton *aut = automaton_create(size+1, size);
     for (size_t i = 0; i<size+1; i++)
     {
@@ -45,56 +207,628 @@ reg_t regexp_compile_string(char *pattern)
         automaton_add_transition(aut, src, dst, pattern[i], 0);
     }
 
-    reg_t re;
-    re.aut = aut;
-    re.pattern = malloc((strlen(pattern) + 1) * sizeof(char));
-    strcpy(re.pattern, pattern);
+    size_t aut_bytes = allocation_counters().bytes - allocations.bytes;
+
+    DfaTable *table = build_table(aut, pattern, 1);
+    PatternAnalysis analysis;
+    plan_analyze_literal(pattern, &analysis);
+    reg_t re = program_create(aut, pattern, table,
+                              stats_finish(&recorder, table), &analysis, NULL);
+    re.program->aut_bytes = aut_bytes;
     return re;
 }
 
+/**
+ * Drop what only the compilation needed from a program, unless the
+ * options ask to keep it: the automaton is freed when the program has a
+ * table, and replaced by its flat copy otherwise. The copy of the pattern
+ * is dropped when the table keeps it.
+ */
+static reg_t program_finalize(reg_t re, const regex_options *options)
+{
+    RegexProgram *program = re.program;
+    if (options != NULL && options->no_finalize)
+        return re;
+
+    if (program->aut != NULL)
+    {
+        if (program->table == NULL)
+            program->nfa = flat_nfa_build(program->aut);
+        automaton_free(program->aut);
+        program->aut = NULL;
+        program->aut_bytes = 0;
+    }
+    if (program->table != NULL && program->pattern != NULL
+        && strcmp(program->table->pattern, program->pattern) == 0)
+    {
+        free(program->pattern);
+        program->pattern = NULL;
+    }
+
+    return re;
+}
+
+/**
+ * Attach counters to an expression if the options ask for them.
+ */
+static reg_t with_counters(reg_t re, const regex_options *options)
+{
+    if (options == NULL || !options->counters)
+        return re;
+
+    size_t size = REGEX_COUNTER_SHARDS * sizeof(CounterShard);
+    CounterShard *counters = aligned_alloc(REGEX_CACHE_LINE, size);
+    if (counters == NULL)
+        errx(1, "Out of memory (%zu bytes)", size);
+    for (size_t i = 0; i < REGEX_COUNTER_SHARDS; i++)
+    {
+        atomic_init(&counters[i].calls, 0);
+        atomic_init(&counters[i].bytes, 0);
+        atomic_init(&counters[i].matches, 0);
+        atomic_init(&counters[i].capture_ns, 0);
+    }
+    re.program->counters = counters;
+    return re;
+}
+
+static atomic_size_t next_counter_shard = 0;
+
+/**
+ * The shard of the calling thread, the threads take the shards in turn.
+ */
+static _Thread_local size_t counter_shard = SIZE_MAX;
+
+static CounterShard *thread_shard(const RegexProgram *program)
+{
+    if (counter_shard == SIZE_MAX)
+        counter_shard = atomic_fetch_add_explicit(&next_counter_shard, 1,
+                                                  memory_order_relaxed)
+            % REGEX_COUNTER_SHARDS;
+    return program->counters + counter_shard;
+}
+
+static void count_capture(const RegexProgram *program, double capture_seconds)
+{
+    if (capture_seconds > 0)
+        atomic_fetch_add_explicit(&thread_shard(program)->capture_ns,
+                                  (size_t)(capture_seconds * 1e9),
+                                  memory_order_relaxed);
+}
+
+static void count_call(const RegexProgram *program, const char *str,
+                       size_t matches, double capture_seconds)
+{
+    CounterShard *shard = thread_shard(program);
+    atomic_fetch_add_explicit(&shard->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->bytes, strlen(str),
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->matches, matches, memory_order_relaxed);
+    count_capture(program, capture_seconds);
+}
+
+/**
+ * Prepare the scratch of a call to a matching function.
+ */
+static MatchScratch *start_call(const RegexProgram *program,
+                                regex_scratch_t *scratch)
+{
+    MatchScratch *matching = scratch->matching;
+    matching->timed = program->counters != NULL;
+    matching->capture_seconds = 0;
+    return matching;
+}
+
 reg_t regex_compile(char* pattern)
 {
+    return regex_compile_options(pattern, NULL);
+}
+
+/**
+ * The level of a compilation, from the level and the engine of its
+ * options.
+ */
+static regex_level compile_level(const regex_options *options)
+{
+    if (options == NULL || options->level == REGEX_LEVEL_DEFAULT)
+        return options != NULL && options->engine == REGEX_ENGINE_NFA
+            ? REGEX_LEVEL_NFA
+            : REGEX_LEVEL_MINIMAL;
+    if (options->engine == REGEX_ENGINE_NFA)
+        return REGEX_LEVEL_NFA;
+    // A table needs at least a determinization
+    if (options->engine != REGEX_ENGINE_AUTO
+        && options->level == REGEX_LEVEL_NFA)
+        return REGEX_LEVEL_DFA;
+    return options->level;
+}
+
+/**
+ * @return Non zero if the table of a compilation is compiled to native
+ * code.
+ */
+static int compile_native(const regex_options *options, regex_level level)
+{
+    if (options == NULL || options->engine == REGEX_ENGINE_AUTO)
+        return level == REGEX_LEVEL_MINIMAL;
+    return options->engine == REGEX_ENGINE_NATIVE;
+}
+
+/**
+ * @return Non zero if the memory limit of a compilation is exceeded.
+ */
+static int over_memory_budget(const DeterminizeBudget *budget)
+{
+    DeterminizeBudget memory = *budget;
+    memory.max_states = 0;
+    return budget_exceeded(&memory, NULL);
+}
+
+reg_t regex_compile_options(char *pattern, const regex_options *options)
+{
+    // Every intermediate structure is allocated in the arena, only the
+    // final table is allocated outside of it
+    PROBE1(compile__start, pattern);
+    StatsRecorder recorder;
+    stats_start(&recorder);
+    DeterminizeBudget budget = { .max_states = 0, .max_bytes = 0,
+                                 .base_bytes = recorder.allocations.bytes };
+    if (options != NULL)
+    {
+        budget.max_states = options->max_dfa_states;
+        budget.max_bytes = options->max_memory;
+    }
+    int bounded = budget.max_states != 0 || budget.max_bytes != 0;
+    regex_level level = compile_level(options);
+
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
     Array *arr = tokenize(pattern);
 
     if (arr == NULL)
-        return regexp_compile_string(pattern);
-
+    {
+        arena_set_active(previous);
+        arena_free(arena);
+        return with_counters(
+            program_finalize(regexp_compile_string(pattern), options),
+            options);
+    }
+    stats_stage(&recorder, REGEX_STAGE_TOKENIZE, NULL);
 
     BinTree *tree = parse_symbols(arr);
+    if (options != NULL && options->no_captures)
+        parse_drop_groups(tree);
+    PatternAnalysis analysis;
+    plan_analyze(tree, &analysis);
+    // The groups are captured by backtracking over a program compiled from
+    // the tree and the tokens, kept out of the arena along with the table
+    Backtracker *backtracker = NULL;
+    if (analysis.groups)
+    {
+        arena_set_active(previous);
+        backtracker = backtracker_build(tree, arr);
+        arena_set_active(arena);
+        if (backtracker->nb_groups == 0)
+        {
+            backtracker_free(backtracker);
+            backtracker = NULL;
+        }
+    }
+    stats_stage(&recorder, REGEX_STAGE_PARSE, NULL);
     Automaton *aut = thompson(tree);
+    stats_stage(&recorder, REGEX_STAGE_THOMPSON, aut);
+    if (over_memory_budget(&budget))
+        goto over_budget;
     automaton_delete_epsilon_tr(aut);
+    stats_stage(&recorder, REGEX_STAGE_DELETE_EPSILON, aut);
+    if (over_memory_budget(&budget))
+        goto over_budget;
     automaton_prune(aut);
-    Automaton *minimized = minimize(aut);
-    automaton_free(aut);
-
-    reg_t re;
-    re.aut = minimized;
-    re.pattern = malloc((strlen(pattern) + 1) * sizeof(char));
-    strcpy(re.pattern, pattern);
-    bintree_free(tree);
-    free_tokens(arr);
+    stats_stage(&recorder, REGEX_STAGE_PRUNE, aut);
+    if (over_memory_budget(&budget))
+        goto over_budget;
+
+    // The NFA is kept out of the arena in case the DFA goes over the
+    // budget or is not built
+    Automaton *nfa = NULL;
+    arena_set_active(previous);
+    AllocationCounters allocations = allocation_counters();
+    if (bounded || level == REGEX_LEVEL_NFA)
+        nfa = automaton_copy(aut);
+    size_t nfa_bytes = allocation_counters().bytes - allocations.bytes;
+    arena_set_active(arena);
+    Automaton *dfa = NULL;
+    if (level == REGEX_LEVEL_DFA)
+    {
+        dfa = determine_bounded(aut, bounded ? &budget : NULL);
+        stats_stage(&recorder, REGEX_STAGE_DETERMINIZE, dfa);
+    }
+    else if (level == REGEX_LEVEL_MINIMAL)
+    {
+        dfa = minimize_bounded(aut, bounded ? &budget : NULL);
+        stats_stage(&recorder, REGEX_STAGE_MINIMIZE, dfa);
+    }
+    arena_set_active(previous);
+
+    DfaTable *table = NULL;
+    if (dfa != NULL)
+    {
+        table = build_table(dfa, pattern, compile_native(options, level));
+        if (nfa != NULL)
+            automaton_free(nfa);
+        nfa = NULL;
+    }
+    else if (level != REGEX_LEVEL_NFA)
+        PROBE3(compile__fallback, pattern, budget.max_states,
+               budget.max_bytes);
+    recorder.stats.nfa_fallback = dfa == NULL && level != REGEX_LEVEL_NFA;
+    reg_t re = program_create(nfa, pattern, table,
+                              stats_finish(&recorder, table), &analysis,
+                              backtracker);
+    if (nfa != NULL)
+        re.program->aut_bytes = nfa_bytes;
+    arena_free(arena);
+    PROBE3(compile__done, pattern, table == NULL ? 0 : table->size,
+           recorder.stats.allocated_bytes);
+    return with_counters(program_finalize(re, options), options);
+
+over_budget:
+    // Not even the NFA fits, the expression matches nothing
+    arena_set_active(previous);
+    arena_free(arena);
+    backtracker_free(backtracker);
+    rationl_errno = EBUDGET;
+    PROBE2(compile__over__budget, pattern, budget.max_bytes);
+    return with_counters(program_create(NULL, pattern, NULL,
+                                        stats_finish(&recorder, NULL),
+                                        &analysis, NULL),
+                         options);
+}
+
+/**
+ * Compile the DFA of a program on the worker thread, and publish it.
+ */
+static void compile_upgrade(void *arg)
+{
+    RegexProgram *program = arg;
+    AsyncCompile *async = program->async;
+    reg_t upgrade = regex_compile_options(program->pattern, &async->options);
+    if (upgrade.program->table != NULL)
+    {
+        upgrade.program->counters = program->counters;
+        atomic_store_explicit(&program->upgrade, upgrade.program,
+                              memory_order_release);
+    }
+    else
+        regex_free(upgrade);
+
+    pthread_mutex_lock(&async->lock);
+    async->done = 1;
+    pthread_cond_broadcast(&async->done_cond);
+    pthread_mutex_unlock(&async->lock);
+
+    // Drops the reference of the worker
+    reg_t re = { .program = program };
+    regex_free(re);
+}
+
+reg_t regex_compile_async(char *pattern, const regex_options *options)
+{
+    regex_options nfa_options = { 0 };
+    if (options != NULL)
+        nfa_options = *options;
+    if (compile_level(&nfa_options) == REGEX_LEVEL_NFA)
+        return regex_compile_options(pattern, options);
+
+    regex_options upgrade_options = nfa_options;
+    upgrade_options.counters = 0;
+    nfa_options.level = REGEX_LEVEL_NFA;
+    nfa_options.engine = REGEX_ENGINE_AUTO;
+    reg_t re = regex_compile_options(pattern, &nfa_options);
+    // Literals already have their table, and the NFA may be over budget
+    RegexProgram *program = re.program;
+    if (program->table != NULL
+        || (program->aut == NULL && program->nfa == NULL))
+        return re;
+
+    AsyncCompile *async = SAFEMALLOC(sizeof(AsyncCompile));
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->done_cond, NULL);
+    async->done = 0;
+    async->options = upgrade_options;
+    program->async = async;
+
+    // The worker holds a reference until it is done
+    atomic_fetch_add_explicit(&program->refs, 1, memory_order_relaxed);
+    worker_submit(compile_upgrade, program);
     return re;
 }
 
+int regex_wait(reg_t re)
+{
+    AsyncCompile *async = re.program->async;
+    if (async != NULL)
+    {
+        pthread_mutex_lock(&async->lock);
+        while (!async->done)
+            pthread_cond_wait(&async->done_cond, &async->lock);
+        pthread_mutex_unlock(&async->lock);
+    }
+
+    return active_program(re)->table != NULL ? 0 : -1;
+}
+
 reg_t regex_read_daut(char *path)
 {
+    StatsRecorder recorder;
+    stats_start(&recorder);
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
     Automaton *aut = automaton_from_daut(path, 255);
+    // The automaton read stands for the one built from a pattern
+    stats_stage(&recorder, REGEX_STAGE_THOMPSON, aut);
     automaton_delete_epsilon_tr(aut);
+    stats_stage(&recorder, REGEX_STAGE_DELETE_EPSILON, aut);
     automaton_prune(aut);
+    stats_stage(&recorder, REGEX_STAGE_PRUNE, aut);
     Automaton *minimized = minimize(aut);
-    automaton_free(aut);
+    stats_stage(&recorder, REGEX_STAGE_MINIMIZE, minimized);
+    char *pattern = stringify(minimized);
+    arena_set_active(previous);
+
+    // The pattern lives in the arena, the table gets its own copy
+    DfaTable *table = build_table(minimized, pattern, 1);
+    reg_t re = program_create(NULL, pattern, table,
+                              stats_finish(&recorder, table), NULL, NULL);
+    arena_free(arena);
+
+    return program_finalize(re, NULL);
+}
+
+/**
+ * Compile the backtracker capturing the groups of a pattern, e.g. for a
+ * table loaded without it.
+ * @return The backtracker, or NULL if the pattern has no group.
+ */
+static Backtracker *pattern_backtracker(const char *pattern)
+{
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
+    Backtracker *backtracker = NULL;
+    Array *tokens = tokenize(pattern);
+    if (tokens != NULL)
+    {
+        // Only the backtracker outlives the arena
+        BinTree *tree = parse_symbols(tokens);
+        arena_set_active(previous);
+        backtracker = backtracker_build(tree, tokens);
+    }
+    arena_set_active(previous);
+    arena_free(arena);
+
+    if (backtracker != NULL && backtracker->nb_groups == 0)
+    {
+        backtracker_free(backtracker);
+        backtracker = NULL;
+    }
+    return backtracker;
+}
+
+int regex_save(reg_t re, const char *path)
+{
+    const RegexProgram *program = active_program(re);
+    if (program->table == NULL)
+    {
+        rationl_errno = EBADFMT;
+        return -1;
+    }
+
+    return dfa_table_save(program->table, path);
+}
+
+reg_t regex_load(const char *path)
+{
+    DfaTable *table = dfa_table_load(path);
+    if (table == NULL)
+        return program_create(NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // The image does not hold the backtracker, the groups need it
+    table->jit = dfa_jit_compile(table);
+    Backtracker *backtracker =
+        table->nb_groups != 0 ? pattern_backtracker(table->pattern) : NULL;
+    return program_finalize(program_create(NULL, table->pattern, table, NULL,
+                                           NULL, backtracker),
+                            NULL);
+}
 
-    reg_t re;
-    re.aut = minimized;
-    re.pattern = stringify(minimized);
+void regex_compile_stats(reg_t re, regex_stats *stats)
+{
+    *stats = active_program(re)->stats;
+}
+
+char *regex_explain(reg_t re)
+{
+    const RegexProgram *program = active_program(re);
+    const char *pattern = program->pattern;
+    if (pattern == NULL && program->table != NULL)
+        pattern = program->table->pattern;
+    return plan_explain(&program->plan, pattern, program->table,
+                        program_nfa_size(program), program->backtracker);
+}
+
+/**
+ * The bytes held by a program, without its upgrade.
+ */
+static size_t program_memory_usage(const RegexProgram *program)
+{
+    size_t bytes = sizeof(RegexProgram) + program->aut_bytes
+        + dfa_table_memory_usage(program->table)
+        + flat_nfa_memory_usage(program->nfa)
+        + backtracker_memory_usage(program->backtracker);
+    if (program->pattern != NULL)
+        bytes += strlen(program->pattern) + 1;
+    if (program->async != NULL)
+        bytes += sizeof(AsyncCompile);
+    return bytes;
+}
 
+size_t regex_memory_usage(reg_t re)
+{
+    const RegexProgram *program = re.program;
+    size_t bytes = program_memory_usage(program);
+    if (program->counters != NULL)
+        bytes += REGEX_COUNTER_SHARDS * sizeof(CounterShard);
+    const RegexProgram *upgrade =
+        atomic_load_explicit(&program->upgrade, memory_order_acquire);
+    if (upgrade != NULL)
+        bytes += program_memory_usage(upgrade);
+    return bytes;
+}
+
+int regex_get_counters(reg_t re, regex_counters *counters)
+{
+    const CounterShard *shards = re.program->counters;
+    if (shards == NULL)
+        return -1;
+
+    size_t capture_ns = 0;
+    memset(counters, 0, sizeof(regex_counters));
+    for (size_t i = 0; i < REGEX_COUNTER_SHARDS; i++)
+    {
+        counters->calls += atomic_load_explicit(&shards[i].calls,
+                                                memory_order_relaxed);
+        counters->bytes_scanned += atomic_load_explicit(&shards[i].bytes,
+                                                        memory_order_relaxed);
+        counters->matches += atomic_load_explicit(&shards[i].matches,
+                                                  memory_order_relaxed);
+        capture_ns += atomic_load_explicit(&shards[i].capture_ns,
+                                           memory_order_relaxed);
+    }
+    counters->capture_seconds = capture_ns / 1e9;
+
+    return 0;
+}
+
+reg_t regex_ref(reg_t re)
+{
+    atomic_fetch_add_explicit(&re.program->refs, 1, memory_order_relaxed);
     return re;
 }
 
+int regex_generate_c(reg_t re, const char *prefix, const char *path)
+{
+    const DfaTable *table = active_program(re)->table;
+    if (table == NULL)
+    {
+        rationl_errno = EBADFMT;
+        return -1;
+    }
+
+    FILE *file = path == NULL ? stdout : fopen(path, "w");
+    if (file == NULL)
+    {
+        rationl_errno = ENOFILE;
+        return -1;
+    }
+
+    int res = codegen_write_table(table, prefix, file);
+    if (file != stdout && fclose(file) != 0 && res == 0)
+    {
+        rationl_errno = ENOFILE;
+        res = -1;
+    }
+
+    return res;
+}
+
+static void program_free(RegexProgram *program)
+{
+    RegexProgram *upgrade =
+        atomic_load_explicit(&program->upgrade, memory_order_relaxed);
+    if (upgrade != NULL)
+    {
+        // The counters belong to this program
+        upgrade->counters = NULL;
+        program_free(upgrade);
+    }
+    if (program->async != NULL)
+    {
+        pthread_mutex_destroy(&program->async->lock);
+        pthread_cond_destroy(&program->async->done_cond);
+        free(program->async);
+    }
+
+    if (program->aut != NULL)
+        automaton_free(program->aut);
+    flat_nfa_free(program->nfa);
+    dfa_table_free(program->table);
+    backtracker_free(program->backtracker);
+    free(program->counters);
+    free(program->pattern);
+    free(program);
+}
+
 void regex_free(reg_t re)
 {
-    automaton_free(re.aut);
-    free(re.pattern);
+    RegexProgram *program = re.program;
+    // The last reference frees the program, the ordering makes the reads
+    // of the other threads happen before
+    if (atomic_fetch_sub_explicit(&program->refs, 1, memory_order_acq_rel)
+        != 1)
+        return;
+
+    program_free(program);
+}
+
+regex_scratch_t *regex_scratch_create(reg_t re)
+{
+    const RegexProgram *program = active_program(re);
+    size_t nb_groups = program->stats.nb_groups;
+
+    regex_scratch_t *scratch = SAFEMALLOC(sizeof(regex_scratch_t));
+    scratch->matching =
+        match_scratch_create(program_nfa_size(program), nb_groups,
+                             REGEX_SCRATCH_MATCHES);
+    scratch->set_ids = Array(size_t);
+    return scratch;
+}
+
+void regex_scratch_free(regex_scratch_t *scratch)
+{
+    if (scratch == NULL)
+        return;
+    match_scratch_free(scratch->matching);
+    array_free(scratch->set_ids);
+    free(scratch);
+}
+
+static pthread_key_t call_scratch_key;
+static pthread_once_t call_scratch_once = PTHREAD_ONCE_INIT;
+
+static void free_call_scratch(void *scratch)
+{
+    regex_scratch_free(scratch);
+}
+
+static void create_call_scratch_key(void)
+{
+    pthread_key_create(&call_scratch_key, free_call_scratch);
+}
+
+/**
+ * The scratch of the calls that do not take one, e.g. regex_match, kept by
+ * the calling thread until it exits. It is sized for the first expression
+ * it is used with, and grows for the next ones.
+ */
+static regex_scratch_t *call_scratch(reg_t re)
+{
+    pthread_once(&call_scratch_once, create_call_scratch_key);
+    regex_scratch_t *scratch = pthread_getspecific(call_scratch_key);
+    if (scratch == NULL)
+    {
+        scratch = regex_scratch_create(re);
+        pthread_setspecific(call_scratch_key, scratch);
+    }
+    return scratch;
 }
 
 void match_free(match *match)
@@ -102,30 +836,212 @@ void match_free(match *match)
     free_match((Match *) match);
 }
 
+/**
+ * Match the start of a string with the engine of the plan, the groups
+ * included.
+ */
+static const Match *match_program(const RegexProgram *program,
+                                  const char *str, MatchScratch *matching)
+{
+    const RegexPlan *plan = &program->plan;
+    if (!plan_may_match(plan, str))
+        return NULL;
+    else if (plan_backtracks(plan, str))
+        return match_backtrack_scratch(program->backtracker, str, matching);
+    else if (plan->match == ENGINE_LITERAL)
+        return match_literal_scratch(plan->analysis.literals[0], str,
+                                     matching);
+    else if (plan->match == ENGINE_DFA)
+        return match_table_capture_scratch(program->table,
+                                           program->backtracker, str,
+                                           matching);
+    else if (plan->match == ENGINE_NFA)
+    {
+        // The string is too long to be backtracked over, only the match is
+        const Match *found = program->nfa != NULL
+            ? match_flat_scratch(program->nfa, str, matching)
+            : match_nfa_scratch(program->aut, str, matching);
+        if (found != NULL)
+            capture_matches_scratch(NULL, program->backtracker,
+                                    program->stats.nb_groups, str, matching);
+        return found;
+    }
+    return NULL;
+}
+
 match *regex_match(reg_t re, char* str)
 {
-    return (match *)match_nfa(re.aut, str);
+    PROBE1(match__start, str);
+    const RegexProgram *program = active_program(re);
+    const RegexPlan *plan = &program->plan;
+    match *m = NULL;
+    if (!plan_may_match(plan, str))
+        m = NULL;
+    else if (program->stats.nb_groups != 0)
+    {
+        // The groups are captured in the scratch of the thread
+        MatchScratch *matching = call_scratch(re)->matching;
+        const Match *found = match_program(program, str, matching);
+        m = found == NULL ? NULL : (match *)match_copy(found);
+    }
+    else if (plan->match == ENGINE_LITERAL)
+        m = (match *)match_literal(plan->analysis.literals[0], str);
+    else if (plan->match == ENGINE_DFA)
+        m = (match *)match_table(program->table, str);
+    else if (plan->match == ENGINE_NFA && program->nfa != NULL)
+        m = (match *)match_flat(program->nfa, str);
+    else if (plan->match == ENGINE_NFA)
+        m = (match *)match_nfa(program->aut, str);
+
+    if (program->counters != NULL)
+        count_call(program, str, m != NULL, 0);
+    PROBE3(match__done, str, PROBE_ENABLED(match__done) ? strlen(str) : 0,
+           m != NULL);
+    return m;
 }
 
-size_t regex_search(reg_t re, char *str, match **groups[])
+const match *regex_match_r(reg_t re, regex_scratch_t *scratch, const char *str)
+{
+    PROBE1(match__start, str);
+    const RegexProgram *program = active_program(re);
+    MatchScratch *matching = start_call(program, scratch);
+    const match *m = (const match *)match_program(program, str, matching);
+
+    if (program->counters != NULL)
+        count_call(program, str, m != NULL, matching->capture_seconds);
+    PROBE3(match__done, str, PROBE_ENABLED(match__done) ? strlen(str) : 0,
+           m != NULL);
+    return m;
+}
+
+/**
+ * Search a string with the engine of the plan.
+ * @param captures Zero to only find the bounds of the matches.
+ */
+static size_t search_program(const RegexProgram *program, const char *str,
+                             int captures, MatchScratch *matching)
 {
-    Array *arr;
-    if (re.aut->is_determined)
-        arr = search_dfa(re.aut, str);
+    const RegexPlan *plan = &program->plan;
+    const char *prefix = plan->check_prefix ? plan->analysis.prefix : NULL;
+    if (!plan_may_search(plan, str))
+        array_clear(matching->matches);
+    else if (captures && plan_backtracks(plan, str))
+        search_backtrack_scratch(program->backtracker, str, matching);
+    else if (plan->search == ENGINE_LITERAL)
+        search_literal_scratch(plan->analysis.literals[0], str, matching);
+    else if (plan->search == ENGINE_DFA && captures)
+        search_table_capture_scratch(program->table, program->backtracker, str,
+                                     prefix, matching);
+    else if (plan->search == ENGINE_DFA)
+        search_table_spans_scratch(program->table, str, prefix, matching);
+    else if (plan->search == ENGINE_NFA)
+    {
+        if (program->nfa != NULL)
+            search_flat_scratch(program->nfa, str, matching);
+        else
+            search_nfa_scratch(program->aut, str, matching);
+        if (captures)
+            capture_matches_scratch(NULL, program->backtracker,
+                                    program->stats.nb_groups, str, matching);
+    }
     else
-        arr = search_nfa(re.aut, str);
+        array_clear(matching->matches);
+    return matching->matches->size;
+}
 
-    size_t n = arr->size;
-    *groups = SAFEMALLOC(n * sizeof(char *));
+size_t regex_search_r(reg_t re, regex_scratch_t *scratch, const char *str,
+                      const match **matches)
+{
+    PROBE1(search__start, str);
+    const RegexProgram *program = active_program(re);
+    MatchScratch *matching = start_call(program, scratch);
+    size_t n = search_program(program, str, 1, matching);
+
+    if (program->counters != NULL)
+        count_call(program, str, n, matching->capture_seconds);
+    PROBE3(search__done, str, PROBE_ENABLED(search__done) ? strlen(str) : 0,
+           n);
+    *matches = matching->matches->data;
+    return n;
+}
 
+size_t regex_search_spans_r(reg_t re, regex_scratch_t *scratch,
+                            const char *str, const match **matches)
+{
+    PROBE1(search__start, str);
+    const RegexProgram *program = active_program(re);
+    MatchScratch *matching = start_call(program, scratch);
+    size_t n = search_program(program, str, 0, matching);
+
+    if (program->counters != NULL)
+        count_call(program, str, n, 0);
+    PROBE3(search__done, str, PROBE_ENABLED(search__done) ? strlen(str) : 0,
+           n);
+    *matches = matching->matches->data;
+    return n;
+}
+
+const match *regex_groups_r(reg_t re, regex_scratch_t *scratch,
+                            const match *m)
+{
+    const RegexProgram *program = active_program(re);
+    MatchScratch *matching = start_call(program, scratch);
+    const match *captured = (const match *)capture_match_scratch(
+        program->table, program->backtracker, program->stats.nb_groups,
+        (const Match *)m, matching);
+
+    if (program->counters != NULL)
+        count_capture(program, matching->capture_seconds);
+    return captured;
+}
+
+size_t regex_search(reg_t re, char *str, match **groups[])
+{
+    const match *matches;
+    size_t n = regex_search_r(re, call_scratch(re), str, &matches);
+
+    *groups = SAFEMALLOC(n * sizeof(match *));
     for (size_t i = 0; i < n; i++)
-        (*groups)[i] = *(match **)array_get(arr, i);
+        (*groups)[i] = (match *)match_copy((const Match *)matches + i);
 
-    array_free(arr);
     return n;
 }
 
+const char *regex_sub_r(reg_t re, regex_scratch_t *scratch, const char *str,
+                        const char *sub)
+{
+    PROBE1(sub__start, str);
+    const RegexProgram *program = active_program(re);
+    MatchScratch *matching = start_call(program, scratch);
+    const RegexPlan *plan = &program->plan;
+    const char *prefix = plan->check_prefix ? plan->analysis.prefix : NULL;
+    const char *result = str;
+    matching->replacements = 0;
+    if (!plan_may_search(plan, str))
+        result = str;
+    else if (plan->sub == ENGINE_LITERAL)
+        result = replace_literal_scratch(plan->analysis.literals[0], str, sub,
+                                         matching);
+    else if (plan->sub == ENGINE_DFA)
+        result = replace_table_prefix_scratch(program->table, str, prefix,
+                                              sub, matching);
+    else if (plan->sub == ENGINE_NFA && program->nfa != NULL)
+        result = replace_flat_scratch(program->nfa, str, sub, matching);
+    else if (plan->sub == ENGINE_NFA)
+        result = replace_nfa_scratch(program->aut, str, sub, matching);
+
+    if (program->counters != NULL)
+        count_call(program, str, matching->replacements, 0);
+    PROBE3(sub__done, str, PROBE_ENABLED(sub__done) ? strlen(str) : 0,
+           matching->replacements);
+    return result;
+}
+
 char *regex_sub(reg_t re, char *str, char *sub)
 {
-    return replace_nfa(re.aut, str, sub);
+    const char *result = regex_sub_r(re, call_scratch(re), str, sub);
+    char *copy = SAFEMALLOC((strlen(result) + 1) * sizeof(char));
+    strcpy(copy, result);
+
+    return copy;
 }
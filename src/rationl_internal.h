@@ -0,0 +1,169 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "automaton/automaton.h"
+#include "automaton/dfa_table.h"
+#include "matching/matching.h"
+#include "matching/planner.h"
+#include "rationl.h"
+
+/**
+ * Number of sets of counters of an expression, the threads are spread
+ * over them so that they rarely update the same one.
+ */
+#define REGEX_COUNTER_SHARDS 32
+#define REGEX_CACHE_LINE 64
+
+/**
+ * @struct CounterShard
+ * @brief Counters of an expression updated by some of the threads, see
+ * regex_get_counters. A shard fills a cache line so that two threads do
+ * not write to the same line.
+ */
+typedef struct CounterShard
+{
+    atomic_size_t calls;
+    atomic_size_t bytes;
+    atomic_size_t matches;
+    atomic_size_t capture_ns;
+    char padding[REGEX_CACHE_LINE - 4 * sizeof(atomic_size_t)];
+} CounterShard;
+
+/**
+ * @struct AsyncCompile
+ * @brief State of the compilation of a program in the background, see
+ * regex_compile_async.
+ */
+typedef struct AsyncCompile
+{
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    /**
+     * Set once the worker is done, whether it published a program or not.
+     */
+    int done;
+    /**
+     * The options of the compilation in the background.
+     */
+    regex_options options;
+} AsyncCompile;
+
+/**
+ * @struct RegexProgram
+ * @brief A compiled regular expression.
+ * A program is never modified once compiled: the matching functions only
+ * read it and keep their state in a regex_scratch_t, so that it can be
+ * shared by several threads without locks. It is freed when the last
+ * reg_t referencing it is freed.
+ */
+typedef struct RegexProgram
+{
+    /**
+     * Number of reg_t referencing the program, see regex_ref.
+     */
+    atomic_size_t refs;
+
+    /**
+     * The automaton matched when the expression has no table, until the
+     * program is finalized, see program_finalize.
+     */
+    Automaton *aut;
+    /**
+     * Bytes allocated for `aut`.
+     */
+    size_t aut_bytes;
+    /**
+     * The flat copy of `aut` matched in its place once the program is
+     * finalized.
+     */
+    FlatNfa *nfa;
+    /**
+     * The pattern, NULL once the program is finalized if the table keeps
+     * it.
+     */
+    char *pattern;
+    DfaTable *table;
+    /**
+     * Captures the groups of the matches when the expression has groups,
+     * NULL otherwise.
+     */
+    Backtracker *backtracker;
+
+    /**
+     * The engines matching the program, see regex_explain.
+     */
+    RegexPlan plan;
+
+    /**
+     * Recorded when the program is compiled, see regex_compile_stats.
+     */
+    regex_stats stats;
+
+    /**
+     * REGEX_COUNTER_SHARDS shards, NULL if the expression is not counted.
+     */
+    CounterShard *counters;
+
+    /**
+     * The program compiled in the background, published by the worker
+     * when it is ready and matched in place of this one from then on. It
+     * shares the counters of this program. NULL until then.
+     */
+    _Atomic(struct RegexProgram *) upgrade;
+    /**
+     * NULL unless the program is compiled by regex_compile_async.
+     */
+    AsyncCompile *async;
+} RegexProgram;
+
+/**
+ * @struct reg_t
+ * @brief Definition of the compiled regular expression of the public API.
+ * It is kept out of rationl.h so that the layout stays private to the
+ * library and the tools shipped with it.
+ */
+struct reg_t
+{
+    RegexProgram *program;
+};
+
+/**
+ * Number of matches a scratch has room for when it is created.
+ */
+#define REGEX_SCRATCH_MATCHES 16
+
+/**
+ * @struct regex_scratch_t
+ * @brief Mutable state of the matching functions of the public API, owned
+ * by a single thread.
+ */
+struct regex_scratch_t
+{
+    MatchScratch *matching;
+    /**
+     * The ids found by regex_set_match.
+     */
+    Array *set_ids;
+};
+
+/**
+ * Number of patterns of a shard of a regex_set_t.
+ */
+#define REGEX_SET_SHARD_SIZE 32
+
+/**
+ * @struct regex_set_t
+ * @brief Patterns of a set, by id, and the shards they are spread over.
+ */
+struct regex_set_t
+{
+    regex_options options;
+    /**
+     * The SetPattern of each id, removed patterns included.
+     */
+    Array *patterns;
+    Array *shards;
+    size_t size;
+};
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datatypes/array.h"
+#include "rationl_internal.h"
+#include "utils/errors.h"
+#include "utils/memory_utils.h"
+
+/**
+ * @struct SetPattern
+ * A pattern of a set, compiled on its own.
+ */
+typedef struct SetPattern
+{
+    char *pattern;
+    reg_t re;
+    size_t shard;
+    int removed;
+} SetPattern;
+
+/**
+ * @struct SetShard
+ * Up to REGEX_SET_SHARD_SIZE patterns of a set, searched at once by the
+ * union of their patterns before being searched one by one.
+ */
+typedef struct SetShard
+{
+    /**
+     * The ids of the patterns of the shard.
+     */
+    Array *members;
+    /**
+     * The union of the patterns, compiled without groups. Only kept when
+     * it has a DFA, the members are searched directly otherwise.
+     */
+    reg_t filter;
+    int has_filter;
+} SetShard;
+
+regex_set_t *regex_set_create(const regex_options *options)
+{
+    regex_set_t *set = SAFEMALLOC(sizeof(regex_set_t));
+    memset(&set->options, 0, sizeof(regex_options));
+    if (options != NULL)
+        set->options = *options;
+    // The counters of a set would be spread over its patterns
+    set->options.counters = 0;
+    set->patterns = Array(SetPattern);
+    set->shards = Array(SetShard);
+    set->size = 0;
+    return set;
+}
+
+/**
+ * Compile the union of the patterns of a shard again, after one of them
+ * was added or removed.
+ */
+static void rebuild_shard(regex_set_t *set, SetShard *shard)
+{
+    if (shard->has_filter)
+        regex_free(shard->filter);
+    shard->has_filter = 0;
+    if (shard->members->size < 2)
+        return;
+
+    size_t length = 0;
+    const SetPattern *patterns = set->patterns->data;
+    arr_foreach(size_t, id, shard->members)
+        length += strlen(patterns[id].pattern) + 3;
+    char *pattern = SAFEMALLOC(length);
+    char *end = pattern;
+    arr_foreach(size_t, member, shard->members)
+    {
+        if (end != pattern)
+            *end++ = '|';
+        end += sprintf(end, "(%s)", patterns[member].pattern);
+    }
+
+    regex_options options = set->options;
+    options.no_captures = 1;
+    shard->filter = regex_compile_options(pattern, &options);
+    free(pattern);
+    shard->has_filter = shard->filter.program->table != NULL;
+    if (!shard->has_filter)
+        regex_free(shard->filter);
+}
+
+/**
+ * @return Non zero if a pattern can be put between parentheses in the union
+ * of a shard. A trailing '\' or an unclosed '[' is accepted in a pattern
+ * alone, but swallows the closing parenthesis in the union.
+ */
+static int set_pattern_valid(const char *pattern)
+{
+    int escaped = 0;
+    int in_class = 0;
+    for (; *pattern != 0; pattern++)
+    {
+        if (escaped)
+            escaped = 0;
+        else if (in_class)
+            in_class = *pattern != ']';
+        else if (*pattern == '\\')
+            escaped = 1;
+        else
+            in_class = *pattern == '[';
+    }
+    return !escaped && !in_class;
+}
+
+long regex_set_add(regex_set_t *set, char *pattern)
+{
+    if (!set_pattern_valid(pattern))
+    {
+        rationl_errno = EBADFMT;
+        return -1;
+    }
+
+    // The first shard with room takes the pattern, so that the shards
+    // emptied by removals are filled again
+    SetShard *shards = set->shards->data;
+    size_t shard = 0;
+    while (shard < set->shards->size
+           && shards[shard].members->size >= REGEX_SET_SHARD_SIZE)
+        shard++;
+    if (shard == set->shards->size)
+    {
+        SetShard empty = { .members = Array(size_t), .has_filter = 0 };
+        array_append(set->shards, &empty);
+    }
+
+    SetPattern added = {
+        .pattern = SAFEMALLOC(strlen(pattern) + 1),
+        .re = regex_compile_options(pattern, &set->options),
+        .shard = shard,
+        .removed = 0,
+    };
+    strcpy(added.pattern, pattern);
+    size_t id = set->patterns->size;
+    array_append(set->patterns, &added);
+    set->size++;
+
+    SetShard *target = array_get(set->shards, shard);
+    array_append(target->members, &id);
+    rebuild_shard(set, target);
+    return id;
+}
+
+int regex_set_remove(regex_set_t *set, long id)
+{
+    if (id < 0 || (size_t)id >= set->patterns->size)
+        return -1;
+    SetPattern *removed = array_get(set->patterns, id);
+    if (removed->removed)
+        return -1;
+
+    SetShard *shard = array_get(set->shards, removed->shard);
+    size_t *members = shard->members->data;
+    size_t i = 0;
+    while (members[i] != (size_t)id)
+        i++;
+    array_remove(shard->members, i);
+
+    regex_free(removed->re);
+    free(removed->pattern);
+    removed->pattern = NULL;
+    removed->removed = 1;
+    set->size--;
+    rebuild_shard(set, shard);
+    return 0;
+}
+
+size_t regex_set_size(const regex_set_t *set)
+{
+    return set->size;
+}
+
+regex_scratch_t *regex_set_scratch_create(const regex_set_t *set)
+{
+    (void)set;
+    regex_scratch_t *scratch = SAFEMALLOC(sizeof(regex_scratch_t));
+    scratch->matching = match_scratch_create(0, 0, REGEX_SCRATCH_MATCHES);
+    scratch->set_ids = Array(size_t);
+    return scratch;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+    size_t left = *(const size_t *)a;
+    size_t right = *(const size_t *)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @return Non zero if an expression matches somewhere in a string.
+ */
+static int set_search(reg_t re, regex_scratch_t *scratch, const char *str)
+{
+    const match *matches;
+    return regex_search_spans_r(re, scratch, str, &matches) != 0;
+}
+
+size_t regex_set_match(const regex_set_t *set, regex_scratch_t *scratch,
+                       const char *str, const size_t **ids)
+{
+    Array *found = scratch->set_ids;
+    array_clear(found);
+    const SetPattern *patterns = set->patterns->data;
+    arr_foreach(SetShard, shard, set->shards)
+    {
+        // Most strings match none of the patterns of a shard
+        if (shard.has_filter && !set_search(shard.filter, scratch, str))
+            continue;
+        arr_foreach(size_t, id, shard.members)
+        {
+            if (set_search(patterns[id].re, scratch, str))
+                array_append(found, &id);
+        }
+    }
+
+    qsort(found->data, found->size, sizeof(size_t), compare_ids);
+    *ids = found->data;
+    return found->size;
+}
+
+void regex_set_free(regex_set_t *set)
+{
+    if (set == NULL)
+        return;
+    arr_foreach(SetPattern, pattern, set->patterns)
+    {
+        if (pattern.removed)
+            continue;
+        regex_free(pattern.re);
+        free(pattern.pattern);
+    }
+    arr_foreach(SetShard, shard, set->shards)
+    {
+        if (shard.has_filter)
+            regex_free(shard.filter);
+        array_free(shard.members);
+    }
+    array_free(set->patterns);
+    array_free(set->shards);
+    free(set);
+}
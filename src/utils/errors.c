@@ -1,3 +1,3 @@
 #include "errors.h"
 
-int rationl_errno = 0;
+_Thread_local int rationl_errno = 0;
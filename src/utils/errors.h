@@ -1,8 +1,14 @@
 #pragma once
 
-extern int rationl_errno;
+/**
+ * Error of the last failed call of the calling thread.
+ */
+extern _Thread_local int rationl_errno;
 
 #define EBADFMT  1   /* bad format */
 #define ENOFILE  2   /* no such file or directory */
+#define EBADSUM  3   /* checksum mismatch */
+#define EBADVER  4   /* unsupported version or byte order */
+#define EBUDGET  5   /* compilation over its memory budget */
 
 // #define EUNBAL   _   /* unbalanced parentheses/brackets */
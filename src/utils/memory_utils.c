@@ -1,19 +1,192 @@
 #include "utils/memory_utils.h"
 
-//LCOV_EXCL_START
-void* safe_malloc(size_t n, unsigned long line)
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+/**
+ * Size of the header stored before every block of an arena, it contains
+ * the size of the block so that it can be reallocated.
+ */
+#define ARENA_HEADER ARENA_ALIGN
+
+/**
+ * Bytes written by the debug build over the blocks of an arena when they
+ * are allocated and when the arena is released.
+ */
+#define ARENA_POISON_ALLOC 0xcd
+#define ARENA_POISON_FREE 0xdd
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+} ArenaChunk;
+
+struct Arena
+{
+    ArenaChunk *chunks;
+    size_t allocated;
+};
+
+static _Thread_local Arena *active_arena = NULL;
+
+static _Thread_local AllocationCounters counters = { 0, 0 };
+
+static size_t align(size_t n)
 {
-    void* p = malloc(n);
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+/**
+ * Allocate with malloc even when an arena is active.
+ */
+static void *heap_malloc(size_t n, unsigned long line)
+{
+    void *p = malloc(n);
     if (!p)
-    {
         errx(1, "[%s:%lu] Out of memory (%lu bytes)\n",
-                __FILE__, line, (unsigned long)n);
-    }
+             __FILE__, line, (unsigned long)n);
     return p;
 }
 
+static unsigned char *chunk_data(ArenaChunk *chunk)
+{
+    return (unsigned char *)chunk + align(sizeof(ArenaChunk));
+}
+
+static void *arena_alloc(Arena *arena, size_t n, unsigned long line)
+{
+    size_t needed = ARENA_HEADER + align(n);
+    ArenaChunk *chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < needed)
+    {
+        size_t size = needed > ARENA_CHUNK_SIZE ? needed : ARENA_CHUNK_SIZE;
+        chunk = heap_malloc(align(sizeof(ArenaChunk)) + size, line);
+        chunk->size = size;
+        chunk->used = 0;
+        // Keep the current chunk in front if the new one is already full
+        if (needed == size && arena->chunks != NULL)
+        {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        else
+        {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    unsigned char *block = chunk_data(chunk) + chunk->used;
+#ifdef DEBUG
+    memset(block + ARENA_HEADER, ARENA_POISON_ALLOC, n);
+#endif
+    *(size_t *)block = n;
+    chunk->used += needed;
+    arena->allocated += n;
+
+    return block + ARENA_HEADER;
+}
+
+static void *arena_realloc(Arena *arena, void *p, size_t n,
+                           unsigned long line)
+{
+    if (p == NULL)
+        return arena_alloc(arena, n, line);
+
+    unsigned char *block = (unsigned char *)p - ARENA_HEADER;
+    size_t old_size = *(size_t *)block;
+    if (n <= old_size)
+        return p;
+
+    // The last block of the current chunk can grow in place
+    ArenaChunk *chunk = arena->chunks;
+    unsigned char *end = chunk_data(chunk) + chunk->used;
+    if (block + ARENA_HEADER + align(old_size) == end
+        && chunk->size - chunk->used >= align(n) - align(old_size))
+    {
+        chunk->used += align(n) - align(old_size);
+        arena->allocated += n - old_size;
+#ifdef DEBUG
+        memset((unsigned char *)p + old_size, ARENA_POISON_ALLOC, n - old_size);
+#endif
+        *(size_t *)block = n;
+        return p;
+    }
+
+    void *new_p = arena_alloc(arena, n, line);
+    memcpy(new_p, p, old_size);
+    return new_p;
+}
+
+Arena *arena_create(void)
+{
+    Arena *arena = heap_malloc(sizeof(Arena), __LINE__);
+    arena->chunks = NULL;
+    arena->allocated = 0;
+    return arena;
+}
+
+Arena *arena_set_active(Arena *arena)
+{
+    Arena *previous = active_arena;
+    active_arena = arena;
+    return previous;
+}
+
+size_t arena_allocated(const Arena *arena)
+{
+    return arena->allocated;
+}
+
+void arena_free(Arena *arena)
+{
+    if (arena == NULL)
+        return;
+
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL)
+    {
+        ArenaChunk *next = chunk->next;
+#ifdef DEBUG
+        memset(chunk_data(chunk), ARENA_POISON_FREE, chunk->size);
+#endif
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+AllocationCounters allocation_counters(void)
+{
+    return counters;
+}
+
+static void count_allocation(size_t n)
+{
+    counters.count++;
+    counters.bytes += n;
+}
+
+//LCOV_EXCL_START
+void* safe_malloc(size_t n, unsigned long line)
+{
+    count_allocation(n);
+    if (active_arena != NULL)
+        return arena_alloc(active_arena, n, line);
+
+    return heap_malloc(n, line);
+}
+
 void *safe_realloc(void *p, size_t n, unsigned long line)
 {
+    count_allocation(n);
+    if (active_arena != NULL)
+        return arena_realloc(active_arena, p, n, line);
+
     void *new_p = realloc(p, n);
 
     if (!new_p)
@@ -24,6 +197,10 @@ void *safe_realloc(void *p, size_t n, unsigned long line)
 }
 void* safe_calloc(size_t n, size_t m, unsigned long line)
 {
+    count_allocation(n * m);
+    if (active_arena != NULL)
+        return memset(arena_alloc(active_arena, n * m, line), 0, n * m);
+
     void* p = calloc(n, m);
     if (!p)
         errx(1, "[%s:%lu] Out of memory (%lu bytes)\n",
@@ -32,3 +209,9 @@ void* safe_calloc(size_t n, size_t m, unsigned long line)
     return p;
 }
 //LCOV_EXCL_STOP
+
+void safe_free(void *p)
+{
+    if (active_arena == NULL)
+        free(p);
+}
@@ -3,18 +3,66 @@
 #include <stdlib.h>
 #include <err.h>
 
-#ifndef DEBUG
-  #define SAFEMALLOC(n) safe_malloc(n, __LINE__)
-  #define SAFECALLOC(n, m) safe_calloc(n, m, __LINE__)
-  #define SAFEREALLOC(p, n) safe_realloc(p, n, __LINE__)
-#else
-  #define SAFEMALLOC(n) malloc(n)
-  #define SAFECALLOC(n, m) calloc(n, m)
-  #define SAFEREALLOC(p, m) realloc(p, m)
-#endif
+// The debug build goes through the same functions, which poison the
+// memory of the arenas to catch uses of uninitialized or released blocks
+#define SAFEMALLOC(n) safe_malloc(n, __LINE__)
+#define SAFECALLOC(n, m) safe_calloc(n, m, __LINE__)
+#define SAFEREALLOC(p, n) safe_realloc(p, n, __LINE__)
+#define SAFEFREE(p) safe_free(p)
+
+/**
+ * @struct Arena
+ * @brief Region allocator for short lived allocations.
+ * While an arena is active on a thread, SAFEMALLOC, SAFECALLOC and
+ * SAFEREALLOC allocate in it and SAFEFREE does nothing: all its memory is
+ * released at once by arena_free. It is used to compile regular
+ * expressions, whose intermediate automata make a lot of small
+ * allocations.
+ */
+typedef struct Arena Arena;
+
+Arena *arena_create(void);
+
+/**
+ * Makes an arena the active arena of the calling thread.
+ * @param arena: The arena to use, NULL to use malloc again.
+ * @return The previously active arena, to be restored afterwards.
+ */
+Arena *arena_set_active(Arena *arena);
+
+/**
+ * @return The number of bytes requested to the arena.
+ */
+size_t arena_allocated(const Arena *arena);
+
+/**
+ * Releases all the memory of an arena, which must not be active.
+ */
+void arena_free(Arena *arena);
+
+/**
+ * @struct AllocationCounters
+ * @brief Allocations made by SAFEMALLOC, SAFECALLOC and SAFEREALLOC on the
+ * calling thread, in an arena or not, since the thread started.
+ */
+typedef struct AllocationCounters
+{
+    size_t count;
+    /**
+     * Bytes requested, a reallocation counts for its new size.
+     */
+    size_t bytes;
+} AllocationCounters;
+
+/**
+ * @return The allocation counters of the calling thread.
+ */
+AllocationCounters allocation_counters(void);
 
 void* safe_malloc(size_t n, unsigned long line);
 
 void *safe_calloc(size_t n, size_t m, unsigned long line);
 
 void *safe_realloc(void *p, size_t n, unsigned long line);
+
+void safe_free(void *p);
@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * Static tracepoints of the library, for perf and bpftrace. They are only
+ * compiled with --enable-usdt, otherwise the probes and their arguments
+ * disappear.
+ *
+ * The probes are listed in RATIONL_PROBES, a probe `name` is fired with
+ * PROBEn(name, ...) and has the semaphore rationl_name_semaphore, set by
+ * the tracers while they are attached. Arguments that are costly to
+ * compute are guarded with PROBE_ENABLED(name).
+ */
+#define RATIONL_PROBES(X)                                                      \
+    X(compile__start)                                                          \
+    X(compile__stage)                                                          \
+    X(compile__fallback)                                                       \
+    X(compile__over__budget)                                                   \
+    X(compile__done)                                                           \
+    X(match__start)                                                            \
+    X(match__done)                                                             \
+    X(search__start)                                                           \
+    X(search__done)                                                            \
+    X(sub__start)                                                              \
+    X(sub__done)
+
+#ifdef ENABLE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define PROBE_SEMAPHORE(name) rationl_##name##_semaphore
+#define PROBE_DECLARE(name)                                                    \
+    extern unsigned short PROBE_SEMAPHORE(name)                                \
+        __attribute__((visibility("hidden")));
+#define PROBE_DEFINE(name)                                                     \
+    unsigned short PROBE_SEMAPHORE(name)                                       \
+        __attribute__((section(".probes"), visibility("hidden"))) = 0;
+
+#define PROBE_ENABLED(name) __builtin_expect(PROBE_SEMAPHORE(name) != 0, 0)
+#define PROBE1(name, a) DTRACE_PROBE1(rationl, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(rationl, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(rationl, name, a, b, c)
+
+RATIONL_PROBES(PROBE_DECLARE)
+
+#else
+
+#define PROBE_DEFINE(name)
+#define PROBE_ENABLED(name) 0
+#define PROBE1(name, a) ((void)0)
+#define PROBE2(name, a, b) ((void)0)
+#define PROBE3(name, a, b, c) ((void)0)
+
+#endif
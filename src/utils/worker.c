@@ -0,0 +1,75 @@
+#include "utils/worker.h"
+
+#include <err.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/memory_utils.h"
+
+/**
+ * @struct WorkerJob
+ * A job waiting for the worker thread.
+ */
+typedef struct WorkerJob
+{
+    void (*run)(void *arg);
+    void *arg;
+    struct WorkerJob *next;
+} WorkerJob;
+
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_ready = PTHREAD_COND_INITIALIZER;
+static WorkerJob *worker_head = NULL;
+static WorkerJob *worker_tail = NULL;
+static int worker_started = 0;
+
+static void *worker_main(void *unused)
+{
+    (void)unused;
+    for (;;)
+    {
+        pthread_mutex_lock(&worker_lock);
+        while (worker_head == NULL)
+            pthread_cond_wait(&worker_ready, &worker_lock);
+        WorkerJob *job = worker_head;
+        worker_head = job->next;
+        if (worker_head == NULL)
+            worker_tail = NULL;
+        pthread_mutex_unlock(&worker_lock);
+
+        job->run(job->arg);
+        free(job);
+    }
+
+    return NULL;
+}
+
+void worker_submit(void (*run)(void *arg), void *arg)
+{
+    WorkerJob *job = SAFEMALLOC(sizeof(WorkerJob));
+    job->run = run;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&worker_lock);
+    if (!worker_started)
+    {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        int error = pthread_create(&thread, &attr, worker_main, NULL);
+        pthread_attr_destroy(&attr);
+        if (error != 0)
+            errx(1, "Cannot start the worker thread: %s", strerror(error));
+        worker_started = 1;
+    }
+    if (worker_tail == NULL)
+        worker_head = job;
+    else
+        worker_tail->next = job;
+    worker_tail = job;
+    pthread_cond_signal(&worker_ready);
+    pthread_mutex_unlock(&worker_lock);
+}
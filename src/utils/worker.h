@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * Run a job on the worker thread of the library. The jobs run one at a
+ * time, in the order they were submitted. The thread is started by the
+ * first job and runs until the process exits.
+ * @param run The function of the job, called on the worker thread.
+ * @param arg The argument of the function.
+ */
+void worker_submit(void (*run)(void *arg), void *arg);
@@ -232,3 +232,24 @@ Test(array, array_concat)
 
     array_free(array);
 }
+
+Test(array, array_reserve)
+{
+    Array *array = Array(int);
+    array_reserve(array, 100);
+    cr_assert_geq(array->capacity, 100);
+
+    // Appending within the capacity keeps the same storage
+    void *data = array->data;
+    for (int i = 0; i < 100; i++)
+        array_append(array, &i);
+    cr_assert_eq(array->data, data);
+    cr_assert_eq(array->size, 100);
+
+    array_reserve(array, 10);
+    cr_assert_eq(array->data, data);
+    for (int i = 0; i < 100; i++)
+        cr_assert_eq(*(int *)array_get(array, i), i);
+
+    array_free(array);
+}
@@ -991,6 +991,53 @@ Test(automaton, automaton_remove_state_tr_from_leaving_eps_and_not)
     automaton_free(automaton);
 }
 
+Test(automaton, automaton_remove_states_renumbers)
+{
+    Automaton *automaton = Automaton(4, 2);
+    State *s[4];
+    for (size_t i = 0; i < 4; i++)
+    {
+        s[i] = State(i == 3);
+        automaton_add_state(automaton, s[i], i < 2);
+    }
+    automaton_add_transition(automaton, s[0], s[1], 'a', 0);
+    automaton_add_transition(automaton, s[0], s[2], 'a', 0);
+    automaton_add_transition(automaton, s[2], s[3], 'b', 0);
+    automaton_add_transition(automaton, s[1], s[3], 'b', 0);
+    automaton_mark_entering(automaton, NULL, s[0], 0, 1, 0);
+    automaton_mark_entering(automaton, NULL, s[1], 0, 1, 1);
+    automaton_mark_entering(automaton, s[0], s[1], 'a', 0, 2);
+    automaton_mark_leaving(automaton, s[2], s[3], 'b', 0, 2);
+    automaton_mark_leaving(automaton, s[3], NULL, 0, 1, 0);
+
+    uint8_t mask[] = { 0, 1, 0, 0 };
+    automaton_remove_states(automaton, mask);
+
+    cr_assert_eq(automaton->size, 3);
+    cr_assert_eq(automaton->states->size, 3);
+    cr_assert_eq(automaton->transition_table->height, 3);
+    cr_assert_eq(automaton->starting_states->size, 1);
+    cr_assert_eq(s[2]->id, 1);
+    cr_assert_eq(s[3]->id, 2);
+
+    cr_assert_eq(automaton_is_transition(automaton, s[0], s[2], 'a', 0), 1);
+    cr_assert_eq(automaton_is_transition(automaton, s[2], s[3], 'b', 0), 1);
+    LinkedList *list = get_matrix_elt(automaton, s[0]->id, 'a', 0);
+    cr_assert_eq(list->next->next, NULL);
+
+    // The tags follow the new ids, the ones touching s[1] are dropped
+    cr_assert_eq(automaton->entering_transitions->size, 1);
+    cr_assert(bitset_contains(
+        get_entering_groups(automaton, NULL, s[0], 0, 1), 0));
+    cr_assert(bitset_contains(
+        get_leaving_group(automaton, s[2], s[3], 'b', 0), 2));
+    cr_assert(bitset_contains(
+        get_leaving_group(automaton, s[3], NULL, 0, 1), 0));
+    cr_assert_eq(automaton->leaving_transitions->size, 2);
+
+    automaton_free(automaton);
+}
+
 /*
     BONUS
 */
@@ -1058,14 +1105,12 @@ Test(automaton, mark_entering_basic)
     automaton_add_transition(automaton, s1, s2, 'A', 0);
     automaton_mark_entering(automaton, s1, s2, 'A', 0, g1);
     
-    Set * res_set = get_entering_groups(automaton, s1, s2, 'A', 0);
+    BitSet * res_set = get_entering_groups(automaton, s1, s2, 'A', 0);
 
     cr_assert_eq(res_set->size, 1, "Expected 1 element inside the set but got: %lu",
         res_set->size);
     
-    size_t * set_content = (size_t *)map_get(res_set, &g1);
-    
-    cr_assert_neq(set_content, NULL);
+    cr_assert(bitset_contains(res_set, g1));
 
     automaton_free(automaton);
 }
@@ -1085,14 +1130,12 @@ Test(automaton, mark_entering_epsilon)
     automaton_add_transition(automaton, s1, s2, 'A', 1);
     automaton_mark_entering(automaton, s1, s2, 'A', 1, g1);
 
-    Set * res_set = get_entering_groups(automaton, s1, s2, 'd', 1);
+    BitSet * res_set = get_entering_groups(automaton, s1, s2, 'd', 1);
 
     cr_assert_eq(res_set->size, 1, "Expected 1 element inside the set but got: %lu",
         res_set->size);
     
-    size_t * set_content = (size_t *)map_get(res_set, &g1);
-    
-    cr_assert_neq(set_content, NULL);
+    cr_assert(bitset_contains(res_set, g1));
 
     cr_assert_eq(get_entering_groups(automaton, s1, s2, 'd', 0), NULL);
     
@@ -1116,11 +1159,11 @@ Test(automaton, mark_entering_multiple_groups)
     automaton_mark_entering(automaton, s1, s2, 'A', 0, g1);
     automaton_mark_entering(automaton, s1, s2, 'A', 0, g2);
 
-    Set * res_set = get_entering_groups(automaton, s1, s2, 'A', 0);    
+    BitSet * res_set = get_entering_groups(automaton, s1, s2, 'A', 0);    
     cr_assert_eq(res_set->size, 2);
 
-    cr_assert_neq(map_get(res_set, &g1), NULL);
-    cr_assert_neq(map_get(res_set, &g2), NULL);
+    cr_assert(bitset_contains(res_set, g1));
+    cr_assert(bitset_contains(res_set, g2));
 
     automaton_free(automaton);
 }
@@ -1137,7 +1180,7 @@ Test(automaton, mark_entering_entry_state)
 
     automaton_mark_entering(automaton, NULL, s1, '0', 0, 4);
     
-    Set * res_set = get_entering_groups(automaton, NULL, s1, 'd', 1);
+    BitSet * res_set = get_entering_groups(automaton, NULL, s1, 'd', 1);
 
     cr_assert_eq(automaton->entering_transitions->size, 1);
     cr_assert_eq(res_set->size, 1);
@@ -1163,10 +1206,10 @@ Test(automaton, marking_leaving_basic)
     automaton_add_transition(automaton, s1, s2, 'A', 0);
     automaton_mark_leaving(automaton, s1, s2, 'A', 0, g1);
 
-    Map * res = get_leaving_group(automaton, s1, s2, 'A', 0);
+    BitSet * res = get_leaving_group(automaton, s1, s2, 'A', 0);
 
     cr_assert_eq(automaton->leaving_transitions->size, 1);
-    cr_assert_neq(map_get(res, &g1), NULL);
+    cr_assert(bitset_contains(res, g1));
 
     automaton_free(automaton);
 }
@@ -1186,10 +1229,10 @@ Test(automaton, marking_leaving_epsilon)
     automaton_add_transition(automaton, s1, s2, 'A', 1);
     automaton_mark_leaving(automaton, s1, s2, 'A', 1, g1);
 
-    Map * res = get_leaving_group(automaton, s1, s2, 'D', 1);
+    BitSet * res = get_leaving_group(automaton, s1, s2, 'D', 1);
 
     cr_assert_eq(automaton->leaving_transitions->size, 1);
-    cr_assert_neq(map_get(res, &g1), NULL);
+    cr_assert(bitset_contains(res, g1));
 
     automaton_free(automaton);
 }
@@ -1284,8 +1327,83 @@ Test(automaton, _mark_to_map_)
     size_t grp = 1;
     automaton_mark_leaving(automaton, s1, NULL, 0, 1, grp);
 
-    Set * set = get_leaving_group(automaton, s1, NULL, 0, 1);
+    BitSet * set = get_leaving_group(automaton, s1, NULL, 0, 1);
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
+}
+
+/*
+    Frozen view tests
+*/
+
+Test(automaton, freeze)
+{
+    Automaton *aut = automaton_create(3, 4);
+    State *s0 = state_create(0);
+    State *s1 = state_create(0);
+    State *s2 = state_create(1);
+    automaton_add_state(aut, s0, 1);
+    automaton_add_state(aut, s1, 0);
+    automaton_add_state(aut, s2, 0);
+    automaton_add_transition(aut, s0, s2, 'b', 0);
+    automaton_add_transition(aut, s0, s1, 'a', 0);
+    automaton_add_transition(aut, s0, s2, 'a', 0);
+    automaton_add_transition(aut, s1, s2, 'x', 1);
+
+    const AutomatonCsr *csr = automaton_freeze(aut);
+    cr_assert_eq(csr, automaton_freeze(aut));
+    cr_assert_eq(csr->size, 3);
+    cr_assert_eq(csr->offsets[0], 0);
+    cr_assert_eq(csr->offsets[1], 3);
+    cr_assert_eq(csr->offsets[2], 4);
+    cr_assert_eq(csr->offsets[3], 4);
+
+    // Sorted by label, in insertion order for a given label
+    cr_assert_eq(csr->edges[0].label, 'a');
+    cr_assert_eq(csr->edges[0].target, 1);
+    cr_assert_eq(csr->edges[1].label, 'a');
+    cr_assert_eq(csr->edges[1].target, 2);
+    cr_assert_eq(csr->edges[2].label, 'b');
+    cr_assert_eq(csr->edges[3].label, EPSILON_INDEX);
+
+    size_t count;
+    const AutomatonEdge *edges = automaton_get_targets(aut, 0, 'a', 0, &count);
+    cr_assert_eq(count, 2);
+    cr_assert_eq(edges[1].target, 2);
+    automaton_get_targets(aut, 0, 'c', 0, &count);
+    cr_assert_eq(count, 0);
+    edges = automaton_get_targets(aut, 1, 0, 1, &count);
+    cr_assert_eq(count, 1);
+    cr_assert_eq(edges->target, 2);
+
+    // Any modification drops the view
+    automaton_add_transition(aut, s2, s0, 'c', 0);
+    cr_assert_eq(aut->csr, NULL);
+    automaton_get_targets(aut, 2, 'c', 0, &count);
+    cr_assert_eq(count, 1);
+
+    automaton_free(aut);
+}
+
+Test(automaton, transition_count)
+{
+    Automaton *aut = automaton_create(3, 4);
+    State *s0 = state_create(0);
+    State *s1 = state_create(0);
+    State *s2 = state_create(1);
+    automaton_add_state(aut, s0, 1);
+    automaton_add_state(aut, s1, 0);
+    automaton_add_state(aut, s2, 0);
+    cr_assert_eq(automaton_transition_count(aut), 0);
+
+    automaton_add_transition(aut, s0, s1, 'a', 0);
+    automaton_add_transition(aut, s0, s2, 'a', 0);
+    automaton_add_transition(aut, s1, s2, 'x', 1);
+    cr_assert_eq(automaton_transition_count(aut), 3);
+
+    automaton_remove_transition(aut, s0, s2, 'a', 0);
+    cr_assert_eq(automaton_transition_count(aut), 2);
+
+    automaton_free(aut);
 }
@@ -0,0 +1,188 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <string.h>
+
+#include "automaton/backtrack.h"
+#include "matching/matching.h"
+#include "parsing/lexer.h"
+#include "parsing/parsing.h"
+
+static Backtracker *build(const char *pattern)
+{
+    Array *tokens = tokenize((char *)pattern);
+    BinTree *tree = parse_symbols(tokens);
+    Backtracker *backtracker = backtracker_build(tree, tokens);
+    bintree_free(tree);
+    array_free(tokens);
+    return backtracker;
+}
+
+Test(backtrack, groups)
+{
+    Backtracker *backtracker = build("(\\w+)=(\\d+)");
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    cr_assert_eq(search_backtrack_scratch(backtracker, "a=1 bc=22 d=", scratch),
+                 2);
+    const Match *matches = scratch->matches->data;
+    cr_assert_eq(matches[1].start, 4);
+    cr_assert_eq(matches[1].length, 5);
+    cr_assert_str_eq(matches[1].groups[1], "bc");
+    cr_assert_str_eq(matches[1].groups[2], "22");
+
+    const Match *match = match_backtrack_scratch(backtracker, "key=42", scratch);
+    cr_assert_neq(match, NULL);
+    cr_assert_eq(match->length, 6);
+    cr_assert_str_eq(match->groups[1], "key");
+    cr_assert_str_eq(match->groups[2], "42");
+    cr_assert_eq(match_backtrack_scratch(backtracker, "=42", scratch), NULL);
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, leftmost_longest)
+{
+    Backtracker *backtracker = build("(ab|a)(bc|c)");
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    cr_assert_eq(search_backtrack_scratch(backtracker, "xabcabc ac", scratch),
+                 3);
+    const Match *matches = scratch->matches->data;
+    cr_assert_eq(matches[0].start, 1);
+    cr_assert_eq(matches[0].length, 3);
+    cr_assert_eq(matches[1].start, 4);
+    cr_assert_eq(matches[2].start, 8);
+    cr_assert_eq(matches[2].length, 2);
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, no_exponential_blowup)
+{
+    Backtracker *backtracker = build("(a|a)*(a|a)*b");
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    // Every (state, position) pair is explored once
+    char string[513];
+    memset(string, 'a', 512);
+    string[512] = 0;
+    cr_assert_eq(search_backtrack_scratch(backtracker, string, scratch), 0);
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, capture_match)
+{
+    Backtracker *backtracker = build("(\\w+)=(\\d+)");
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    // Only the bounds of the match are explored, not the rest of the string
+    Match match = {
+        .string = "x=1 ab=23c", .start = 4, .length = 5, .nb_groups = 0,
+        .groups = NULL,
+    };
+    const Match *captured = capture_match_scratch(
+        NULL, backtracker, backtracker->nb_groups, &match, scratch);
+    cr_assert_eq(captured->start, 4);
+    cr_assert_eq(captured->length, 5);
+    cr_assert_str_eq(captured->groups[1], "ab");
+    cr_assert_str_eq(captured->groups[2], "23");
+    cr_assert_eq(match.groups, NULL);
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, max_length)
+{
+    Backtracker *backtracker = build("(ab)c");
+
+    cr_assert_eq(backtracker_max_length(backtracker), BACKTRACK_MAX_LENGTH);
+    backtracker->size = BACKTRACK_MAX_BITS / 101;
+    cr_assert_eq(backtracker_max_length(backtracker), 100);
+    backtracker->size = BACKTRACK_MAX_BITS + 1;
+    cr_assert_eq(backtracker_max_length(backtracker), 0);
+    cr_assert_eq(backtracker_max_length(NULL), 0);
+
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, repeated_groups)
+{
+    Backtracker *backtracker = build("(x|y)*z");
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    // A repeated group captures its last iteration
+    const Match *match = match_backtrack_scratch(backtracker, "xyxz", scratch);
+    cr_assert_neq(match, NULL);
+    cr_assert_str_eq(match->groups[1], "x");
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+
+    // and is unmatched when repeated zero times
+    backtracker = build("(a|b)*abb");
+    scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+    match = match_backtrack_scratch(backtracker, "abb", scratch);
+    cr_assert_neq(match, NULL);
+    cr_assert_eq(match->groups[1], NULL);
+    match = match_backtrack_scratch(backtracker, "babb", scratch);
+    cr_assert_str_eq(match->groups[1], "b");
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+/**
+ * Match a pattern against a string, and check its groups from the first
+ * one. NULL stands for a group that did not take part in the match.
+ */
+static void assert_groups(const char *pattern, const char *string,
+                          size_t nb_groups, const char *groups[])
+{
+    Backtracker *backtracker = build(pattern);
+    MatchScratch *scratch = match_scratch_create(0, backtracker->nb_groups, 2);
+
+    const Match *match = match_backtrack_scratch(backtracker, string, scratch);
+    cr_assert_neq(match, NULL, "%s on %s", pattern, string);
+    cr_assert_eq(match->length, strlen(string), "%s on %s", pattern, string);
+    cr_assert_eq(match->nb_groups, nb_groups + 1);
+    for (size_t i = 0; i < nb_groups; i++)
+    {
+        if (groups[i] == NULL)
+            cr_assert_eq(match->groups[i + 1], NULL, "%s on %s: group %zu",
+                         pattern, string, i + 1);
+        else
+            cr_assert_str_eq(match->groups[i + 1], groups[i],
+                             "%s on %s: group %zu", pattern, string, i + 1);
+    }
+
+    match_scratch_free(scratch);
+    backtracker_free(backtracker);
+}
+
+Test(backtrack, alternation_groups)
+{
+    // The groups of the alternatives the match does not take stay unmatched
+    assert_groups("x|(a)", "x", 1, (const char *[]){ NULL });
+    assert_groups("x|(a)", "a", 1, (const char *[]){ "a" });
+    assert_groups("(a)|(b)", "b", 2, (const char *[]){ NULL, "b" });
+    assert_groups(".|([bc])a", "x", 1, (const char *[]){ NULL });
+    assert_groups(".|([bc])a", "ba", 1, (const char *[]){ "b" });
+    assert_groups("(b)|[ca]", "c", 1, (const char *[]){ NULL });
+    assert_groups("a*|(.)*[bc]{1,2}", "aabbaabbxc", 1,
+                  (const char *[]){ "x" });
+    assert_groups("a*|(.)*[bc]{1,2}", "aaa", 1, (const char *[]){ NULL });
+}
+
+Test(backtrack, group_extents)
+{
+    // The groups are told apart from the quantifiers around them
+    assert_groups("(\\w+)", "abc", 1, (const char *[]){ "abc" });
+    assert_groups("(\\w)+", "abc", 1, (const char *[]){ "c" });
+    assert_groups("((a)|b)+", "ab", 2, (const char *[]){ "b", "a" });
+    assert_groups("(?:a|(b))+c", "bac", 1, (const char *[]){ "b" });
+}
@@ -0,0 +1,116 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "automaton/automaton.h"
+#include "automaton/codegen.h"
+#include "utils/errors.h"
+
+#define GEN_DIR "/tmp/rationl_codegen_XXXXXX"
+
+static const char *driver =
+    "#include <stdio.h>\n"
+    "#include \"gen.c\"\n"
+    "int main(int argc, char **argv)\n"
+    "{\n"
+    "    struct gen_result result;\n"
+    "    size_t from = 0;\n"
+    "    printf(\"%ld\", gen_match(argv[1]));\n"
+    "    while (gen_search(argv[1], from, &result))\n"
+    "    {\n"
+    "        printf(\" %zu:%zu\", result.start, result.length);\n"
+    "        for (int i = 0; i < GEN_NB_GROUPS; i++)\n"
+    "            printf(\" [%.*s]\",\n"
+    "                   (int)(result.groups[2 * i + 1] - result.groups[2 * i]),\n"
+    "                   argv[1] + result.groups[2 * i]);\n"
+    "        from = result.start + result.length;\n"
+    "    }\n"
+    "    (void)argc;\n"
+    "    return 0;\n"
+    "}\n";
+
+/**
+ * Generate the code of a daut file, compile it with a driver printing the
+ * result of gen_match then of every gen_search on the input and compare
+ * the output.
+ */
+static void assert_generated(const char *daut, size_t size, const char *input,
+                             const char *expected)
+{
+    char dir[] = GEN_DIR;
+    cr_assert_neq(mkdtemp(dir), NULL);
+    char path[256];
+    char command[1024];
+
+    Automaton *aut = automaton_from_daut(daut, size);
+    sprintf(path, "%s/gen.c", dir);
+    FILE *file = fopen(path, "w");
+    cr_assert_eq(codegen_write(aut, "a*/b", "gen", file), 0);
+    fclose(file);
+    automaton_free(aut);
+
+    sprintf(path, "%s/driver.c", dir);
+    file = fopen(path, "w");
+    fputs(driver, file);
+    fclose(file);
+
+    sprintf(command,
+            "cc -std=c99 -Wall -Werror -o %s/driver %s/driver.c"
+            " && %s/driver '%s' > %s/out",
+            dir, dir, dir, input, dir);
+    cr_assert_eq(system(command), 0, "could not compile or run %s", dir);
+
+    char output[256] = { 0 };
+    sprintf(path, "%s/out", dir);
+    file = fopen(path, "r");
+    fread(output, 1, sizeof(output) - 1, file);
+    fclose(file);
+    cr_assert_str_eq(output, expected);
+
+    sprintf(command, "rm -rf %s", dir);
+    system(command);
+}
+
+Test(codegen, linear)
+{
+    assert_generated(TEST_PATH "automaton/abcdabd.daut", 8,
+                     "abcdabdxxabcdabcdabd", "7 0:7 13:7");
+}
+
+Test(codegen, alternative)
+{
+    assert_generated(TEST_PATH "automaton/a+b.daut", 3, "acba",
+                     "1 0:1 2:1 3:1");
+}
+
+Test(codegen, groups)
+{
+    assert_generated(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5,
+        "xabaaca", "-1 1:3 [aba] [ab] [b] 4:3 [aca] [ac] [c]");
+}
+
+Test(codegen, invalid_prefix)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    FILE *file = fopen("/dev/null", "w");
+    rationl_errno = 0;
+    cr_assert_eq(codegen_write(aut, NULL, "0gen", file), -1);
+    cr_assert_eq(rationl_errno, EBADFMT);
+    fclose(file);
+    automaton_free(aut);
+}
+
+Test(codegen, not_deterministic)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/multiple.daut", 4);
+    FILE *file = fopen("/dev/null", "w");
+    rationl_errno = 0;
+    cr_assert_eq(codegen_write(aut, NULL, "gen", file), -1);
+    cr_assert_eq(rationl_errno, EBADFMT);
+    fclose(file);
+    automaton_free(aut);
+}
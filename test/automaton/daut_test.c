@@ -62,29 +62,11 @@ Test(daut, abba)
     automaton_free(abba);
 }
 
-static void assert_set_eq(Set *s1, Set *s2)
+static void assert_set_eq(BitSet *s1, BitSet *s2)
 {
     if (s1 == NULL || s2 == NULL)
         cr_assert_eq(s1, s2, "s1 == %p, s2 == %p", s1, s2);
-    cr_assert_eq(s1->buckets->size, s2->buckets->size);
-
-    for (size_t i = 0; i < s1->buckets->size; i++)
-    {
-        LinkedList *bucket1 = *(LinkedList **)array_get(s1->buckets, i);
-        LinkedList *bucket2 = *(LinkedList **)array_get(s2->buckets, i);
-        while (bucket1->next != NULL && bucket2->next != NULL)
-        {
-            MapNode *node1 = *(MapNode **)bucket1->next->data;
-            MapNode *node2 = *(MapNode **)bucket2->next->data;
-
-            size_t *x1 = node1->key;
-            size_t *x2 = node2->key;
-            cr_assert_eq(*x1, *x2);
-
-            bucket1 = bucket1->next;
-            bucket2 = bucket2->next;
-        }
-    }
+    cr_assert_eq(compare_bitsets(&s1, &s2), 0);
 }
 
 Test(daut, special_transitions)
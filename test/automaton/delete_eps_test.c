@@ -579,7 +579,7 @@ Test(delete_eps, basic_moving_entries)
     Automaton * automaton = automaton_from_daut("automaton/basic_test.daut", 5);
 
     size_t g1 = 1;
-    Map * set;
+    BitSet * set;
     //retrieving states:
     State * s[5];
     for(int i = 0; i < 5; i++)
@@ -598,7 +598,7 @@ Test(delete_eps, basic_moving_entries)
 
     set = get_entering_groups(automaton, NULL, s[0], 0, 1);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     automaton_free(automaton);
 }
@@ -609,7 +609,7 @@ Test(delete_eps, basic_moving_leaving)
     Automaton * automaton = automaton_from_daut("automaton/basic_test.daut", 5);
 
     size_t g1 = 1;
-    Map * set;
+    BitSet * set;
     //retrieving states:
     State * s[5];
     for(int i = 0; i < 5; i++)
@@ -626,7 +626,7 @@ Test(delete_eps, basic_moving_leaving)
 
     set = get_leaving_group(automaton, s[2], s[4], 'b', 0);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     automaton_free(automaton);
 }
@@ -636,7 +636,7 @@ Test(delete_eps, moving_entering_eps_entering)
     Automaton * automaton = automaton_from_daut("automaton/entering_eps.daut", 5);
 
     size_t g1 = 1;
-    Map * set;
+    BitSet * set;
     //retrieving states:
     State * s[5];
     for(int i = 0; i < 5; i++)
@@ -659,7 +659,7 @@ Test(delete_eps, moving_entering_eps_entering)
 
     set = get_entering_groups(automaton, NULL, s[0], 'a', 1);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     automaton_free(automaton);
 }
@@ -669,7 +669,7 @@ Test(delete_eps, test_moving_leaving_back)
     Automaton * automaton = automaton_from_daut("automaton/entering_eps.daut", 5);
 
     size_t g1 = 1;
-    Map * set;
+    BitSet * set;
     //retrieving states:
     State * s[5];
     for(int i = 0; i < 5; i++)
@@ -685,7 +685,7 @@ Test(delete_eps, test_moving_leaving_back)
 
     set = get_leaving_group(automaton, s[3], NULL, 'a', 0);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     automaton_free(automaton);
 }
@@ -695,7 +695,7 @@ Test(delete_eps, test_jump_leaving)
     Automaton * automaton = automaton_from_daut("automaton/jump_leaving.daut", 5);
 
     size_t g1 = 1;
-    Map * set;
+    BitSet * set;
     //retrieving states:
     State * s[3];
     for(int i = 0; i < 3; i++)
@@ -711,11 +711,11 @@ Test(delete_eps, test_jump_leaving)
 
     set = get_leaving_group(automaton, s[0], s[2], 'a', 0);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     set = get_leaving_group(automaton, s[1], s[2], 'a', 0);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g1), NULL);
+    cr_assert(bitset_contains(set, g1));
 
     automaton_free(automaton);
 }
@@ -48,3 +48,23 @@ Test(determine, a_b_or_c_a)
     automaton_free(determined);
     automaton_free(expected);
 }
+
+Test(determine, bounded)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a).daut", 6);
+    Automaton *expected = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+
+    DeterminizeBudget budget = { .max_states = 4, .max_bytes = 0,
+                                 .base_bytes = 0 };
+    cr_assert_eq(determine_bounded(aut, &budget), NULL);
+
+    budget.max_states = expected->size;
+    Automaton *determined = determine_bounded(aut, &budget);
+    ASSERT_AUTOMATON_EQ(expected, determined);
+
+    automaton_free(aut);
+    automaton_free(determined);
+    automaton_free(expected);
+}
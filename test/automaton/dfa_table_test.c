@@ -0,0 +1,233 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "automaton/automaton.h"
+#include "automaton/dfa_table.h"
+#include "matching/matching.h"
+#include "utils/errors.h"
+
+static char *temp_path(void)
+{
+    static char path[] = "/tmp/rationl_dfa_table_XXXXXX";
+    strcpy(path + strlen(path) - 6, "XXXXXX");
+    int fd = mkstemp(path);
+    cr_assert_neq(fd, -1);
+    close(fd);
+    return path;
+}
+
+static void corrupt_byte(const char *path, long offset)
+{
+    FILE *file = fopen(path, "r+b");
+    fseek(file, offset, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(c ^ 0xff, file);
+    fclose(file);
+}
+
+Test(dfa_table, build)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    DfaTable *table = dfa_table_build(aut, "abcdabd");
+
+    cr_assert_neq(table, NULL);
+    cr_assert_eq(table->size, 8);
+    cr_assert_eq(table->start, 0);
+    cr_assert_str_eq(table->pattern, "abcdabd");
+    cr_assert_eq(table->transitions['a'], 1);
+    cr_assert_eq(table->transitions['b'], DFA_NO_STATE);
+    cr_assert_eq(table->transitions[6 * DFA_TABLE_ALPHABET + 'd'], 7);
+    for (size_t i = 0; i < table->size; i++)
+        cr_assert_eq(table->terminal[i], i == 7);
+
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(dfa_table, build_not_deterministic)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/multiple.daut", 4);
+    cr_assert_eq(dfa_table_build(aut, NULL), NULL);
+    automaton_free(aut);
+}
+
+Test(dfa_table, match_and_replace)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    DfaTable *table = dfa_table_build(aut, NULL);
+
+    Match *match = match_table(table, "abcdabdd");
+    cr_assert_neq(match, NULL);
+    cr_assert_eq(match->length, 7);
+    free_match(match);
+    cr_assert_eq(match_table(table, "xabcdabd"), NULL);
+
+    char *replaced = replace_table(table, "xxabcdabdyabcdabd", "-");
+    cr_assert_str_eq(replaced, "xx-y-");
+    free(replaced);
+
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(dfa_table, search_groups)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, NULL);
+
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    Array *matches = search_table(table, "xabaaca", scratch);
+    cr_assert_eq(matches->size, 2, "expected 2, got %zu", matches->size);
+
+    Match *match = *(Match **)array_get(matches, 0);
+    cr_assert_eq(match->start, 1);
+    cr_assert_eq(match->length, 3);
+    cr_assert_eq(match->nb_groups, 3);
+    cr_assert_str_eq(match->groups[0], "aba");
+    cr_assert_str_eq(match->groups[1], "ab");
+    cr_assert_str_eq(match->groups[2], "b");
+
+    match = *(Match **)array_get(matches, 1);
+    cr_assert_eq(match->start, 4);
+    cr_assert_str_eq(match->groups[0], "aca");
+    cr_assert_str_eq(match->groups[2], "c");
+
+    arr_foreach(Match *, m, matches) free_match(m);
+    array_free(matches);
+    match_scratch_free(scratch);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(dfa_table, search_scratch_reuse)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+
+    // Nothing from a search leaks into the next one
+    for (size_t i = 0; i < 3; i++)
+    {
+        Array *matches = search_table(table, i == 1 ? "acab" : "xabaaca",
+                                      scratch);
+        cr_assert_eq(matches->size, i == 1 ? 1 : 2);
+        Match *match = *(Match **)array_get(matches, 0);
+        cr_assert_str_eq(match->groups[0], i == 1 ? "aca" : "aba");
+        cr_assert_str_eq(match->groups[2], i == 1 ? "c" : "b");
+        arr_foreach(Match *, m, matches) free_match(m);
+        array_free(matches);
+    }
+
+    match_scratch_free(scratch);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+static void *search_thread(void *table)
+{
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    size_t failures = 0;
+    for (size_t i = 0; i < 200; i++)
+    {
+        Array *matches = search_table(table, "xabaacaaba", scratch);
+        failures += matches->size != 3;
+        arr_foreach(Match *, m, matches)
+        {
+            failures += strcmp(m->groups[1], m->start == 4 ? "ac" : "ab") != 0;
+            free_match(m);
+        }
+        array_free(matches);
+    }
+    match_scratch_free(scratch);
+
+    return (void *)failures;
+}
+
+Test(dfa_table, search_shared_between_threads)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, NULL);
+
+    pthread_t threads[8];
+    for (size_t i = 0; i < 8; i++)
+        cr_assert_eq(pthread_create(threads + i, NULL, search_thread, table),
+                     0);
+    for (size_t i = 0; i < 8; i++)
+    {
+        void *failures;
+        pthread_join(threads[i], &failures);
+        cr_assert_eq((size_t)failures, 0);
+    }
+
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(dfa_table, save_load)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, "(a(b|c))a");
+    char *path = temp_path();
+
+    cr_assert_eq(dfa_table_save(table, path), 0);
+    DfaTable *loaded = dfa_table_load(path);
+    cr_assert_neq(loaded, NULL);
+    cr_assert(loaded->mapped);
+    cr_assert_eq(loaded->size, table->size);
+    cr_assert_eq(loaded->start, table->start);
+    cr_assert_eq(loaded->nb_groups, table->nb_groups);
+    cr_assert_eq(loaded->tag_count, table->tag_count);
+    cr_assert_str_eq(loaded->pattern, "(a(b|c))a");
+    cr_assert_eq(memcmp(loaded->transitions, table->transitions,
+                        table->size * DFA_TABLE_ALPHABET * sizeof(int32_t)),
+                 0);
+
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    Array *matches = search_table(loaded, "aba", scratch);
+    cr_assert_eq(matches->size, 1);
+    Match *match = *(Match **)array_get(matches, 0);
+    cr_assert_str_eq(match->groups[1], "ab");
+    free_match(match);
+    array_free(matches);
+    match_scratch_free(scratch);
+
+    dfa_table_free(loaded);
+    dfa_table_free(table);
+    automaton_free(aut);
+    unlink(path);
+}
+
+Test(dfa_table, load_corrupted)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    char *path = temp_path();
+
+    dfa_table_save(table, path);
+    corrupt_byte(path, table->image_size - 1);
+    rationl_errno = 0;
+    cr_assert_eq(dfa_table_load(path), NULL);
+    cr_assert_eq(rationl_errno, EBADSUM);
+
+    dfa_table_save(table, path);
+    corrupt_byte(path, offsetof(DfaImageHeader, version));
+    cr_assert_eq(dfa_table_load(path), NULL);
+    cr_assert_eq(rationl_errno, EBADVER);
+
+    cr_assert_eq(dfa_table_load(TEST_PATH "automaton/abcdabd.daut"), NULL);
+    cr_assert_eq(rationl_errno, EBADFMT);
+
+    dfa_table_free(table);
+    automaton_free(aut);
+    unlink(path);
+}
@@ -0,0 +1,118 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include "config.h"
+#include "automaton/automaton.h"
+#include "automaton/dfa_table.h"
+#include "automaton/jit.h"
+#include "matching/matching.h"
+
+#if defined(ENABLE_JIT) && defined(__x86_64__)
+
+/**
+ * Compare the native code of a table with the table itself on an input.
+ */
+static void assert_same_match(DfaTable *table, DfaJit *jit, const char *input)
+{
+    table->jit = NULL;
+    Match *expected = match_table(table, input);
+    long length = jit->run((const unsigned char *)input);
+
+    if (expected == NULL)
+        cr_assert_eq(length, -1, "'%s': expected no match, got %ld", input,
+                     length);
+    else
+        cr_assert_eq(length, (long)expected->length,
+                     "'%s': expected %zu, got %ld", input, expected->length,
+                     length);
+    free_match(expected);
+}
+
+/**
+ * A loop on state 0 alternating between letters going to the terminal
+ * state 1 and letters going back to 0, so that the start state is
+ * dispatched with a jump table.
+ */
+static Automaton *dense_automaton(void)
+{
+    Automaton *aut = automaton_create(2, 27);
+    State *s0 = state_create(0);
+    State *s1 = state_create(1);
+    automaton_add_state(aut, s0, 1);
+    automaton_add_state(aut, s1, 0);
+    for (int letter = 'a'; letter <= 'z'; letter++)
+        automaton_add_transition(aut, s0, letter % 2 ? s1 : s0, letter, 0);
+    automaton_add_transition(aut, s1, s0, '-', 0);
+
+    return aut;
+}
+
+Test(jit, linear)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    DfaJit *jit = dfa_jit_compile(table);
+    cr_assert_neq(jit, NULL);
+
+    const char *inputs[] = { "", "a", "abcdab", "abcdabd", "abcdabdabcd",
+                             "xabcdabd", "abcdabd\xff" };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(*inputs); i++)
+        assert_same_match(table, jit, inputs[i]);
+
+    dfa_jit_free(jit);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(jit, jump_table)
+{
+    Automaton *aut = dense_automaton();
+    DfaTable *table = dfa_table_build(aut, NULL);
+    DfaJit *jit = dfa_jit_compile(table);
+    cr_assert_neq(jit, NULL);
+
+    const char *inputs[] = { "", "a", "b", "bbba", "bbbab", "a-ba-c-",
+                             "a-bz", "zzzz-", "A", "\x80" };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(*inputs); i++)
+        assert_same_match(table, jit, inputs[i]);
+
+    dfa_jit_free(jit);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(jit, search)
+{
+    Automaton *aut = dense_automaton();
+    DfaTable *table = dfa_table_build(aut, NULL);
+    table->jit = dfa_jit_compile(table);
+
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    Array *matches = search_table(table, "A-bbaC a-c", scratch);
+    cr_assert_eq(matches->size, 2);
+    Match *match = *(Match **)array_get(matches, 0);
+    cr_assert_eq(match->start, 2);
+    cr_assert_eq(match->length, 3);
+    match = *(Match **)array_get(matches, 1);
+    cr_assert_eq(match->start, 7);
+    cr_assert_eq(match->length, 3);
+
+    arr_foreach(Match *, m, matches) free_match(m);
+    array_free(matches);
+    match_scratch_free(scratch);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+#else
+
+Test(jit, unavailable)
+{
+    Automaton *aut = automaton_from_daut(TEST_PATH "automaton/abcdabd.daut", 8);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    cr_assert_eq(dfa_jit_compile(table), NULL);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+#endif
@@ -491,7 +491,6 @@ Test(replace, abstara)
     automaton_free(aut);
 }
 
-/*
 Test(replace, comma)
 {
     Array *tokens = tokenize(", *");
@@ -510,4 +509,102 @@ Test(replace, comma)
 
     automaton_free(aut);
 }
-*/
\ No newline at end of file
+
+Test(scratch, nfa_reuse)
+{
+    Array *tokens = tokenize("(ab|c)*d");
+    BinTree *b = parse_symbols(tokens);
+    Automaton *aut = thompson(b);
+    MatchScratch *scratch = match_scratch_create(aut->size, 0, 4);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        const Match *match = match_nfa_scratch(aut, "abcabd", scratch);
+        cr_assert_neq(match, NULL);
+        cr_assert_eq(match->length, 6);
+        cr_assert_eq(match_nfa_scratch(aut, "abca", scratch), NULL);
+
+        cr_assert_eq(search_nfa_scratch(aut, "xcd abd d", scratch), 3);
+        const Match *matches = scratch->matches->data;
+        cr_assert_eq(matches[0].start, 1);
+        cr_assert_eq(matches[1].length, 3);
+        cr_assert_eq(matches[2].start, 8);
+
+        cr_assert_str_eq(replace_nfa_scratch(aut, "xcd abd d", "-", scratch),
+                         "x- - -");
+    }
+
+    match_scratch_free(scratch);
+    automaton_free(aut);
+}
+
+Test(scratch, table_buffers_kept)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    MatchScratch *scratch = match_scratch_create(0, table->nb_groups, 2);
+
+    cr_assert_eq(search_table_scratch(table, "xabaaca", scratch), 2);
+    void *matches = scratch->matches->data;
+    void *text = scratch->text->data;
+
+    // Once the buffers fit, the same searches do not reallocate them
+    for (size_t i = 0; i < 10; i++)
+    {
+        cr_assert_eq(search_table_scratch(table, "acaxaba", scratch), 2);
+        cr_assert_eq(scratch->matches->data, matches);
+        cr_assert_eq(scratch->text->data, text);
+        const Match *match = (const Match *)scratch->matches->data + 1;
+        cr_assert_eq(match->start, 4);
+        cr_assert_str_eq(match->groups[0], "aba");
+        cr_assert_str_eq(match->groups[2], "b");
+    }
+
+    match_scratch_free(scratch);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(scratch, capture_timed)
+{
+    Automaton *aut = automaton_from_daut(
+        TEST_PATH "automaton/determine_daut/((a(b|c))a)_determined.daut", 5);
+    DfaTable *table = dfa_table_build(aut, NULL);
+    MatchScratch *scratch = match_scratch_create(0, table->nb_groups, 2);
+
+    search_table_scratch(table, "xabaaca", scratch);
+    cr_assert_eq(scratch->capture_seconds, 0);
+
+    scratch->timed = 1;
+    search_table_scratch(table, "xabaaca", scratch);
+    cr_assert_gt(scratch->capture_seconds, 0);
+
+    match_scratch_free(scratch);
+    dfa_table_free(table);
+    automaton_free(aut);
+}
+
+Test(scratch, literal)
+{
+    MatchScratch *scratch = match_scratch_create(0, 0, 2);
+
+    const Match *match = match_literal_scratch("ab", "abc", scratch);
+    cr_assert_neq(match, NULL);
+    cr_assert_eq(match->length, 2);
+    cr_assert_eq(match_literal_scratch("ab", "acb", scratch), NULL);
+
+    cr_assert_eq(search_literal_scratch("aa", "aaaa baa", scratch), 3);
+    const Match *matches = scratch->matches->data;
+    cr_assert_eq(matches[1].start, 2);
+    cr_assert_eq(matches[2].start, 6);
+    cr_assert_eq(search_literal_scratch("", "aaaa", scratch), 0);
+
+    cr_assert_str_eq(replace_literal_scratch("aa", "aaaa baa", "-", scratch),
+                     "-- b-");
+    cr_assert_eq(scratch->replacements, 3);
+    cr_assert_str_eq(replace_literal_scratch("", "aaaa", "-", scratch),
+                     "aaaa");
+
+    match_scratch_free(scratch);
+}
@@ -170,7 +170,7 @@ Test(thompson, group_concat)
     {
         s[i] = *(State **)array_get(automaton->states, i);
     }
-    Set * set;
+    BitSet * set;
 
     cr_assert_eq(get_entering_groups(automaton, s[2], s[3], 'b', 0), NULL);
     cr_assert_eq(get_entering_groups(automaton, s[3], s[0], 0, 1), NULL);
@@ -179,7 +179,7 @@ Test(thompson, group_concat)
     set = get_entering_groups(automaton, NULL, s[2], 0, 1);
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g), NULL);
+    cr_assert(bitset_contains(set, g));
 
     //leaving:
     cr_assert_eq(get_leaving_group(automaton, NULL, s[2], 'b', 0), NULL);
@@ -189,7 +189,7 @@ Test(thompson, group_concat)
     set = get_leaving_group(automaton, s[3], s[0], 0, 1);
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &g), NULL);
+    cr_assert(bitset_contains(set, g));
 
     automaton_free(automaton);
     array_free(arr);
@@ -204,7 +204,7 @@ Test(thompson, simple)
     Automaton *aut = thompson(b);
     State * s0 = *(State **)array_get(aut->states, 0);
     State * s1 = *(State **)array_get(aut->states, 1);
-    Map * set;
+    BitSet * set;
 
     cr_assert_eq(get_leaving_group(aut, s0, s1, 'a', 0), NULL);
     set = get_entering_groups(aut, NULL, s0, 0, 1), NULL;
@@ -236,7 +236,7 @@ Test(thompson, simple_a_b)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
     //automaton_to_dot(aut);
     
@@ -267,7 +267,7 @@ Test(thompson, verifying_not_gettting_out_of_0)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
     //automaton_to_dot(aut);
 
@@ -291,7 +291,7 @@ Test(thompson, full_union)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
    // automaton_to_dot(aut);
 
@@ -319,7 +319,7 @@ Test(thompson, union_isolate_right)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
 //    automaton_to_dot(aut);
 
@@ -347,7 +347,7 @@ Test(thompson, union_isolate_left)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
 //    automaton_to_dot(aut);
 
@@ -377,7 +377,7 @@ Test(thompson, flex_1)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
     //automaton_to_dot(aut);
 
@@ -391,19 +391,19 @@ Test(thompson, flex_1)
     grp = 1;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     set = get_entering_groups(aut, s[10], s[8], 0, 1);
     grp = 2;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
     
     set = get_entering_groups(aut, s[9], s[6], 0, 1);
     grp = 3;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     //go for leaving
 
@@ -411,15 +411,15 @@ Test(thompson, flex_1)
     cr_assert_neq(set, NULL);
     grp = 1;
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     set = get_leaving_group(aut, s[5], s[11], 0, 1);
     cr_assert_neq(set, NULL);
     grp = 2;
     cr_assert_eq(set->size, 2);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
     grp = 3;
-    cr_assert_neq(map_get(set, &grp), NULL); 
+    cr_assert(bitset_contains(set, grp)); 
 
     automaton_free(aut);
     array_free(arr);
@@ -438,7 +438,7 @@ Test(thompson, testtttt)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
 
     cr_assert_eq(aut->leaving_transitions->size, 1);
     cr_assert_eq(aut->entering_transitions->size, 1);
@@ -471,7 +471,7 @@ Test(thompson, keepsinternals)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
     size_t grp;
     cr_assert_eq(aut->leaving_transitions->size, 2);
     cr_assert_eq(aut->entering_transitions->size, 2);
@@ -481,26 +481,26 @@ Test(thompson, keepsinternals)
     grp = 2;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     set = get_entering_groups(aut, NULL, s[8], 0, 1);
     grp = 1;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     //lets go for leaaaaaving
     set = get_leaving_group(aut, s[3], s[0], 0, 1);
     grp = 2;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     set = get_leaving_group(aut, s[9], NULL, 0, 1);
     grp = 1;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     automaton_free(aut);
     array_free(arr);
@@ -521,7 +521,7 @@ Test(thompson, testttt)
     {
         s[i] = *(State **)array_get(aut->states, i);
     }
-    Set * set;
+    BitSet * set;
     size_t grp = 1;
 
     cr_assert_eq(aut->leaving_transitions->size, 1);
@@ -531,13 +531,13 @@ Test(thompson, testttt)
     grp = 1;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     set = get_leaving_group(aut, s[4], NULL, 0, 1);
     grp = 1;
     cr_assert_neq(set, NULL);
     cr_assert_eq(set->size, 1);
-    cr_assert_neq(map_get(set, &grp), NULL);
+    cr_assert(bitset_contains(set, grp));
 
     automaton_free(aut);
     array_free(arr);
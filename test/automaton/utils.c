@@ -3,7 +3,7 @@
 #include <criterion/criterion.h>
 #include <criterion/internal/assert.h>
 
-static void assert_set_eq(size_t line, Set *s1, Set *s2);
+static void assert_set_eq(size_t line, BitSet *s1, BitSet *s2);
 
 void assert_automaton_eq_(size_t line, Automaton *a1, Automaton *a2)
 {
@@ -113,43 +113,16 @@ void assert_automaton_eq_(size_t line, Automaton *a1, Automaton *a2)
         }
 }
 
-static void assert_set_eq(size_t line, Set *s1, Set *s2)
+static void assert_set_eq(size_t line, BitSet *s1, BitSet *s2)
 {
     if (s1 == NULL || s2 == NULL)
     {
         cr_assert_eq(s1, s2, "s1 == %p, s2 == %p (line %zu)", s1, s2, line);
         return;
     }
-    if (s1->buckets == NULL || s2->buckets == NULL)
-    {
-        cr_assert_eq(s1->buckets, s2->buckets,
-                     "s1->buckets == %p, s2->buckets == %p (line %zu)", s1, s2,
-                     line);
-        return;
-    }
-    cr_assert_eq(
-        s1->buckets->size, s2->buckets->size,
-        "first bucket has size %zu, second bucket has size %zu (line %zu)",
-        s1->buckets->size, s2->buckets->size, line);
-
-    for (size_t i = 0; i < s1->buckets->size; i++)
-    {
-        LinkedList *bucket1 = *(LinkedList **)array_get(s1->buckets, i);
-        LinkedList *bucket2 = *(LinkedList **)array_get(s2->buckets, i);
-        while (bucket1->next != NULL && bucket2->next != NULL)
-        {
-            MapNode *node1 = *(MapNode **)bucket1->next->data;
-            MapNode *node2 = *(MapNode **)bucket2->next->data;
-
-            size_t *x1 = node1->key;
-            size_t *x2 = node2->key;
-            cr_assert_eq(*x1, *x2, "%zu != %zu (line %zu)\n", *x1, *x2, line);
-
-            bucket1 = bucket1->next;
-            bucket2 = bucket2->next;
-        }
-        cr_assert_eq(bucket1->next, bucket2->next,
-                     "First bucket is greater than the second (line %zu)\n",
-                     line);
-    }
+    cr_assert_eq(s1->size, s2->size,
+                 "first set has size %zu, second set has size %zu (line %zu)",
+                 s1->size, s2->size, line);
+    cr_assert_eq(compare_bitsets(&s1, &s2), 0,
+                 "the sets are different (line %zu)\n", line);
 }
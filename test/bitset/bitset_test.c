@@ -0,0 +1,125 @@
+#include <criterion/criterion.h>
+#include <string.h>
+#include "datatypes/bitset.h"
+#include "datatypes/map.h"
+
+Test(bitset, add_contains)
+{
+    BitSet *set = BitSet(0);
+
+    bitset_add(set, 3);
+    bitset_add(set, 200);
+    bitset_add(set, 3);
+
+    cr_assert_eq(set->size, 2);
+    cr_assert(bitset_contains(set, 3));
+    cr_assert(bitset_contains(set, 200));
+    cr_assert_not(bitset_contains(set, 4));
+    cr_assert_not(bitset_contains(set, 10000));
+
+    bitset_remove(set, 3);
+    bitset_remove(set, 10000);
+    cr_assert_eq(set->size, 1);
+    cr_assert_not(bitset_contains(set, 3));
+
+    bitset_free(set);
+}
+
+Test(bitset, foreach)
+{
+    BitSet *set = BitSet(64);
+    size_t elements[] = { 0, 1, 63, 64, 130 };
+    for (size_t i = 4; i < 5; i--)
+        bitset_add(set, elements[i]);
+
+    size_t i = 0;
+    bitset_foreach(element, set, {
+        cr_assert_eq(element, elements[i]);
+        i++;
+    })
+    cr_assert_eq(i, 5);
+
+    bitset_free(set);
+}
+
+Test(bitset, union_)
+{
+    BitSet *set1 = BitSet(0);
+    BitSet *set2 = BitSet(0);
+    for (size_t i = 0; i < 100; i += 2)
+        bitset_add(set1, i);
+    for (size_t i = 0; i < 300; i += 3)
+        bitset_add(set2, i);
+
+    bitset_union(set1, set2);
+    for (size_t i = 0; i < 300; i++)
+        cr_assert_eq(bitset_contains(set1, i),
+                     (i < 100 && i % 2 == 0) || i % 3 == 0);
+    cr_assert_eq(set1->size, 50 + 100 - 17);
+
+    bitset_free(set1);
+    bitset_free(set2);
+}
+
+Test(bitset, compare_and_hash)
+{
+    // Same elements, different allocated sizes
+    BitSet *set1 = BitSet(1024);
+    BitSet *set2 = BitSet(0);
+    bitset_add(set1, 5);
+    bitset_add(set1, 70);
+    bitset_add(set2, 70);
+    bitset_add(set2, 5);
+    bitset_add(set2, 900);
+    bitset_remove(set2, 900);
+
+    cr_assert_eq(compare_bitsets(&set1, &set2), 0);
+    cr_assert_eq(hash_bitset(&set1), hash_bitset(&set2));
+
+    bitset_add(set2, 6);
+    cr_assert_neq(compare_bitsets(&set1, &set2), 0);
+
+    BitSet *copy = bitset_copy(set2);
+    cr_assert_eq(compare_bitsets(&copy, &set2), 0);
+
+    bitset_free(set1);
+    bitset_free(set2);
+    bitset_free(copy);
+}
+
+Test(bitset, map_key)
+{
+    Map *map = Map(BitSet *, int, &hash_bitset, &compare_bitsets);
+    BitSet *set1 = BitSet(0);
+    BitSet *set2 = BitSet(256);
+    bitset_add(set1, 1);
+    bitset_add(set1, 100);
+    bitset_add(set2, 100);
+    bitset_add(set2, 1);
+
+    int value = 42;
+    map_set(map, &set1, &value);
+    int *actual = map_get(map, &set2);
+    cr_assert_neq(actual, NULL);
+    cr_assert_eq(*actual, value);
+
+    map_free(map);
+    bitset_free(set1);
+    bitset_free(set2);
+}
+
+Test(bitset, stringify)
+{
+    BitSet *set = BitSet(0);
+    char *result = stringify_bitset(set, 'S');
+    cr_assert_str_eq(result, "");
+    free(result);
+
+    for (size_t i = 5; i < 6; i--)
+        bitset_add(set, i * 3);
+    result = stringify_bitset(set, 'S');
+    cr_assert_str_eq(result, "S,0,3,6,9,12,15");
+    free(result);
+
+    bitset_free(set);
+}
@@ -0,0 +1,159 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "rationl_internal.h"
+
+#define ASYNC_THREADS 4
+#define ASYNC_SEARCHES 2000
+
+static char *async_pattern = "(a|b)*a(a|b){3}";
+static char *async_string = "aabbb babaa abbbbb bbaaaab";
+
+static size_t count_matches(reg_t re)
+{
+    match **matches;
+    size_t n = regex_search(re, async_string, &matches);
+    for (size_t i = 0; i < n; i++)
+        match_free(matches[i]);
+    free(matches);
+    return n;
+}
+
+Test(compile_async, upgrade)
+{
+    reg_t reference = regex_compile(async_pattern);
+    reg_t re = regex_compile_async(async_pattern, NULL);
+
+    // Usable at once, whichever engine matches it
+    cr_assert_eq(count_matches(re), count_matches(reference));
+    cr_assert_neq(re.program->nfa, NULL);
+    cr_assert_eq(re.program->table, NULL);
+
+    cr_assert_eq(regex_wait(re), 0);
+    const RegexProgram *upgrade = re.program->upgrade;
+    cr_assert_neq(upgrade, NULL);
+    cr_assert_neq(upgrade->table, NULL);
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+    cr_assert_gt(stats.stages[REGEX_STAGE_MINIMIZE].states, 0);
+    cr_assert_eq(count_matches(re), count_matches(reference));
+
+    regex_free(reference);
+    regex_free(re);
+}
+
+Test(compile_async, nullable_before_upgrade)
+{
+    char *string = "xaay abcab ccab";
+    reg_t reference = regex_compile("a*b*c*");
+    match **matches;
+    size_t n = regex_search(reference, string, &matches);
+    for (size_t i = 0; i < n; i++)
+        match_free(matches[i]);
+    free(matches);
+
+    reg_t re = regex_compile_async("a*b*c*", NULL);
+    // Whether or not the worker already published the DFA
+    match **found;
+    cr_assert_eq(regex_search(re, string, &found), n);
+    for (size_t i = 0; i < n; i++)
+        match_free(found[i]);
+    free(found);
+
+    // The NFA the expression starts with, matched until the upgrade
+    MatchScratch *scratch = match_scratch_create(0, 0, 0);
+    cr_assert_eq(search_flat_scratch(re.program->nfa, string, scratch), n);
+    match_scratch_free(scratch);
+
+    cr_assert_eq(regex_wait(re), 0);
+    regex_free(reference);
+    regex_free(re);
+}
+
+Test(compile_async, nothing_in_background)
+{
+    // Literals have their table, level 0 only asks for the NFA
+    reg_t re = regex_compile_async("abc", NULL);
+    cr_assert_eq(re.program->async, NULL);
+    cr_assert_eq(regex_wait(re), 0);
+    regex_free(re);
+
+    regex_options options = { .level = REGEX_LEVEL_NFA };
+    re = regex_compile_async(async_pattern, &options);
+    cr_assert_eq(re.program->async, NULL);
+    cr_assert_eq(regex_wait(re), -1);
+    regex_free(re);
+}
+
+Test(compile_async, over_budget)
+{
+    regex_options options = { .max_dfa_states = 4 };
+    reg_t re = regex_compile_async(async_pattern, &options);
+
+    cr_assert_eq(regex_wait(re), -1);
+    cr_assert_eq(re.program->upgrade, NULL);
+    cr_assert_eq(count_matches(re), 4);
+
+    regex_free(re);
+}
+
+Test(compile_async, freed_while_compiling)
+{
+    reg_t re = regex_compile_async(async_pattern, NULL);
+    regex_free(re);
+
+    // The jobs run in order, the first one is done with the second
+    re = regex_compile_async("(ab|c)+d", NULL);
+    cr_assert_eq(regex_wait(re), 0);
+    regex_free(re);
+}
+
+static void *search_thread(void *data)
+{
+    reg_t re = *(reg_t *)data;
+    regex_scratch_t *scratch = regex_scratch_create(re);
+    size_t wrong = 0;
+    for (size_t i = 0; i < ASYNC_SEARCHES; i++)
+    {
+        const match *matches;
+        if (regex_search_r(re, scratch, async_string, &matches) != 4
+            || matches[3].start != 19)
+            wrong++;
+    }
+    regex_scratch_free(scratch);
+    regex_free(re);
+    return (void *)wrong;
+}
+
+Test(compile_async, switch_while_searching)
+{
+    regex_options options = { .counters = 1 };
+    reg_t re = regex_compile_async(async_pattern, &options);
+
+    pthread_t threads[ASYNC_THREADS];
+    reg_t refs[ASYNC_THREADS];
+    for (size_t i = 0; i < ASYNC_THREADS; i++)
+    {
+        refs[i] = regex_ref(re);
+        pthread_create(threads + i, NULL, search_thread, refs + i);
+    }
+    for (size_t i = 0; i < ASYNC_THREADS; i++)
+    {
+        void *wrong;
+        pthread_join(threads[i], &wrong);
+        cr_assert_eq(wrong, NULL);
+    }
+
+    // The counters are kept across the switch
+    cr_assert_eq(regex_wait(re), 0);
+    regex_counters counters;
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, ASYNC_THREADS * ASYNC_SEARCHES);
+    cr_assert_eq(count_matches(re), 4);
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, ASYNC_THREADS * ASYNC_SEARCHES + 1);
+
+    regex_free(re);
+}
@@ -0,0 +1,92 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "rationl_internal.h"
+
+Test(counters, disabled)
+{
+    reg_t re = regex_compile("a+b");
+    regex_counters counters;
+    cr_assert_eq(regex_get_counters(re, &counters), -1);
+    regex_free(re);
+}
+
+Test(counters, calls)
+{
+    regex_options options = { .max_dfa_states = 0, .max_memory = 0,
+                              .counters = 1 };
+    reg_t re = regex_compile_options("a+b", &options);
+    regex_counters counters;
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, 0);
+
+    match_free(regex_match(re, "aab"));
+    regex_match(re, "ba");
+    match **matches;
+    size_t n = regex_search(re, "ab xaab b", &matches);
+    for (size_t i = 0; i < n; i++)
+        match_free(matches[i]);
+    free(matches);
+    free(regex_sub(re, "ab ab ab", "-"));
+
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, 4);
+    cr_assert_eq(counters.bytes_scanned, 3 + 2 + 9 + 8);
+    cr_assert_eq(counters.matches, 1 + 0 + 2 + 3);
+
+    regex_free(re);
+}
+
+Test(counters, literal)
+{
+    regex_options options = { .max_dfa_states = 0, .max_memory = 0,
+                              .counters = 1 };
+    reg_t re = regex_compile_options("abc", &options);
+    regex_scratch_t *scratch = regex_scratch_create(re);
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, "abcabc", &matches), 2);
+
+    regex_counters counters;
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, 1);
+    cr_assert_eq(counters.matches, 2);
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+}
+
+static void *search_thread(void *data)
+{
+    reg_t re = *(reg_t *)data;
+    regex_scratch_t *scratch = regex_scratch_create(re);
+    const match *matches;
+    for (size_t i = 0; i < 1000; i++)
+        regex_search_r(re, scratch, "xaab ab", &matches);
+    regex_scratch_free(scratch);
+    return NULL;
+}
+
+Test(counters, threads)
+{
+    regex_options options = { .max_dfa_states = 0, .max_memory = 0,
+                              .counters = 1 };
+    reg_t re = regex_compile_options("a+b", &options);
+
+    // More threads than shards, some of them share their counters
+    pthread_t threads[REGEX_COUNTER_SHARDS + 4];
+    size_t nb_threads = sizeof(threads) / sizeof(*threads);
+    for (size_t i = 0; i < nb_threads; i++)
+        cr_assert_eq(pthread_create(threads + i, NULL, search_thread, &re), 0);
+    for (size_t i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    regex_counters counters;
+    cr_assert_eq(regex_get_counters(re, &counters), 0);
+    cr_assert_eq(counters.calls, nb_threads * 1000);
+    cr_assert_eq(counters.bytes_scanned, nb_threads * 1000 * 7);
+    cr_assert_eq(counters.matches, nb_threads * 1000 * 2);
+
+    regex_free(re);
+}
@@ -0,0 +1,301 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rationl_internal.h"
+#include "utils/errors.h"
+
+static void assert_same_search(reg_t expected, reg_t actual, char *string)
+{
+    match **expected_matches;
+    match **actual_matches;
+    size_t n = regex_search(expected, string, &expected_matches);
+    cr_assert_eq(regex_search(actual, string, &actual_matches), n);
+    for (size_t i = 0; i < n; i++)
+    {
+        cr_assert_eq(expected_matches[i]->start, actual_matches[i]->start);
+        cr_assert_eq(expected_matches[i]->length, actual_matches[i]->length);
+        match_free(expected_matches[i]);
+        match_free(actual_matches[i]);
+    }
+    free(expected_matches);
+    free(actual_matches);
+}
+
+Test(compile_options, no_limit)
+{
+    regex_options options = { .max_dfa_states = 0, .max_memory = 0 };
+    reg_t re = regex_compile_options("(a|b)*a(a|b){4}", &options);
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+
+    cr_assert_eq(stats.nfa_fallback, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_MINIMIZE].states, 32);
+    cr_assert_neq(re.program->table, NULL);
+
+    regex_free(re);
+}
+
+Test(compile_options, dfa_fallback)
+{
+    char *pattern = "(a|b)*a(a|b){4}";
+    regex_options options = { .max_dfa_states = 16, .max_memory = 0 };
+    reg_t re = regex_compile_options(pattern, &options);
+    reg_t reference = regex_compile(pattern);
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+
+    cr_assert_neq(stats.nfa_fallback, 0);
+    cr_assert_eq(re.program->table, NULL);
+    cr_assert_neq(re.program->nfa, NULL);
+
+    cr_assert_neq(regex_match(re, "abaaab"), NULL);
+    match_free(regex_match(re, "abaaab"));
+    cr_assert_eq(regex_match(re, "bbabbb"), NULL);
+    assert_same_search(reference, re, "aabbb babaa abbbbb bbaaaab");
+
+    regex_scratch_t *scratch = regex_scratch_create(re);
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, "xx abbab yy", &matches), 1);
+    cr_assert_eq(matches[0].start, 3);
+    cr_assert_str_eq(regex_sub_r(re, scratch, "xx abbab yy", "-"), "xx - yy");
+
+    regex_scratch_free(scratch);
+    regex_free(reference);
+    regex_free(re);
+}
+
+Test(compile_options, memory_limit)
+{
+    rationl_errno = 0;
+    regex_options options = { .max_dfa_states = 0, .max_memory = 1024 };
+    reg_t re = regex_compile_options("(ab){16,32}", &options);
+
+    // Not even the NFA fits, nothing is matched
+    cr_assert_eq(rationl_errno, EBUDGET);
+    cr_assert_eq(regex_match(re, "abababababababababababababababab"), NULL);
+
+    regex_free(re);
+}
+
+Test(compile_options, levels)
+{
+    char *pattern = "(a|b)*a(a|b){2}";
+    char *string = "aabbb babaa abbbbb bbaaaab";
+    reg_t reference = regex_compile(pattern);
+    regex_stats stats;
+
+    regex_options options = { .level = REGEX_LEVEL_NFA };
+    reg_t re = regex_compile_options(pattern, &options);
+    regex_compile_stats(re, &stats);
+    cr_assert_eq(re.program->table, NULL);
+    cr_assert_neq(re.program->nfa, NULL);
+    cr_assert_eq(stats.nfa_fallback, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_DETERMINIZE].states, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_MINIMIZE].states, 0);
+    cr_assert_eq(re.program->plan.search, ENGINE_NFA);
+    assert_same_search(reference, re, string);
+    regex_free(re);
+
+    options.level = REGEX_LEVEL_DFA;
+    re = regex_compile_options(pattern, &options);
+    regex_compile_stats(re, &stats);
+    cr_assert_neq(re.program->table, NULL);
+    cr_assert_gt(stats.stages[REGEX_STAGE_DETERMINIZE].states, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_MINIMIZE].states, 0);
+    cr_assert_eq(re.program->table->jit, NULL);
+    assert_same_search(reference, re, string);
+    regex_free(re);
+
+    options.level = REGEX_LEVEL_MINIMAL;
+    re = regex_compile_options(pattern, &options);
+    regex_compile_stats(re, &stats);
+    cr_assert_eq(stats.stages[REGEX_STAGE_DETERMINIZE].states, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_MINIMIZE].states, 8);
+    assert_same_search(reference, re, string);
+    regex_free(re);
+
+    regex_free(reference);
+}
+
+Test(compile_options, nfa_groups)
+{
+    regex_options options = { .level = REGEX_LEVEL_NFA };
+    reg_t re = regex_compile_options("(\\w+)=(\\d+)", &options);
+    cr_assert_eq(re.program->table, NULL);
+
+    // Short enough to be backtracked over
+    match *m = regex_match(re, "key=42");
+    cr_assert_neq(m, NULL);
+    cr_assert_str_eq(m->groups[1], "key");
+    cr_assert_str_eq(m->groups[2], "42");
+    match_free(m);
+
+    // Too long, the groups are captured once the NFA found the matches
+    char string[2048];
+    memset(string, 'k', 1500);
+    strcpy(string + 1500, "=42");
+    m = regex_match(re, string);
+    cr_assert_neq(m, NULL);
+    cr_assert_eq(strlen(m->groups[1]), 1500);
+    cr_assert_str_eq(m->groups[2], "42");
+    match_free(m);
+
+    memset(string, ' ', sizeof(string) - 1);
+    string[sizeof(string) - 1] = 0;
+    memcpy(string + 1800, "b=7", 3);
+    match **matches;
+    cr_assert_eq(regex_search(re, string, &matches), 1);
+    cr_assert_str_eq(matches[0]->groups[1], "b");
+    cr_assert_str_eq(matches[0]->groups[2], "7");
+    match_free(matches[0]);
+    free(matches);
+
+    regex_free(re);
+}
+
+Test(compile_options, engine)
+{
+    char *pattern = "[a-z]+[0-9]";
+    regex_options options = { .engine = REGEX_ENGINE_NFA };
+    reg_t re = regex_compile_options(pattern, &options);
+    cr_assert_eq(re.program->table, NULL);
+    char *explain = regex_explain(re);
+    cr_assert_neq(strstr(explain, "no dfa was asked for"), NULL);
+    free(explain);
+    regex_free(re);
+
+    // A table is built even at level 0
+    options.level = REGEX_LEVEL_NFA;
+    options.engine = REGEX_ENGINE_TABLE;
+    re = regex_compile_options(pattern, &options);
+    cr_assert_neq(re.program->table, NULL);
+    cr_assert_eq(re.program->table->jit, NULL);
+    match *m = regex_match(re, "abc1d");
+    cr_assert_neq(m, NULL);
+    cr_assert_eq(m->length, 4);
+    match_free(m);
+    regex_free(re);
+}
+
+Test(compile_options, no_captures)
+{
+    regex_options options = { .no_captures = 1 };
+    reg_t re = regex_compile_options("(\\w+)=(\\d+)", &options);
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+
+    cr_assert_eq(stats.nb_groups, 0);
+    cr_assert_eq(re.program->backtracker, NULL);
+    match **matches;
+    cr_assert_eq(regex_search(re, "a=1 bc=22", &matches), 2);
+    cr_assert_eq(matches[1]->start, 4);
+    cr_assert_eq(matches[1]->groups, NULL);
+    for (size_t i = 0; i < 2; i++)
+        match_free(matches[i]);
+    free(matches);
+    regex_free(re);
+
+    // Without groups, a literal is searched for as such
+    re = regex_compile_options("(ab)c", &options);
+    cr_assert_eq(re.program->plan.search, ENGINE_LITERAL);
+    regex_free(re);
+}
+
+Test(compile_options, finalize)
+{
+    char *pattern = "(a|b)*a(a|b){3}";
+    char *string = "aabbb babaa abbbbb bbaaaab";
+    regex_options options = { .level = REGEX_LEVEL_NFA, .no_finalize = 1 };
+    reg_t kept = regex_compile_options(pattern, &options);
+    options.no_finalize = 0;
+    reg_t re = regex_compile_options(pattern, &options);
+
+    cr_assert_neq(kept.program->aut, NULL);
+    cr_assert_eq(kept.program->nfa, NULL);
+    cr_assert_eq(re.program->aut, NULL);
+    cr_assert_eq(re.program->nfa->size, kept.program->aut->size);
+    cr_assert_lt(regex_memory_usage(re), regex_memory_usage(kept));
+    assert_same_search(kept, re, string);
+    char *kept_sub = regex_sub(kept, string, "-");
+    char *sub = regex_sub(re, string, "-");
+    cr_assert_str_eq(sub, kept_sub);
+    free(kept_sub);
+    free(sub);
+    match *m = regex_match(re, "babaa");
+    cr_assert_eq(m->length, 5);
+    match_free(m);
+    cr_assert_eq(regex_match(re, "bbbb"), NULL);
+    regex_free(kept);
+    regex_free(re);
+
+    // The groups are captured next to the flat NFA
+    re = regex_compile_options("(a+)(b|c)", &options);
+    cr_assert_neq(re.program->nfa, NULL);
+    cr_assert_neq(re.program->backtracker, NULL);
+    m = regex_match(re, "aac");
+    cr_assert_str_eq(m->groups[1], "aa");
+    cr_assert_str_eq(m->groups[2], "c");
+    match_free(m);
+    regex_free(re);
+
+    // The table keeps the pattern
+    re = regex_compile(pattern);
+    cr_assert_eq(re.program->pattern, NULL);
+    char *explain = regex_explain(re);
+    cr_assert_neq(strstr(explain, "pattern: (a|b)*a(a|b){3}"), NULL);
+    free(explain);
+    cr_assert_geq(regex_memory_usage(re), re.program->table->image_size);
+    regex_free(re);
+}
+
+Test(compile_options, nullable_fallback)
+{
+    char *patterns[] = { "a*", "a*b*c*", "(ab)*" };
+    char *string = "xaay abcab ccab xababy";
+    regex_options options = { .max_dfa_states = 1 };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(*patterns); i++)
+    {
+        reg_t reference = regex_compile(patterns[i]);
+        reg_t re = regex_compile_options(patterns[i], &options);
+        regex_stats stats;
+        regex_compile_stats(re, &stats);
+        cr_assert_neq(stats.nfa_fallback, 0);
+        assert_same_search(reference, re, string);
+        assert_same_search(reference, re, "xaay");
+        regex_free(re);
+        regex_free(reference);
+    }
+}
+
+Test(compile_options, nullable_levels)
+{
+    char *patterns[] = { "a*", "a*b*c*" };
+    char *string = "xaay abcab ccab";
+    regex_level levels[] = { REGEX_LEVEL_NFA, REGEX_LEVEL_DFA,
+                             REGEX_LEVEL_MINIMAL };
+    regex_engine engines[] = { REGEX_ENGINE_AUTO, REGEX_ENGINE_NFA,
+                               REGEX_ENGINE_TABLE };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(*patterns); i++)
+    {
+        reg_t reference = regex_compile(patterns[i]);
+        for (size_t l = 0; l < sizeof(levels) / sizeof(*levels); l++)
+            for (size_t e = 0; e < sizeof(engines) / sizeof(*engines); e++)
+            {
+                regex_options options = { .level = levels[l],
+                                          .engine = engines[e] };
+                reg_t re = regex_compile_options(patterns[i], &options);
+                assert_same_search(reference, re, string);
+                regex_free(re);
+            }
+        regex_free(reference);
+    }
+
+    // Literals always have a table
+    regex_options options = { .engine = REGEX_ENGINE_NFA };
+    reg_t re = regex_compile_options("abc", &options);
+    cr_assert_neq(re.program->table, NULL);
+    cr_assert_eq(re.program->plan.search, ENGINE_LITERAL);
+    regex_free(re);
+}
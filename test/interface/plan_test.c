@@ -0,0 +1,306 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rationl_internal.h"
+
+static void assert_explains(reg_t re, const char *line)
+{
+    char *explain = regex_explain(re);
+    cr_assert_neq(strstr(explain, line), NULL, "no \"%s\" in:\n%s", line,
+                  explain);
+    free(explain);
+}
+
+Test(plan, literal)
+{
+    reg_t re = regex_compile("a\\.b");
+    const RegexPlan *plan = &re.program->plan;
+
+    cr_assert_eq(plan->analysis.literal_count, 1);
+    cr_assert_str_eq(plan->analysis.literals[0], "a.b");
+    cr_assert_eq(plan->match, ENGINE_LITERAL);
+    cr_assert_eq(plan->search, ENGINE_LITERAL);
+    cr_assert_eq(plan->sub, ENGINE_LITERAL);
+    assert_explains(re, "search: literal");
+
+    match *m = regex_match(re, "a.bc");
+    cr_assert_neq(m, NULL);
+    cr_assert_eq(m->length, 3);
+    match_free(m);
+    cr_assert_eq(regex_match(re, "axb"), NULL);
+
+    match **matches;
+    cr_assert_eq(regex_search(re, "a.b axb a.ba.b", &matches), 3);
+    cr_assert_eq(matches[0]->start, 0);
+    cr_assert_eq(matches[1]->start, 8);
+    cr_assert_eq(matches[2]->start, 11);
+    for (size_t i = 0; i < 3; i++)
+        match_free(matches[i]);
+    free(matches);
+
+    char *sub = regex_sub(re, "a.b axb a.ba.b", "-");
+    cr_assert_str_eq(sub, "- axb --");
+    free(sub);
+
+    regex_free(re);
+}
+
+Test(plan, literal_set)
+{
+    reg_t re = regex_compile("abc|abd");
+    const PatternAnalysis *analysis = &re.program->plan.analysis;
+
+    cr_assert_eq(analysis->literal_count, 2);
+    cr_assert_str_eq(analysis->prefix, "ab");
+    cr_assert_str_eq(analysis->required, "ab");
+    cr_assert_eq(analysis->positions, 6);
+    cr_assert_eq(analysis->groups, 0);
+    cr_assert_eq(re.program->plan.search, ENGINE_DFA);
+    cr_assert(re.program->plan.check_prefix);
+
+    regex_free(re);
+}
+
+Test(plan, required_literal)
+{
+    reg_t re = regex_compile("(GET|POST) /\\w+");
+    const RegexPlan *plan = &re.program->plan;
+
+    cr_assert_eq(plan->analysis.literal_count, 0);
+    cr_assert_str_eq(plan->analysis.prefix, "");
+    cr_assert_str_eq(plan->analysis.required, " /");
+    cr_assert_neq(plan->analysis.groups, 0);
+    cr_assert(plan->check_required);
+    cr_assert_not(plan->check_prefix);
+    assert_explains(re, "required: \" /\"");
+
+    match **matches;
+    cr_assert_eq(regex_search(re, "GET index POST login", &matches), 0);
+    free(matches);
+    cr_assert_eq(regex_search(re, "x GET /index", &matches), 1);
+    cr_assert_eq(matches[0]->start, 2);
+    match_free(matches[0]);
+    free(matches);
+
+    regex_free(re);
+}
+
+Test(plan, groups_not_literal)
+{
+    reg_t re = regex_compile("(ab)c");
+
+    cr_assert_eq(re.program->plan.analysis.literal_count, 1);
+    cr_assert_neq(re.program->plan.analysis.groups, 0);
+    cr_assert_eq(re.program->plan.search, ENGINE_DFA);
+
+    regex_free(re);
+}
+
+Test(plan, prefix)
+{
+    reg_t re = regex_compile("x+y*");
+    regex_scratch_t *scratch = regex_scratch_create(re);
+
+    cr_assert_str_eq(re.program->plan.analysis.prefix, "x");
+    cr_assert(re.program->plan.check_prefix);
+    cr_assert_eq(regex_match_r(re, scratch, "yx"), NULL);
+    cr_assert_neq(regex_match_r(re, scratch, "xxy"), NULL);
+
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, "axxyy bxy xa", &matches), 3);
+    cr_assert_eq(matches[0].start, 1);
+    cr_assert_eq(matches[0].length, 4);
+    cr_assert_eq(matches[1].start, 7);
+    cr_assert_eq(matches[2].start, 10);
+    cr_assert_str_eq(regex_sub_r(re, scratch, "axxyy bxy xa", "-"),
+                     "a- b- -a");
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+}
+
+Test(plan, nfa_fallback)
+{
+    regex_options options = { .max_dfa_states = 4 };
+    reg_t re = regex_compile_options("(a|b)*a(a|b){4}", &options);
+
+    cr_assert_eq(re.program->plan.match, ENGINE_NFA);
+    cr_assert_eq(re.program->plan.search, ENGINE_NFA);
+    cr_assert_gt(re.program->plan.analysis.dfa_estimate, 4);
+    assert_explains(re, "the dfa was over budget");
+
+    regex_free(re);
+}
+
+Test(plan, over_budget)
+{
+    regex_options options = { .max_memory = 1024 };
+    reg_t re = regex_compile_options("(ab){16,32}", &options);
+
+    cr_assert_eq(re.program->plan.search, ENGINE_NONE);
+    assert_explains(re, "search: none");
+
+    regex_free(re);
+}
+
+Test(plan, backtrack_groups)
+{
+    reg_t re = regex_compile("(GET|POST) /(\\w+)");
+    regex_scratch_t *scratch = regex_scratch_create(re);
+
+    cr_assert_eq(re.program->plan.backtrack_length, BACKTRACK_MAX_LENGTH);
+    assert_explains(re, "then backtracks over the matches of at most 1024 bytes");
+
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, "x GET /index POST /a", &matches),
+                 2);
+    cr_assert_eq(matches[1].start, 13);
+    cr_assert_str_eq(matches[0].groups[1], "GET");
+    cr_assert_str_eq(matches[0].groups[2], "index");
+    cr_assert_str_eq(matches[1].groups[2], "a");
+
+    match *m = regex_match(re, "POST /login");
+    cr_assert_neq(m, NULL);
+    cr_assert_str_eq(m->groups[1], "POST");
+    match_free(m);
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+}
+
+Test(plan, saved_groups)
+{
+    reg_t re = regex_compile("(a+)(b+)");
+    char path[] = "/tmp/rationl_plan_XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert_neq(fd, -1);
+    close(fd);
+    cr_assert_eq(regex_save(re, path), 0);
+    regex_free(re);
+
+    // The backtracker is not saved with the table, it is built again
+    re = regex_load(path);
+    cr_assert_neq(re.program->table, NULL);
+    cr_assert_neq(re.program->backtracker, NULL);
+    match *m = regex_match(re, "aabb");
+    cr_assert_neq(m, NULL);
+    cr_assert_str_eq(m->groups[1], "aa");
+    cr_assert_str_eq(m->groups[2], "bb");
+    match_free(m);
+
+    regex_free(re);
+    unlink(path);
+}
+
+Test(plan, lazy_groups)
+{
+    reg_t re = regex_compile("(\\w+)=(\\d+)");
+    regex_scratch_t *scratch = regex_scratch_create(re);
+
+    // Longer than the backtracker allows, only the matches are backtracked
+    char string[4096];
+    memset(string, ' ', sizeof(string) - 1);
+    string[sizeof(string) - 1] = 0;
+    memcpy(string + 10, "key=42", 6);
+    memcpy(string + 3000, "b=7", 3);
+
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, string, &matches), 2);
+    cr_assert_str_eq(matches[0].groups[1], "key");
+    cr_assert_str_eq(matches[1].groups[2], "7");
+
+    cr_assert_eq(regex_search_spans_r(re, scratch, string, &matches), 2);
+    cr_assert_eq(matches[0].start, 10);
+    cr_assert_eq(matches[0].groups, NULL);
+    cr_assert_eq(matches[1].start, 3000);
+    cr_assert_eq(matches[1].length, 3);
+
+    const match *captured = regex_groups_r(re, scratch, matches + 1);
+    cr_assert_eq(captured->start, 3000);
+    cr_assert_eq(captured->nb_groups, 3);
+    cr_assert_str_eq(captured->groups[1], "b");
+    cr_assert_str_eq(captured->groups[2], "7");
+    captured = regex_groups_r(re, scratch, matches);
+    cr_assert_str_eq(captured->groups[2], "42");
+    cr_assert_eq(matches[1].start, 3000);
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+}
+
+static void assert_groups_match(reg_t re, regex_scratch_t *scratch,
+                                const match *span)
+{
+    char text[64];
+    memcpy(text, span->string + span->start, span->length);
+    text[span->length] = 0;
+    match *expected = regex_match(re, text);
+    cr_assert_neq(expected, NULL);
+
+    const match *captured = regex_groups_r(re, scratch, span);
+    cr_assert_eq(captured->nb_groups, expected->nb_groups);
+    for (size_t i = 1; i < expected->nb_groups; i++)
+    {
+        if (expected->groups[i] == NULL)
+            cr_assert_eq(captured->groups[i], NULL);
+        else
+            cr_assert_str_eq(captured->groups[i], expected->groups[i]);
+    }
+    match_free(expected);
+}
+
+Test(plan, lazy_repeated_groups)
+{
+    reg_t re = regex_compile("(x|y)*z|(a|b)*abb");
+    regex_scratch_t *scratch = regex_scratch_create(re);
+
+    // The groups of a repeated group are the ones regex_match captures
+    const match *matches;
+    cr_assert_eq(regex_search_spans_r(re, scratch, "-xyxz-abb-babb", &matches),
+                 3);
+    for (size_t i = 0; i < 3; i++)
+        assert_groups_match(re, scratch, matches + i);
+    cr_assert_str_eq(regex_groups_r(re, scratch, matches)->groups[1], "x");
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+}
+
+Test(plan, long_groups)
+{
+    reg_t re = regex_compile("(a+)(b+)");
+    regex_scratch_t *scratch = regex_scratch_create(re);
+
+    // The match is longer than the backtracker allows
+    char string[BACKTRACK_MAX_LENGTH + 512];
+    memset(string, 'a', 1500);
+    strcpy(string + 1500, "bb");
+
+    match *m = regex_match(re, string);
+    cr_assert_neq(m, NULL);
+    cr_assert_eq(strlen(m->groups[1]), 1500);
+    cr_assert_str_eq(m->groups[2], "bb");
+    match_free(m);
+
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, string, &matches), 1);
+    cr_assert_eq(strlen(matches[0].groups[1]), 1500);
+    cr_assert_str_eq(matches[0].groups[2], "bb");
+
+    regex_scratch_free(scratch);
+    regex_free(re);
+
+    // and a repeated group still captures its last iteration
+    re = regex_compile("(a|b)+c");
+    for (size_t i = 0; i < 1500; i++)
+        string[i] = i % 2 == 0 ? 'a' : 'b';
+    strcpy(string + 1500, "c");
+    m = regex_match(re, string);
+    cr_assert_neq(m, NULL);
+    cr_assert_str_eq(m->groups[1], "b");
+    match_free(m);
+    regex_free(re);
+}
@@ -0,0 +1,118 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <stdio.h>
+
+#include "rationl_internal.h"
+#include "utils/errors.h"
+
+Test(regex_set, match)
+{
+    regex_set_t *set = regex_set_create(NULL);
+    cr_assert_eq(regex_set_add(set, "foo"), 0);
+    cr_assert_eq(regex_set_add(set, "ba[rz]"), 1);
+    cr_assert_eq(regex_set_add(set, "(\\d+)-(\\d+)"), 2);
+    cr_assert_eq(regex_set_size(set), 3);
+    regex_scratch_t *scratch = regex_set_scratch_create(set);
+
+    const size_t *ids;
+    cr_assert_eq(regex_set_match(set, scratch, "a baz, 12-34", &ids), 2);
+    cr_assert_eq(ids[0], 1);
+    cr_assert_eq(ids[1], 2);
+    cr_assert_eq(regex_set_match(set, scratch, "fo ba 12", &ids), 0);
+    cr_assert_eq(regex_set_match(set, scratch, "12-3 foo", &ids), 2);
+    cr_assert_eq(ids[0], 0);
+
+    regex_scratch_free(scratch);
+    regex_set_free(set);
+}
+
+Test(regex_set, remove)
+{
+    regex_set_t *set = regex_set_create(NULL);
+    regex_set_add(set, "a+");
+    regex_set_add(set, "b+");
+    regex_set_add(set, "c+");
+    regex_scratch_t *scratch = regex_set_scratch_create(set);
+
+    cr_assert_eq(regex_set_remove(set, 1), 0);
+    cr_assert_eq(regex_set_remove(set, 1), -1);
+    cr_assert_eq(regex_set_remove(set, 7), -1);
+    cr_assert_eq(regex_set_remove(set, -1), -1);
+    cr_assert_eq(regex_set_size(set), 2);
+
+    const size_t *ids;
+    cr_assert_eq(regex_set_match(set, scratch, "bbb", &ids), 0);
+    cr_assert_eq(regex_set_match(set, scratch, "abc", &ids), 2);
+    cr_assert_eq(ids[1], 2);
+
+    // Ids are never given twice
+    cr_assert_eq(regex_set_add(set, "b"), 3);
+    cr_assert_eq(regex_set_match(set, scratch, "abc", &ids), 3);
+    cr_assert_eq(ids[2], 3);
+
+    regex_scratch_free(scratch);
+    regex_set_free(set);
+}
+
+Test(regex_set, shards)
+{
+    regex_set_t *set = regex_set_create(NULL);
+    char pattern[16];
+    for (size_t i = 0; i < 100; i++)
+    {
+        sprintf(pattern, "k%zux", i);
+        cr_assert_eq(regex_set_add(set, pattern), (long)i);
+    }
+    cr_assert_eq(set->shards->size, 4);
+    regex_scratch_t *scratch = regex_set_scratch_create(set);
+
+    const size_t *ids;
+    cr_assert_eq(regex_set_match(set, scratch, "k57x k3x k100x", &ids), 2);
+    cr_assert_eq(ids[0], 3);
+    cr_assert_eq(ids[1], 57);
+
+    // The room left by a removal is taken by the next pattern
+    regex_set_remove(set, 3);
+    cr_assert_eq(regex_set_add(set, "k3x"), 100);
+    cr_assert_eq(set->shards->size, 4);
+    cr_assert_eq(regex_set_match(set, scratch, "k57x k3x k100x", &ids), 2);
+    cr_assert_eq(ids[0], 57);
+    cr_assert_eq(ids[1], 100);
+
+    // The scratch of a set also searches single expressions
+    reg_t re = regex_compile("k\\d+x");
+    const match *matches;
+    cr_assert_eq(regex_search_r(re, scratch, "k57x k3x", &matches), 2);
+    regex_free(re);
+
+    regex_scratch_free(scratch);
+    regex_set_free(set);
+}
+
+Test(regex_set, invalid_patterns)
+{
+    regex_set_t *set = regex_set_create(NULL);
+    regex_set_add(set, "a+");
+
+    // Would swallow the closing parenthesis of the union of the shard
+    rationl_errno = 0;
+    cr_assert_eq(regex_set_add(set, "b\\"), -1);
+    cr_assert_eq(rationl_errno, EBADFMT);
+    cr_assert_eq(regex_set_add(set, "[bc"), -1);
+    cr_assert_eq(regex_set_size(set), 1);
+
+    cr_assert_eq(regex_set_add(set, "b\\\\"), 1);
+    cr_assert_eq(regex_set_add(set, "[\\]c"), 2);
+    cr_assert_eq(regex_set_add(set, "\\[d"), 3);
+    regex_scratch_t *scratch = regex_set_scratch_create(set);
+
+    const size_t *ids;
+    cr_assert_eq(regex_set_match(set, scratch, "b\\ \\c [d", &ids), 3);
+    cr_assert_eq(ids[0], 1);
+    cr_assert_eq(ids[2], 3);
+    cr_assert_eq(regex_set_match(set, scratch, "a", &ids), 1);
+    cr_assert_eq(ids[0], 0);
+
+    regex_scratch_free(scratch);
+    regex_set_free(set);
+}
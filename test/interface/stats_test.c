@@ -0,0 +1,65 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include "rationl_internal.h"
+
+Test(compile_stats, stages)
+{
+    reg_t re = regex_compile("(a|b)*c");
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+
+    const regex_stage_stats *stages = stats.stages;
+    cr_assert_eq(stages[REGEX_STAGE_TOKENIZE].states, 0);
+    cr_assert_eq(stages[REGEX_STAGE_PARSE].states, 0);
+    cr_assert_gt(stages[REGEX_STAGE_THOMPSON].states, 0);
+    cr_assert_gt(stages[REGEX_STAGE_THOMPSON].transitions, 0);
+    // The pipeline never adds states after Thompson's construction
+    for (int i = REGEX_STAGE_DELETE_EPSILON; i <= REGEX_STAGE_PRUNE; i++)
+        cr_assert_leq(stages[i].states, stages[i - 1].states);
+    cr_assert_eq(stages[REGEX_STAGE_MINIMIZE].states, 2);
+    cr_assert_eq(stages[REGEX_STAGE_MINIMIZE].transitions, 3);
+    cr_assert_eq(stages[REGEX_STAGE_TABLE].states, 2);
+    cr_assert_eq(stages[REGEX_STAGE_TABLE].transitions, 3);
+    for (int i = 0; i < REGEX_STAGE_COUNT; i++)
+        cr_assert_geq(stages[i].seconds, 0);
+
+    cr_assert_gt(stats.table_bytes, 0);
+    cr_assert_gt(stats.allocations, 0);
+    cr_assert_gt(stats.allocated_bytes, stats.table_bytes);
+
+    regex_free(re);
+}
+
+Test(compile_stats, string)
+{
+    reg_t re = regex_compile("abc");
+    regex_stats stats;
+    regex_compile_stats(re, &stats);
+
+    // A pattern without operators skips the automaton stages
+    cr_assert_eq(stats.stages[REGEX_STAGE_THOMPSON].states, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_MINIMIZE].states, 0);
+    cr_assert_eq(stats.stages[REGEX_STAGE_TABLE].states, 4);
+    cr_assert_eq(stats.stages[REGEX_STAGE_TABLE].transitions, 3);
+    cr_assert_eq(stats.nb_groups, 0);
+    cr_assert_gt(stats.allocations, 0);
+
+    regex_free(re);
+}
+
+Test(compile_stats, shared)
+{
+    reg_t re = regex_compile("x+y");
+    reg_t ref = regex_ref(re);
+    regex_stats stats;
+    regex_stats ref_stats;
+    regex_compile_stats(re, &stats);
+    regex_compile_stats(ref, &ref_stats);
+
+    cr_assert_eq(stats.allocations, ref_stats.allocations);
+    cr_assert_eq(stats.table_bytes, ref_stats.table_bytes);
+
+    regex_free(ref);
+    regex_free(re);
+}
@@ -13,7 +13,7 @@ Test(map, map_init)
 {
     Map *map = Map(int, int, NULL, NULL);
 
-    cr_assert_eq(map->buckets->size, MAP_INITIAL_CAP);
+    cr_assert_eq(map->capacity, MAP_INITIAL_CAP);
     cr_assert_eq(map->load_factor, MAP_LOAD_FACTOR);
     cr_assert_eq(map->size, 0);
 
@@ -113,11 +113,11 @@ Test(map, map_grow)
     for (i = 0; i < MAP_INITIAL_CAP * MAP_LOAD_FACTOR; i++)
         map_set(map, &i, &i);
     cr_assert_eq(map->size, MAP_INITIAL_CAP * MAP_LOAD_FACTOR);
-    cr_assert_eq(map->buckets->size, MAP_INITIAL_CAP);
+    cr_assert_eq(map->capacity, MAP_INITIAL_CAP);
 
     map_set(map, &i, &i);  // BOOM! Rehash!
     cr_assert_eq(map->size, MAP_INITIAL_CAP * MAP_LOAD_FACTOR + 1);
-    cr_assert_eq(map->buckets->size, MAP_INITIAL_CAP * MAP_GROWTH_FACTOR);
+    cr_assert_eq(map->capacity, MAP_INITIAL_CAP * MAP_GROWTH_FACTOR);
 
     for (i = 0; i <= MAP_INITIAL_CAP * MAP_LOAD_FACTOR; i++)
         cr_assert_eq(i, *(int *) map_get(map, &i));
@@ -172,7 +172,7 @@ Test(map, map_union_expand)
 
     map_union(map1, map2);
     cr_assert_eq(map1->size, MAP_INITIAL_CAP * MAP_LOAD_FACTOR + 1);
-    cr_assert_eq(map1->buckets->size, MAP_INITIAL_CAP * MAP_GROWTH_FACTOR);
+    cr_assert_eq(map1->capacity, MAP_INITIAL_CAP * MAP_GROWTH_FACTOR);
 
     for (i = 0; i < MAP_INITIAL_CAP * MAP_LOAD_FACTOR; i++)
         cr_assert_eq(*(int *)map_get(map1, &i), i + 1);
@@ -190,12 +190,12 @@ Test(map, map_delete_basic)
 
     map_set(map1, &k, &x);
     
-    int * r = map_delete(map1, &k);
+    int r = 0;
+    cr_assert_eq(map_delete(map1, &k, &r), 1);
 
     cr_assert_eq(map1->size, 0);
-    cr_assert_eq(*r, x);
-
-    free(r);
+    cr_assert_eq(r, x);
+    cr_assert_eq(map_get(map1, &k), NULL);
 
     map_free(map1);
 }
@@ -209,14 +209,112 @@ Test(map, map_delete_not_present)
     map_set(map1, &k, &x);
     
     k = 88;
-    int * r = map_delete(map1, &k);
+    cr_assert_eq(map_delete(map1, &k, NULL), 0);
 
     cr_assert_eq(map1->size, 1);
-    cr_assert_eq(r, NULL);
 
     map_free(map1);
 }
 
+Test(map, map_delete_reinsert)
+{
+    Map *map = Map(int, int, &hash_int, &compare_ints);
+
+    for (int i = 0; i < 100; i++)
+        map_set(map, &i, &i);
+    for (int i = 0; i < 100; i += 2)
+        cr_assert_eq(map_delete(map, &i, NULL), 1);
+    cr_assert_eq(map->size, 50);
+
+    size_t count = 0;
+    map_foreach_key(int, key, map,
+    {
+        cr_assert_eq(key % 2, 1);
+        cr_assert_eq(*(int *)map_get(map, &key), key);
+        count++;
+    })
+    cr_assert_eq(count, 50);
+
+    // The deleted slots are reused without growing the map
+    size_t capacity = map->capacity;
+    for (int i = 0; i < 100; i += 2)
+        map_set(map, &i, &i);
+    cr_assert_eq(map->size, 100);
+    cr_assert_eq(map->capacity, capacity);
+    for (int i = 0; i < 100; i++)
+        cr_assert_eq(*(int *)map_get(map, &i), i);
+
+    map_free(map);
+}
+
+Test(map, map_copy_)
+{
+    Map *map = Map(int, int, &hash_int, &compare_ints);
+    for (int i = 0; i < 50; i++)
+        map_set(map, &i, &i);
+    for (int i = 0; i < 50; i += 5)
+        map_delete(map, &i, NULL);
+
+    Map *copy = map_copy(map);
+    cr_assert_eq(copy->size, map->size);
+    for (int i = 0; i < 50; i++)
+    {
+        int *value = map_get(copy, &i);
+        if (i % 5 == 0)
+            cr_assert_eq(value, NULL);
+        else
+            cr_assert_eq(*value, i);
+    }
+
+    // The copy does not share its storage with the map
+    int key = 1;
+    int value = 42;
+    map_set(copy, &key, &value);
+    cr_assert_eq(*(int *)map_get(map, &key), 1);
+    for (int i = 50; i < 100; i++)
+        map_set(copy, &i, &i);
+    cr_assert_eq(map->size, 40);
+
+    map_free(map);
+    map_free(copy);
+}
+
+Test(map, map_clear_)
+{
+    Map *map = Map(int, int, &hash_int, &compare_ints);
+
+    for (int i = 0; i < 20; i++)
+        map_set(map, &i, &i);
+    map_clear(map);
+    cr_assert_eq(map->size, 0);
+    for (int i = 0; i < 20; i++)
+        cr_assert_eq(map_get(map, &i), NULL);
+
+    int key = 3;
+    map_set(map, &key, &key);
+    cr_assert_eq(*(int *)map_get(map, &key), key);
+
+    map_free(map);
+}
+
+Test(map, hash_set_order)
+{
+    Set *set1 = Set(size_t, hash_size_t, compare_size_t);
+    Set *set2 = Set(size_t, hash_size_t, compare_size_t);
+    for (size_t i = 0; i < 10; i++)
+    {
+        size_t j = 9 - i;
+        set_add(set1, &i);
+        set_add(set2, &j);
+    }
+
+    cr_assert_eq(compare_sets(&set1, &set2), 0);
+    cr_assert_eq(hash_set(&set1), hash_set(&set2));
+
+    map_free(set1);
+    map_free(set2);
+}
+
 Test(map, stringify_set_)
 {
     Map * set = Set(size_t,  hash_size_t, compare_size_t);
@@ -226,7 +324,7 @@ Test(map, stringify_set_)
     }
     char * result = stringify_set(set, 'S');
     cr_assert_neq(result, NULL);
-    cr_assert_eq(strcmp(result, "S,2,1,0,3,4"), 0, 
+    cr_assert_eq(strcmp(result, "S,0,1,2,3,4"), 0, 
         "Expected '0,1,2,3,4' but got '%s'", result);
     free(result);
     map_free(set);
@@ -0,0 +1,98 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+#include <string.h>
+#include "datatypes/array.h"
+#include "utils/memory_utils.h"
+
+Test(arena, set_active)
+{
+    Arena *arena = arena_create();
+    Arena *other = arena_create();
+
+    cr_assert_eq(arena_set_active(arena), NULL);
+    cr_assert_eq(arena_set_active(other), arena);
+    cr_assert_eq(arena_set_active(NULL), other);
+
+    arena_free(arena);
+    arena_free(other);
+}
+
+Test(arena, allocations)
+{
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
+
+    int *values = SAFEMALLOC(10 * sizeof(int));
+    for (int i = 0; i < 10; i++)
+        values[i] = i;
+    char *zeros = SAFECALLOC(100, sizeof(char));
+    for (int i = 0; i < 100; i++)
+        cr_assert_eq(zeros[i], 0);
+    cr_assert_eq((size_t)zeros % 16, 0);
+
+    // Freeing is a no-op and the memory stays valid until arena_free
+    SAFEFREE(values);
+    cr_assert_eq(values[9], 9);
+    cr_assert_eq(arena_allocated(arena), 10 * sizeof(int) + 100);
+
+    arena_set_active(previous);
+    arena_free(arena);
+}
+
+Test(arena, realloc)
+{
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
+
+    char *last = SAFEMALLOC(4);
+    memcpy(last, "abc", 4);
+    last = SAFEREALLOC(last, 1000);
+    cr_assert_str_eq(last, "abc");
+
+    char *moved = SAFEMALLOC(4);
+    memcpy(moved, "def", 4);
+    SAFEMALLOC(4);
+    moved = SAFEREALLOC(moved, 100);
+    cr_assert_str_eq(moved, "def");
+    cr_assert_str_eq(last, "abc");
+
+    arena_set_active(previous);
+    arena_free(arena);
+}
+
+Test(arena, large_blocks)
+{
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
+
+    Array *arr = Array(int);
+    for (int i = 0; i < 100000; i++)
+        array_append(arr, &i);
+    char *large = SAFEMALLOC(1 << 20);
+    memset(large, 1, 1 << 20);
+    for (int i = 0; i < 100000; i++)
+        cr_assert_eq(*(int *)array_get(arr, i), i);
+    array_free(arr);
+
+    arena_set_active(previous);
+    arena_free(arena);
+}
+
+Test(arena, allocation_counters)
+{
+    AllocationCounters before = allocation_counters();
+    char *p = SAFEMALLOC(10);
+    p = SAFEREALLOC(p, 30);
+    SAFEFREE(p);
+
+    Arena *arena = arena_create();
+    Arena *previous = arena_set_active(arena);
+    SAFECALLOC(4, 5);
+    arena_set_active(previous);
+    arena_free(arena);
+
+    // Allocations in an arena are counted as well
+    AllocationCounters after = allocation_counters();
+    cr_assert_eq(after.count - before.count, 3);
+    cr_assert_eq(after.bytes - before.bytes, 10 + 30 + 20);
+}
@@ -0,0 +1,54 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "rationl.h"
+#include "rationl_internal.h"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: rationl-gen [-d] [-p prefix] [-o output] pattern\n"
+            "  -d          read the automaton from the .daut file pattern\n"
+            "  -p prefix   prefix of the generated symbols (default: regex)\n"
+            "  -o output   file to write (default: standard output)\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *prefix = "regex";
+    const char *output = NULL;
+    int daut = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "dp:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            daut = 1;
+            break;
+        case 'p':
+            prefix = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+
+    reg_t re = daut ? regex_read_daut(argv[optind])
+                    : regex_compile(argv[optind]);
+    int res = regex_generate_c(re, prefix, output);
+    regex_free(re);
+    if (res != 0)
+        errx(1, "could not generate %s", output == NULL ? "the code" : output);
+
+    return 0;
+}